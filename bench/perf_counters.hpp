@@ -0,0 +1,155 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace Sudoku {
+
+/* Hardware counters of the calling thread, read through Linux
+   perf_event_open. Counting is limited to user space so it works with
+   the default perf_event_paranoid setting. Each counter is opened on its
+   own: one the CPU or the kernel refuses (virtual machines often have
+   none) is reported as unavailable instead of failing the rest. Off
+   Linux every counter is unavailable */
+class PerfCounters
+{
+public:
+    enum Counter
+    {
+        Cycles,
+        Instructions,
+        BranchMisses,
+        L1DMisses,
+        LLCMisses,
+        Count
+    };
+
+    static const char* Name(std::size_t counter) noexcept
+    {
+        static const char* const names[Count] = {
+            "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"};
+        return names[counter];
+    }
+
+    /* Opens the counters, or none when enable is false */
+    explicit PerfCounters(bool enable = true) noexcept
+    {
+        fds.fill(-1);
+#ifdef __linux__
+        if (!enable)
+            return;
+
+        auto cache = [](std::uint64_t id) {
+            return id | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+
+        Open(Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        Open(Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        Open(BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        Open(L1DMisses, PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D));
+        Open(LLCMisses, PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL));
+#else
+        static_cast<void>(enable);
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (auto fd : fds)
+            if (fd >= 0)
+                close(fd);
+#endif
+    }
+
+    bool Available(std::size_t counter) const noexcept {return fds[counter] >= 0;}
+
+    bool AnyAvailable() const noexcept
+    {
+        for (auto fd : fds)
+            if (fd >= 0)
+                return true;
+        return false;
+    }
+
+    /* Zeroes and starts every available counter */
+    void Start() noexcept
+    {
+#ifdef __linux__
+        for (auto fd : fds)
+            if (fd >= 0)
+            {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+    }
+
+    /* Stops the counters. Values are scaled up when the kernel had to
+       multiplex them with other events */
+    void Stop() noexcept
+    {
+#ifdef __linux__
+        for (std::size_t k = 0; k < Count; ++k)
+            if (fds[k] >= 0)
+                ioctl(fds[k], PERF_EVENT_IOC_DISABLE, 0);
+
+        for (std::size_t k = 0; k < Count; ++k)
+        {
+            values[k] = 0;
+            if (fds[k] < 0)
+                continue;
+
+            std::uint64_t data[3] = {}; // value, time enabled, time running
+            if (read(fds[k], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+                continue;
+
+            values[k] = data[2] == 0 || data[2] == data[1]
+                ? data[0]
+                : static_cast<std::uint64_t>(static_cast<double>(data[0]) *
+                                             static_cast<double>(data[1]) / static_cast<double>(data[2]));
+        }
+#endif
+    }
+
+    /* Value of counter between the last Start and Stop */
+    std::uint64_t Value(std::size_t counter) const noexcept {return values[counter];}
+
+private:
+#ifdef __linux__
+    void Open(std::size_t counter, std::uint32_t type, std::uint64_t config) noexcept
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds[counter] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    std::array<int, Count> fds;
+    std::array<std::uint64_t, Count> values{};
+};
+
+
+} // End of namespace Sudoku
+
+#endif // PERF_COUNTERS_HPP
@@ -0,0 +1,666 @@
+/* Benchmark of every solver engine and of GeneratePuzzle.
+
+   Each engine solves every puzzle of the bundled corpora and the
+   logical grader rates them, then the generator runs for the rating
+   band of each Difficulty. The report is a JSON document on stdout, so
+   runs can be stored and diffed between releases:
+
+       sudoku_bench [--corpus DIR] [--engines mrv,dlx,...]
+                    [--generate N] [--max-nodes N] [--repeat N]
+                    [--no-counters] [--queue-ops N] [--queue-threads N]
+                    [--canonical-target-us N] [--parallel-threads N]
+
+   On Linux every series also reads the hardware counters of
+   perf_counters.hpp (cycles, instructions, branch, L1D and LLC misses)
+   and reports them per puzzle along with the IPC. Counters the machine
+   does not offer are left out of the report.
+
+   The canonical series time Canonicalize() on the puzzles of each
+   corpus and on their solutions. Solution grids are the worst case of
+   the search, as every row ties under every column order, and their
+   mean is held against --canonical-target-us (200 by default): a
+   series over it is reported with "within_target": false and a
+   warning, without failing the run, since timings vary by machine.
+
+   The parallel series solve the 16x16 and 25x25 puzzles of giant.txt
+   with SolveParallel on 1, 2, 4... workers up to --parallel-threads
+   (all cores by default, 0 skips them), so the speedup over one worker
+   can be read off the report.
+
+   The queue series pass --queue-ops integers from producers to as many
+   consumers, through the mutex BlockingQueue and through the lock-free
+   BlockingMpmcQueue one at a time and in batches, for 1, 2, 4... pairs
+   up to --queue-threads threads. They double as a stress test of
+   mpmc_queue.hpp: every value must come out exactly once, else the
+   series is reported with "ok": false and the benchmark fails */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "my_types.h"
+#include "blocking_queue.hpp"
+#include "canonical.hpp"
+#include "engines.hpp"
+#include "grader.hpp"
+#include "io.hpp"
+#include "mpmc_queue.hpp"
+#include "parallel.hpp"
+#include "solver.hpp"
+#include "perf_counters.hpp"
+
+#ifndef SUDOKU_CORPUS_DIR
+#define SUDOKU_CORPUS_DIR "bench/corpora"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string corpus_dir = SUDOKU_CORPUS_DIR;
+    std::vector<Sudoku::Engine> engines{Sudoku::Engine::Naive, Sudoku::Engine::MRV,
+                                        Sudoku::Engine::RandomMRV, Sudoku::Engine::DLX};
+    std::size_t generate = 50;
+    std::uint64_t max_nodes = 20000000;
+    std::size_t repeat = 1;
+    std::uint64_t queue_ops = 1 << 20;
+    std::size_t queue_threads = std::max(2u, std::thread::hardware_concurrency());
+    std::uint64_t canonical_target_us = 200;
+    std::size_t parallel_threads = std::max(1u, std::thread::hardware_concurrency());
+    bool counters = true;
+};
+
+const char* Corpora[] = {"easy", "17clue", "hardest", "generated_hard"};
+
+/* Summary of one series of timed runs */
+struct Series
+{
+    std::vector<std::uint64_t> ns;
+    std::uint64_t nodes = 0;
+    std::uint64_t solved = 0;
+    std::uint64_t unsolvable = 0;
+    std::uint64_t budget_exceeded = 0;
+    bool solver = true; // false for series that do not run a solver
+    std::array<bool, Sudoku::PerfCounters::Count> counted{};
+    std::array<std::uint64_t, Sudoku::PerfCounters::Count> counters{};
+
+    /* Keeps what perf measured over the whole series */
+    void Count(const Sudoku::PerfCounters& perf)
+    {
+        for (std::size_t k = 0; k < Sudoku::PerfCounters::Count; ++k)
+        {
+            counted[k] = perf.Available(k);
+            counters[k] = perf.Value(k);
+        }
+    }
+
+    std::uint64_t Percentile(double p) const
+    {
+        if (ns.empty())
+            return 0;
+
+        auto sorted = ns;
+        std::sort(sorted.begin(), sorted.end());
+        auto rank = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    void Write(std::ostream& out) const
+    {
+        std::uint64_t total = 0;
+        for (auto n : ns)
+            total += n;
+
+        auto count = static_cast<double>(ns.size());
+        auto seconds = static_cast<double>(total) / 1e9;
+
+        out << "\"puzzles\": " << ns.size();
+
+        if (solver)
+            out << ", \"solved\": " << solved
+                << ", \"unsolvable\": " << unsolvable
+                << ", \"budget_exceeded\": " << budget_exceeded
+                << ", \"nodes_per_puzzle\": " << (count > 0 ? static_cast<double>(nodes) / count : 0.0);
+
+        out << ", \"puzzles_per_sec\": " << (seconds > 0 ? count / seconds : 0.0)
+            << ", \"ns_per_puzzle\": " << (count > 0 ? static_cast<double>(total) / count : 0.0)
+            << ", \"p50_ns\": " << Percentile(0.50)
+            << ", \"p99_ns\": " << Percentile(0.99)
+            << ", \"p999_ns\": " << Percentile(0.999);
+
+        for (std::size_t k = 0; k < Sudoku::PerfCounters::Count; ++k)
+            if (counted[k])
+                out << ", \"" << Sudoku::PerfCounters::Name(k) << "_per_puzzle\": "
+                    << (count > 0 ? static_cast<double>(counters[k]) / count : 0.0);
+
+        using Perf = Sudoku::PerfCounters;
+        if (counted[Perf::Cycles] && counted[Perf::Instructions] && counters[Perf::Cycles] != 0)
+            out << ", \"ipc\": " << std::setprecision(3)
+                << static_cast<double>(counters[Perf::Instructions]) / static_cast<double>(counters[Perf::Cycles])
+                << std::setprecision(1);
+    }
+};
+
+bool ParseOptions(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+
+        if (arg == "--no-counters")
+        {
+            opt.counters = false;
+            continue;
+        }
+        else if (arg == "--corpus" && i + 1 < argc)
+            opt.corpus_dir = value;
+        else if (arg == "--generate" && i + 1 < argc)
+            opt.generate = std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--max-nodes" && i + 1 < argc)
+            opt.max_nodes = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--repeat" && i + 1 < argc)
+            opt.repeat = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+        else if (arg == "--queue-ops" && i + 1 < argc)
+            opt.queue_ops = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--queue-threads" && i + 1 < argc)
+            opt.queue_threads = std::max<std::size_t>(2, std::strtoul(value.c_str(), nullptr, 10));
+        else if (arg == "--canonical-target-us" && i + 1 < argc)
+            opt.canonical_target_us = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--parallel-threads" && i + 1 < argc)
+            opt.parallel_threads = std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--engines" && i + 1 < argc)
+        {
+            opt.engines.clear();
+            std::stringstream ss(value);
+            std::string name;
+            while (std::getline(ss, name, ','))
+            {
+                auto engine = Sudoku::EngineFromName(name);
+                if (!engine)
+                {
+                    std::cerr << "unknown engine: " << name << "\n";
+                    return false;
+                }
+                opt.engines.push_back(*engine);
+            }
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--corpus DIR] [--engines naive,mrv,random-mrv,dlx]"
+                         " [--generate N] [--max-nodes N] [--repeat N] [--no-counters]"
+                         " [--queue-ops N] [--queue-threads N] [--canonical-target-us N]"
+                         " [--parallel-threads N]\n";
+            return false;
+        }
+        ++i;
+    }
+
+    return true;
+}
+
+/* The counters run over the whole series rather than per puzzle, so
+   the two clock reads per puzzle are counted too but no ioctl is */
+Series RunSolver(Sudoku::Engine engine, const std::vector<Puzzle_t>& puzzles, const Options& opt,
+                 Sudoku::PerfCounters& perf)
+{
+    Series series;
+    series.ns.reserve(puzzles.size() * opt.repeat);
+    Sudoku::SolveOptions budget;
+    budget.max_nodes = opt.max_nodes;
+
+    perf.Start();
+
+    for (std::size_t r = 0; r < opt.repeat; ++r)
+        for (std::size_t i = 0; i < puzzles.size(); ++i)
+        {
+            auto start = Clock::now();
+            auto result = Sudoku::SolveWith(engine, puzzles[i], budget, i + 1);
+            auto stop = Clock::now();
+
+            series.ns.push_back(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+            series.nodes += result.nodes;
+
+            switch (result.status)
+            {
+                case Sudoku::SolveStatus::Solved:
+                    ++series.solved;
+                    break;
+                case Sudoku::SolveStatus::Unsolvable:
+                    ++series.unsolvable;
+                    break;
+                default:
+                    ++series.budget_exceeded;
+                    break;
+            }
+        }
+
+    perf.Stop();
+    series.Count(perf);
+
+    return series;
+}
+
+/* SolveParallel over puzzles on a pool of threads workers */
+template <std::size_t Box>
+Series RunParallel(const std::vector<BoxGrid<Box>>& puzzles, std::size_t threads, const Options& opt,
+                   Sudoku::PerfCounters& perf)
+{
+    Series series;
+    Sudoku::ThreadPool pool(threads);
+    Sudoku::SolveOptions budget;
+    budget.max_nodes = opt.max_nodes;
+
+    perf.Start();
+
+    for (std::size_t r = 0; r < opt.repeat; ++r)
+        for (const auto& puzzle : puzzles)
+        {
+            auto start = Clock::now();
+            auto result = Sudoku::SolveParallel(puzzle, pool, budget);
+            auto stop = Clock::now();
+
+            series.ns.push_back(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+            series.nodes += result.nodes;
+
+            if (result.Solved())
+                ++series.solved;
+            else if (result.status == Sudoku::SolveStatus::Unsolvable)
+                ++series.unsolvable;
+            else
+                ++series.budget_exceeded;
+        }
+
+    perf.Stop();
+    series.Count(perf);
+
+    return series;
+}
+
+// Keeps the compiler from dropping results nobody reads
+volatile std::size_t sink;
+
+/* GenerateRated for the band of a difficulty: how often the band was
+   hit in time, the ratings and the candidates dug per puzzle */
+struct GenerateSeries : Series
+{
+    std::uint64_t in_band = 0;
+    std::uint64_t candidates = 0;
+    double rating_sum = 0.0;
+};
+
+GenerateSeries RunGenerator(Difficulty dif, std::size_t count, Sudoku::PerfCounters& perf)
+{
+    GenerateSeries series;
+    series.solver = false;
+    series.ns.reserve(count);
+
+    Sudoku::GenerateOptions options;
+    options.band = Sudoku::BandFor(dif);
+
+    perf.Start();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto start = Clock::now();
+        auto result = Sudoku::GenerateRated(options);
+        auto stop = Clock::now();
+
+        sink = result.grid[0][0];
+        series.ns.push_back(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+        series.in_band += result.in_band;
+        series.candidates += result.candidates;
+        series.rating_sum += result.grade.rating;
+    }
+
+    perf.Stop();
+    series.Count(perf);
+
+    return series;
+}
+
+/* GradePuzzle over a corpus: how many puzzles logic alone solves and
+   their mean rating, besides the timings */
+struct GradeSeries : Series
+{
+    std::uint64_t logic_solved = 0;
+    double rating_sum = 0.0;
+};
+
+GradeSeries RunGrader(const std::vector<Puzzle_t>& puzzles, const Options& opt,
+                      Sudoku::PerfCounters& perf)
+{
+    GradeSeries series;
+    series.solver = false;
+    series.ns.reserve(puzzles.size() * opt.repeat);
+
+    perf.Start();
+
+    for (std::size_t r = 0; r < opt.repeat; ++r)
+        for (const auto& puzzle : puzzles)
+        {
+            auto start = Clock::now();
+            auto grade = Sudoku::GradePuzzle(puzzle);
+            auto stop = Clock::now();
+
+            series.ns.push_back(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+            series.logic_solved += grade.solved;
+            series.rating_sum += grade.rating;
+        }
+
+    perf.Stop();
+    series.Count(perf);
+
+    return series;
+}
+
+/* Canonicalize over a set of grids */
+Series RunCanonical(const std::vector<Puzzle_t>& grids, const Options& opt, Sudoku::PerfCounters& perf)
+{
+    Series series;
+    series.solver = false;
+    series.ns.reserve(grids.size() * opt.repeat);
+
+    perf.Start();
+
+    for (std::size_t r = 0; r < opt.repeat; ++r)
+        for (const auto& grid : grids)
+        {
+            auto start = Clock::now();
+            auto form = Sudoku::Canonicalize(grid);
+            auto stop = Clock::now();
+
+            series.ns.push_back(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+            sink = form.grid[8][8];
+        }
+
+    perf.Stop();
+    series.Count(perf);
+
+    return series;
+}
+
+/* One run of a queue: its time and whether every value came out once */
+struct QueueSeries
+{
+    std::uint64_t ns = 0;
+    bool ok = false;
+};
+
+/* pairs producers push the values 1 to ops, interleaved, and pairs
+   consumers pop them. Batch 1 uses Push and Pop, more uses PushBatch
+   and PopBatch. The count, sum and sum of squares of what came out
+   tell lost and duplicated values */
+template <typename Queue, std::size_t Batch = 1>
+QueueSeries RunQueue(std::size_t pairs, std::uint64_t ops)
+{
+    Queue queue(1024);
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<std::uint64_t> squares{0};
+
+    auto start = Clock::now();
+
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < pairs; ++p)
+        producers.emplace_back([&, p]{
+            std::vector<std::uint64_t> values;
+            for (std::uint64_t v = p + 1; v <= ops; v += pairs)
+            {
+                if constexpr (Batch == 1)
+                    queue.Push(v);
+                else
+                {
+                    values.push_back(v);
+                    if (values.size() == Batch || v + pairs > ops)
+                    {
+                        queue.PushBatch(values.begin(), values.size());
+                        values.clear();
+                    }
+                }
+            }
+        });
+
+    std::vector<std::thread> consumers;
+    for (std::size_t c = 0; c < pairs; ++c)
+        consumers.emplace_back([&]{
+            std::uint64_t n = 0, s = 0, q = 0;
+            auto take = [&](std::uint64_t v) { ++n, s += v, q += v * v; };
+
+            if constexpr (Batch == 1)
+            {
+                while (auto v = queue.Pop())
+                    take(*v);
+            }
+            else
+            {
+                std::uint64_t values[Batch];
+                while (auto got = queue.PopBatch(values, Batch))
+                    for (std::size_t k = 0; k < got; ++k)
+                        take(values[k]);
+            }
+
+            count += n;
+            sum += s;
+            squares += q;
+        });
+
+    for (auto& t : producers)
+        t.join();
+    queue.Close();
+    for (auto& t : consumers)
+        t.join();
+
+    QueueSeries series;
+    series.ns = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+    std::uint64_t expected_sum = 0, expected_squares = 0;
+    for (std::uint64_t v = 1; v <= ops; ++v)
+        expected_sum += v, expected_squares += v * v;
+    series.ok = count == ops && sum == expected_sum && squares == expected_squares;
+    return series;
+}
+
+const char* DifficultyName(Difficulty dif)
+{
+    switch (dif)
+    {
+        case Difficulty::Easy:
+            return "easy";
+        case Difficulty::Intermediate:
+            return "intermediate";
+        case Difficulty::Hard:
+            return "hard";
+    }
+    return "unknown";
+}
+
+} // End of anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!ParseOptions(argc, argv, opt))
+        return 1;
+
+    Sudoku::PerfCounters perf(opt.counters);
+
+    auto& out = std::cout;
+    out << std::fixed << std::setprecision(1);
+    out << "{\n  \"benchmark\": \"sudoku_bench\",\n  \"max_nodes\": " << opt.max_nodes
+        << ",\n  \"perf_counters\": " << (perf.AnyAvailable() ? "true" : "false")
+        << ",\n  \"results\": [";
+
+    bool first = true;
+    auto separator = [&]{
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (auto corpus : Corpora)
+    {
+        std::ifstream file(opt.corpus_dir + "/" + corpus + ".txt");
+        if (!file)
+        {
+            std::cerr << "cannot open corpus " << opt.corpus_dir << "/" << corpus << ".txt\n";
+            return 1;
+        }
+
+        auto puzzles = Sudoku::ReadPuzzles(file);
+
+        for (auto engine : opt.engines)
+        {
+            auto series = RunSolver(engine, puzzles, opt, perf);
+
+            separator();
+            out << "    {\"kind\": \"solve\", \"engine\": \"" << Sudoku::EngineName(engine)
+                << "\", \"corpus\": \"" << corpus << "\", ";
+            series.Write(out);
+            out << "}";
+        }
+
+        auto grades = RunGrader(puzzles, opt, perf);
+        auto graded = static_cast<double>(grades.ns.size());
+
+        separator();
+        out << "    {\"kind\": \"grade\", \"corpus\": \"" << corpus << "\", ";
+        grades.Write(out);
+        out << ", \"logic_solved\": " << grades.logic_solved
+            << ", \"mean_rating\": " << std::setprecision(2)
+            << (graded > 0 ? grades.rating_sum / graded : 0.0) << std::setprecision(1) << "}";
+
+        std::vector<Puzzle_t> solutions;
+        for (const auto& puzzle : puzzles)
+        {
+            auto result = Sudoku::SolveWith(Sudoku::Engine::DLX, puzzle);
+            if (result.status == Sudoku::SolveStatus::Solved)
+                solutions.push_back(result.grid);
+        }
+
+        for (const auto* grids : {&puzzles, &solutions})
+        {
+            auto series = RunCanonical(*grids, opt, perf);
+            bool solution = grids == &solutions;
+
+            separator();
+            out << "    {\"kind\": \"canonical\", \"corpus\": \"" << corpus << "\", \"grids\": \""
+                << (solution ? "solutions" : "puzzles") << "\", ";
+            series.Write(out);
+            if (solution)
+            {
+                std::uint64_t total = 0;
+                for (auto ns : series.ns)
+                    total += ns;
+                bool within = total <= opt.canonical_target_us * 1000 * series.ns.size();
+
+                out << ", \"target_us\": " << opt.canonical_target_us
+                    << ", \"within_target\": " << (within ? "true" : "false");
+                if (!within)
+                    std::cerr << "canonical forms of " << corpus << " solutions take over "
+                              << opt.canonical_target_us << " us on average\n";
+            }
+            out << "}";
+        }
+    }
+
+    if (opt.parallel_threads != 0)
+    {
+        std::ifstream file(opt.corpus_dir + "/giant.txt");
+        if (!file)
+        {
+            std::cerr << "cannot open corpus " << opt.corpus_dir << "/giant.txt\n";
+            return 1;
+        }
+
+        auto puzzles16 = Sudoku::ReadBoxPuzzles<4>(file);
+        file.clear();
+        file.seekg(0);
+        auto puzzles25 = Sudoku::ReadBoxPuzzles<5>(file);
+
+        for (std::size_t threads = 1;; threads = std::min(threads * 2, opt.parallel_threads))
+        {
+            const std::pair<const char*, Series> runs[] = {
+                {"16x16", RunParallel<4>(puzzles16, threads, opt, perf)},
+                {"25x25", RunParallel<5>(puzzles25, threads, opt, perf)}};
+
+            for (const auto& [size, series] : runs)
+            {
+                separator();
+                out << "    {\"kind\": \"parallel\", \"corpus\": \"giant\", \"size\": \"" << size
+                    << "\", \"threads\": " << threads << ", ";
+                series.Write(out);
+                out << "}";
+            }
+
+            if (threads == opt.parallel_threads)
+                break;
+        }
+    }
+
+    for (auto dif : {Difficulty::Easy, Difficulty::Intermediate, Difficulty::Hard})
+    {
+        if (opt.generate == 0)
+            break;
+
+        auto series = RunGenerator(dif, opt.generate, perf);
+        auto generated = static_cast<double>(series.ns.size());
+
+        separator();
+        out << "    {\"kind\": \"generate\", \"difficulty\": \"" << DifficultyName(dif) << "\", ";
+        series.Write(out);
+        out << ", \"in_band\": " << series.in_band
+            << ", \"candidates_per_puzzle\": " << static_cast<double>(series.candidates) / generated
+            << ", \"mean_rating\": " << std::setprecision(2)
+            << series.rating_sum / generated << std::setprecision(1) << "}";
+    }
+
+    bool queues_ok = true;
+    for (std::size_t pairs = 1; opt.queue_ops != 0 && 2 * pairs <= opt.queue_threads; pairs *= 2)
+    {
+        const std::pair<const char*, QueueSeries> runs[] = {
+            {"mutex", RunQueue<Sudoku::BlockingQueue<std::uint64_t>>(pairs, opt.queue_ops)},
+            {"mpmc", RunQueue<Sudoku::BlockingMpmcQueue<std::uint64_t>>(pairs, opt.queue_ops)},
+            {"mpmc-batch16", RunQueue<Sudoku::BlockingMpmcQueue<std::uint64_t>, 16>(pairs, opt.queue_ops)}};
+
+        for (const auto& [name, series] : runs)
+        {
+            auto seconds = static_cast<double>(series.ns) / 1e9;
+            separator();
+            out << "    {\"kind\": \"queue\", \"queue\": \"" << name << "\", \"producers\": " << pairs
+                << ", \"consumers\": " << pairs << ", \"ops\": " << opt.queue_ops
+                << ", \"ops_per_sec\": " << (seconds > 0 ? static_cast<double>(opt.queue_ops) / seconds : 0.0)
+                << ", \"ns_per_op\": " << static_cast<double>(series.ns) / static_cast<double>(opt.queue_ops)
+                << ", \"ok\": " << (series.ok ? "true" : "false") << "}";
+            queues_ok = queues_ok && series.ok;
+        }
+    }
+
+    out << "\n  ]\n}\n";
+
+    if (!queues_ok)
+    {
+        std::cerr << "a queue lost or duplicated values\n";
+        return 1;
+    }
+    return 0;
+}
@@ -3,10 +3,15 @@
 
 #include <array>
 #include <memory>
+#include <optional>
+#include <random>
 #include <QMainWindow>
 #include <QFont>
+#include <QByteArray>
 
 #include "my_types.h"
+#include "book.hpp"
+#include "seen_filter.hpp"
 
 // Forward declarations
 namespace Ui {class MainWindow;}
@@ -25,6 +30,11 @@ class MainWindow : public QMainWindow
     QGridLayout* layout;
     QFont serifFont;
 
+    QByteArray book_data; // the embedded puzzle book, viewed by book
+    std::optional<Sudoku::PuzzleBook> book;
+    std::mt19937 gen;
+    Sudoku::SeenFilter seen; // puzzles already played, in the config directory
+
 
 public:
     explicit MainWindow(QWidget *parent = nullptr);
@@ -42,6 +52,9 @@ private slots:
     void solve();
 
 private:
+    void load_book();
+    void open_seen();
+    Puzzle_t next_puzzle();
     void init_board();
     void create_puzzle();
     void highlight_cell(Row row, Col col);
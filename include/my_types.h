@@ -6,6 +6,11 @@
 
 using Puzzle_t = std::array<std::array<std::size_t, 9>, 9>;
 
+// Grid of boxes Box cells wide: Box * Box rows, columns and digits, so
+// 16x16 for 4 and 25x25 for 5. BoxGrid<3> is Puzzle_t
+template <std::size_t Box>
+using BoxGrid = std::array<std::array<std::size_t, Box * Box>, Box * Box>;
+
 using Row = fluent::NamedType<std::size_t, struct RowTag>;
 using Col = fluent::NamedType<std::size_t, struct ColTag>;
 
@@ -69,12 +69,12 @@
         <translation>&amp;Resolver</translation>
     </message>
     <message>
-        <location filename="../src/mainwindow.cpp" line="32"/>
+        <location filename="../src/mainwindow.cpp" line="40"/>
         <source>About</source>
         <translation>Sobre</translation>
     </message>
     <message>
-        <location filename="../src/mainwindow.cpp" line="33"/>
+        <location filename="../src/mainwindow.cpp" line="41"/>
         <source>Sudoku version 0.1
 Author: Fernando B. Giannasi
 jan/2020</source>
@@ -83,14 +83,35 @@ Autor: Fernando B. Giannasi
 jan/2020</translation>
     </message>
     <message>
-        <location filename="../src/mainwindow.cpp" line="72"/>
+        <location filename="../src/mainwindow.cpp" line="82"/>
         <source>Congratulations!</source>
         <translation>Parabéns!</translation>
     </message>
     <message>
-        <location filename="../src/mainwindow.cpp" line="73"/>
+        <location filename="../src/mainwindow.cpp" line="83"/>
         <source>You won!</source>
         <translation>Você venceu!</translation>
     </message>
+    <message>
+        <location filename="../src/mainwindow.cpp" line="149"/>
+        <location filename="../src/mainwindow.cpp" line="152"/>
+        <source>Solve</source>
+        <translation>Resolver</translation>
+    </message>
+    <message>
+        <location filename="../src/mainwindow.cpp" line="150"/>
+        <source>This board has no solution.</source>
+        <translation>Este tabuleiro não tem solução.</translation>
+    </message>
+    <message>
+        <location filename="../src/mainwindow.cpp" line="153"/>
+        <source>Gave up, this board takes too long to solve.</source>
+        <translation>Desisti, este tabuleiro demora demais para resolver.</translation>
+    </message>
+    <message>
+        <location filename="../src/mainwindow.cpp" line="142"/>
+        <source>%1 nodes, %2 guesses, %3 backtracks, %4 naked singles, max depth %5</source>
+        <translation>%1 nós, %2 palpites, %3 retrocessos, %4 únicos nus, profundidade máxima %5</translation>
+    </message>
 </context>
 </TS>
@@ -0,0 +1,105 @@
+#ifndef BLOCKING_QUEUE_HPP
+#define BLOCKING_QUEUE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+
+namespace Sudoku {
+
+/* Bounded queue between pipeline stages. Push blocks while the queue is
+   full, Pop blocks while it is empty. Close() wakes everybody: Push
+   then fails and Pop drains what is left before returning nothing */
+template <typename T>
+class BlockingQueue
+{
+public:
+    explicit BlockingQueue(std::size_t capacity) : limit{capacity == 0 ? 1 : capacity} {}
+
+    bool Push(T value)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        not_full.wait(lk, [this]{ return closed || items.size() < limit; });
+        if (closed)
+            return false;
+
+        items.push_back(std::move(value));
+        lk.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    std::optional<T> Pop()
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        not_empty.wait(lk, [this]{ return closed || !items.empty(); });
+        if (items.empty())
+            return {};
+
+        return Take(lk);
+    }
+
+    /* Pop without waiting: nothing if the queue is empty */
+    std::optional<T> TryPop()
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        if (items.empty())
+            return {};
+        return Take(lk);
+    }
+
+    /* Pop waiting at most timeout: nothing if the queue stays empty */
+    template <typename Rep, typename Period>
+    std::optional<T> PopFor(std::chrono::duration<Rep, Period> timeout)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        not_empty.wait_for(lk, timeout, [this]{ return closed || !items.empty(); });
+        if (items.empty())
+            return {};
+        return Take(lk);
+    }
+
+    /* Closed and empty: Pop will never return anything again */
+    bool Drained()
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        return closed && items.empty();
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+private:
+    T Take(std::unique_lock<std::mutex>& lk)
+    {
+        T value = std::move(items.front());
+        items.pop_front();
+        lk.unlock();
+        not_full.notify_one();
+        return value;
+    }
+
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> items;
+    std::size_t limit;
+    bool closed = false;
+};
+
+
+} // End of namespace Sudoku
+
+#endif // BLOCKING_QUEUE_HPP
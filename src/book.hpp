@@ -0,0 +1,193 @@
+#ifndef BOOK_HPP
+#define BOOK_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "my_types.h"
+#include "transform.hpp"
+
+
+namespace Sudoku {
+
+/* Puzzle book: pre-generated puzzles grouped by Difficulty.
+
+   Layout, all integers little endian:
+
+       0   "SDKB"                      magic
+       4   u8  version (1)
+       5   u8  sections (3, one per Difficulty)
+       6   u16 record size (41)
+       8   u32 first record of each section, plus the end (4 values)
+       24  records
+
+   A record is a grid packed two cells per byte, the first cell in the
+   high nibble, 0 for empty cells; the 82nd nibble is padding. Within a
+   section records are sorted from the easiest to the hardest rating.
+   Finding puzzle i of a section is one multiplication, so picking a
+   random puzzle costs nothing compared to generating one */
+namespace BookFormat {
+
+constexpr std::size_t HeaderSize = 24;
+constexpr std::size_t RecordSize = 41;
+constexpr std::size_t Sections = 3;
+constexpr std::uint8_t Version = 1;
+
+} // End of namespace BookFormat
+
+/* Writes grid as one record at out */
+inline void PackGrid(const Puzzle_t& grid, unsigned char* out) noexcept
+{
+    for (std::size_t i = 0; i < BookFormat::RecordSize; ++i)
+    {
+        auto hi = grid[(2 * i) / 9][(2 * i) % 9];
+        auto lo = 2 * i + 1 < 81 ? grid[(2 * i + 1) / 9][(2 * i + 1) % 9] : 0;
+        out[i] = static_cast<unsigned char>((hi << 4) | lo);
+    }
+}
+
+inline Puzzle_t UnpackGrid(const unsigned char* in) noexcept
+{
+    Puzzle_t grid;
+    for (std::size_t cell = 0; cell < 81; ++cell)
+    {
+        auto byte = in[cell / 2];
+        grid[cell / 9][cell % 9] = cell % 2 == 0 ? byte >> 4 : byte & 0x0F;
+    }
+    return grid;
+}
+
+/* Serializes a book, sections in Difficulty order */
+inline std::vector<unsigned char> PackBook(const std::array<std::vector<Puzzle_t>, BookFormat::Sections>& sections)
+{
+    std::vector<unsigned char> bytes(BookFormat::HeaderSize);
+    bytes[0] = 'S';
+    bytes[1] = 'D';
+    bytes[2] = 'K';
+    bytes[3] = 'B';
+    bytes[4] = BookFormat::Version;
+    bytes[5] = static_cast<unsigned char>(BookFormat::Sections);
+    bytes[6] = static_cast<unsigned char>(BookFormat::RecordSize);
+    bytes[7] = 0;
+
+    auto put32 = [&](std::size_t at, std::size_t value) {
+        for (std::size_t k = 0; k < 4; ++k)
+            bytes[at + k] = static_cast<unsigned char>(value >> (8 * k));
+    };
+
+    std::size_t first = 0;
+    for (std::size_t s = 0; s < BookFormat::Sections; ++s)
+    {
+        put32(8 + 4 * s, first);
+        first += sections[s].size();
+    }
+    put32(8 + 4 * BookFormat::Sections, first);
+
+    bytes.resize(BookFormat::HeaderSize + first * BookFormat::RecordSize);
+    auto out = bytes.data() + BookFormat::HeaderSize;
+    for (const auto& section : sections)
+        for (const auto& grid : section)
+        {
+            PackGrid(grid, out);
+            out += BookFormat::RecordSize;
+        }
+
+    return bytes;
+}
+
+/* Read only view of a book held in memory (a Qt resource, a file read
+   or mapped by the caller). The bytes must outlive the view */
+class PuzzleBook
+{
+public:
+    /* Checks the header and sizes. Returns an empty optional if data is
+       not a book this version understands */
+    static std::optional<PuzzleBook> FromBytes(const unsigned char* data, std::size_t size) noexcept
+    {
+        if (data == nullptr || size < BookFormat::HeaderSize ||
+            data[0] != 'S' || data[1] != 'D' || data[2] != 'K' || data[3] != 'B' ||
+            data[4] != BookFormat::Version || data[5] != BookFormat::Sections ||
+            data[6] != BookFormat::RecordSize || data[7] != 0)
+            return {};
+
+        PuzzleBook book;
+        book.records = data + BookFormat::HeaderSize;
+
+        for (std::size_t s = 0; s <= BookFormat::Sections; ++s)
+        {
+            std::uint32_t value = 0;
+            for (std::size_t k = 0; k < 4; ++k)
+                value |= static_cast<std::uint32_t>(data[8 + 4 * s + k]) << (8 * k);
+            book.offsets[s] = value;
+
+            if (s > 0 && value < book.offsets[s - 1])
+                return {};
+        }
+
+        if (book.offsets[0] != 0 ||
+            (size - BookFormat::HeaderSize) / BookFormat::RecordSize < book.offsets[BookFormat::Sections])
+            return {};
+
+        return book;
+    }
+
+    /* Number of puzzles of one difficulty */
+    std::size_t Count(Difficulty dif) const noexcept
+    {
+        auto s = static_cast<std::size_t>(dif);
+        return offsets[s + 1] - offsets[s];
+    }
+
+    /* Puzzle index (< Count(dif)) of one difficulty */
+    Puzzle_t Get(Difficulty dif, std::size_t index) const noexcept
+    {
+        auto record = offsets[static_cast<std::size_t>(dif)] + index;
+        return UnpackGrid(records + record * BookFormat::RecordSize);
+    }
+
+    /* A puzzle of difficulty dif picked uniformly. The section must not
+       be empty */
+    template <typename Gen>
+    Puzzle_t Random(Difficulty dif, Gen& gen) const
+    {
+        std::uniform_int_distribution<std::size_t> pick(0, Count(dif) - 1);
+        return Get(dif, pick(gen));
+    }
+
+    /* A random puzzle of the book under a random Transform. Same grade
+       as the book's puzzle, and with 2 * 9! * 6^8 transforms per puzzle
+       a small book never repeats itself in practice */
+    template <typename Gen>
+    Puzzle_t RandomVariant(Difficulty dif, Gen& gen) const
+    {
+        return Sudoku::RandomVariant(Random(dif, gen), gen);
+    }
+
+private:
+    PuzzleBook() = default;
+
+    const unsigned char* records = nullptr;
+    std::array<std::size_t, BookFormat::Sections + 1> offsets{};
+};
+
+/* Reads a whole book file, for the tools. Empty if it cannot be read */
+inline std::vector<unsigned char> ReadBookFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return {};
+
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+
+} // End of namespace Sudoku
+
+#endif // BOOK_HPP
@@ -0,0 +1,141 @@
+#ifndef BUDGET_HPP
+#define BUDGET_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "my_types.h"
+
+
+namespace Sudoku {
+
+enum class SolveStatus
+{
+    Solved,         // a solution was found
+    Unsolvable,     // the whole tree was searched, there is no solution
+    BudgetExceeded, // max_nodes or the deadline ran out first
+    Cancelled       // the cancel flag was raised
+};
+
+inline const char* StatusName(SolveStatus status) noexcept
+{
+    switch (status)
+    {
+        case SolveStatus::Solved:
+            return "solved";
+        case SolveStatus::Unsolvable:
+            return "unsolvable";
+        case SolveStatus::BudgetExceeded:
+            return "budget-exceeded";
+        case SolveStatus::Cancelled:
+            return "cancelled";
+    }
+    return "unknown";
+}
+
+/* Limits for a single solve. The defaults search without limits */
+struct SolveOptions
+{
+    std::uint64_t max_nodes = 0; // 0 means unlimited
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    const std::atomic<bool>* cancel = nullptr;
+
+    /* Sets the deadline to now + timeout */
+    SolveOptions& Timeout(std::chrono::steady_clock::duration timeout)
+    {
+        deadline = std::chrono::steady_clock::now() + timeout;
+        return *this;
+    }
+};
+
+/* Grid is Puzzle_t, or a larger grid for the searches that take one
+   (BoxGrid) */
+template <typename Grid>
+struct BasicSolveResult
+{
+    SolveStatus status = SolveStatus::Unsolvable;
+    Grid grid{};             // the solution if solved, the input otherwise
+    std::uint64_t nodes = 0; // search nodes spent
+
+    bool Solved() const noexcept {return status == SolveStatus::Solved;}
+};
+
+using SolveResult = BasicSolveResult<Puzzle_t>;
+
+
+/* Node counter that enforces SolveOptions.
+
+   Engines call Tick() once per search node. Only every CheckInterval-th
+   call looks at the clock and the flags, so the hot loop pays one
+   increment and one mask test. Searches sharing one max_nodes (the
+   parallel solver) charge their nodes to a shared counter at each check
+   point, and can be stopped as a group through a second flag */
+class Budget
+{
+public:
+    static constexpr std::uint64_t CheckInterval = 1024; // power of two
+
+    Budget() = default;
+
+    explicit Budget(const SolveOptions& opt,
+                    const std::atomic<bool>* group_stop = nullptr,
+                    std::atomic<std::uint64_t>* shared_nodes = nullptr) noexcept
+        : options{opt}, group{group_stop}, shared{shared_nodes} {}
+
+    /* Counts one node. Returns true once the search must stop.
+       The first node is a check point too, so a search started after
+       its deadline or cancellation stops right away */
+    bool Tick() noexcept
+    {
+        if ((nodes++ & (CheckInterval - 1)) != 0)
+            return false;
+        return Check();
+    }
+
+    bool Stopped() const noexcept {return reason.has_value();}
+
+    /* Why the search stopped, only meaningful if Stopped() */
+    SolveStatus Reason() const noexcept {return reason.value_or(SolveStatus::Unsolvable);}
+
+    std::uint64_t Nodes() const noexcept {return nodes;}
+
+    /* Result status of a search that returned without a solution */
+    SolveStatus Failure() const noexcept {return Stopped() ? Reason() : SolveStatus::Unsolvable;}
+
+private:
+    bool Check() noexcept
+    {
+        if ((options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed)) ||
+            (group != nullptr && group->load(std::memory_order_relaxed)))
+        {
+            reason = SolveStatus::Cancelled;
+            return true;
+        }
+
+        auto spent = shared != nullptr
+                   ? shared->fetch_add(CheckInterval, std::memory_order_relaxed) + CheckInterval
+                   : nodes;
+
+        if ((options.max_nodes != 0 && spent >= options.max_nodes) ||
+            (options.deadline && std::chrono::steady_clock::now() >= *options.deadline))
+        {
+            reason = SolveStatus::BudgetExceeded;
+            return true;
+        }
+
+        return false;
+    }
+
+    SolveOptions options;
+    const std::atomic<bool>* group = nullptr;
+    std::atomic<std::uint64_t>* shared = nullptr;
+    std::uint64_t nodes = 0;
+    std::optional<SolveStatus> reason;
+};
+
+
+} // End of namespace Sudoku
+
+#endif // BUDGET_HPP
@@ -0,0 +1,593 @@
+#ifndef CANONICAL_HPP
+#define CANONICAL_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "my_types.h"
+#include "transform.hpp"
+
+
+namespace Sudoku {
+
+/* The canonical representative of a grid and the transform that
+   produces it: transform.Apply(input) == grid */
+struct CanonicalForm
+{
+    Puzzle_t grid{};
+    Transform transform = Transform::Identity();
+};
+
+/* 64 bit FNV-1a of a grid's cells. Hashing the canonical grid gives a
+   key shared by every puzzle equivalent to it */
+inline std::uint64_t HashGrid(const Puzzle_t& grid) noexcept
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const auto& row : grid)
+        for (auto num : row)
+        {
+            hash ^= static_cast<std::uint64_t>(num);
+            hash *= 1099511628211ull;
+        }
+    return hash;
+}
+
+namespace detail {
+
+constexpr std::uint8_t Unbound = 0xFF;
+
+/* A partial transform still tied for the minimum: the source rows
+   placed so far, the labels handed out and the columns bound so far.
+
+   Columns are bound lazily. A column blank in every row placed so far
+   can take any free position of its stack, so such positions stay
+   Unbound, and so do whole slots (output stacks) while any of the
+   stacks still blank everywhere could fill them. Rows only bind the
+   columns where they have a clue, which keeps sparse puzzles from
+   splitting into a candidate per column order */
+struct MinLexCandidate
+{
+    std::array<std::uint8_t, 9> rows;
+    std::array<std::uint8_t, 9> cols;    // source column of each position
+    std::array<std::uint8_t, 3> stacks;  // source stack of each slot
+    std::array<std::uint8_t, 10> labels; // 0 for digits not seen yet
+    std::uint8_t next_label;
+    std::uint8_t used_bands;             // bit b: band b already placed
+    bool transpose;
+};
+
+/* Places one more row: Extend() tries a candidate with a source row and
+   keeps in next every binding of its free columns that gives a row tied
+   with best, dropping them all when a smaller row shows up */
+class MinLexStep
+{
+public:
+    std::array<std::uint8_t, 9> best;
+    std::vector<MinLexCandidate> next;
+
+    void Reset()
+    {
+        best.fill(10);
+        next.clear();
+    }
+
+    void Extend(const MinLexCandidate& cand, const std::uint8_t* source)
+    {
+        if (std::find(cand.cols.begin(), cand.cols.end(), Unbound) == cand.cols.end())
+        {
+            ExtendBound(cand, source);
+            return;
+        }
+
+        row = source;
+        blank_stacks = 0;
+        for (std::uint8_t s = 0; s < 3; ++s)
+            if (!Bound(cand, s) && row[s * 3] == 0 && row[s * 3 + 1] == 0 && row[s * 3 + 2] == 0)
+                ++blank_stacks;
+
+        std::array<std::uint8_t, 9> out;
+        Slot(cand, 0, out, 0);
+    }
+
+private:
+    /* The ways to fill one slot that give its smallest three values */
+    struct Options
+    {
+        std::array<std::uint8_t, 3> values;
+        std::array<MinLexCandidate, 18> cands; // 3 stacks * 3! orders
+        std::size_t count = 0;
+    };
+
+    const std::uint8_t* row = nullptr;
+    std::size_t blank_stacks = 0;
+
+    static bool Bound(const MinLexCandidate& cand, std::uint8_t stack) noexcept
+    {
+        return cand.stacks[0] == stack || cand.stacks[1] == stack || cand.stacks[2] == stack;
+    }
+
+    /* Every column bound: one way to write the row, given up at the
+       first cell greater than best. The common case past the first
+       rows, and for every row of a solution grid but the first */
+    void ExtendBound(const MinLexCandidate& cand, const std::uint8_t* source)
+    {
+        auto trial = cand;
+        std::array<std::uint8_t, 9> out;
+        bool less = false;
+
+        for (std::size_t c = 0; c < 9; ++c)
+        {
+            auto num = source[trial.cols[c]];
+            if (num != 0 && trial.labels[num] == 0)
+                trial.labels[num] = trial.next_label++;
+
+            out[c] = trial.labels[num];
+            if (!less && out[c] != best[c])
+            {
+                if (out[c] > best[c])
+                    return;
+                less = true;
+            }
+        }
+
+        Finish(trial, out);
+    }
+
+    /* Fills slot s, then the slots after it. lazy counts the unbound
+       slots left blank in this row, each standing for one blank stack */
+    void Slot(const MinLexCandidate& cand, std::size_t s, std::array<std::uint8_t, 9>& out, std::size_t lazy)
+    {
+        if (s == 3)
+        {
+            Finish(cand, out);
+            return;
+        }
+
+        // Three blanks are the smallest a slot can get, and any blank
+        // stack gives them, so the slot stays unbound
+        if (cand.stacks[s] == Unbound && lazy < blank_stacks)
+        {
+            out[s * 3] = out[s * 3 + 1] = out[s * 3 + 2] = 0;
+            if (!Greater(out, s * 3 + 3))
+                Slot(cand, s + 1, out, lazy + 1);
+            return;
+        }
+
+        Options options;
+        if (cand.stacks[s] != Unbound)
+            Arrange(cand, s, options);
+        else
+        {
+            for (std::uint8_t stack = 0; stack < 3; ++stack)
+            {
+                if (Bound(cand, stack) ||
+                    (row[stack * 3] == 0 && row[stack * 3 + 1] == 0 && row[stack * 3 + 2] == 0))
+                    continue; // blank stacks all went to the lazy slots
+
+                auto bound = cand;
+                bound.stacks[s] = stack;
+                Arrange(bound, s, options);
+            }
+        }
+
+        for (std::size_t i = 0; i < 3; ++i)
+            out[s * 3 + i] = options.values[i];
+        if (Greater(out, s * 3 + 3))
+            return;
+
+        for (std::size_t k = 0; k < options.count; ++k)
+            Slot(options.cands[k], s + 1, out, lazy);
+    }
+
+    /* Adds to options the orders of the free columns of slot s (whose
+       stack is bound) that give the smallest values. Blank columns take
+       the first free positions and stay unbound; only the order of the
+       others matters */
+    void Arrange(const MinLexCandidate& cand, std::size_t s, Options& options) const
+    {
+        auto stack = cand.stacks[s];
+        std::array<std::uint8_t, 3> clued;
+        std::size_t blanks = 0, nclued = 0;
+        for (std::uint8_t c = stack * 3; c < stack * 3 + 3; ++c)
+            if (cand.cols[s * 3] != c && cand.cols[s * 3 + 1] != c && cand.cols[s * 3 + 2] != c)
+            {
+                if (row[c] == 0)
+                    ++blanks;
+                else
+                    clued[nclued++] = c;
+            }
+
+        // The orders of up to 3 clued columns: the first Permutations[n] serve n columns
+        static constexpr std::uint8_t Orders[6][3] = {{0, 1, 2}, {1, 0, 2}, {0, 2, 1}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+        static constexpr std::size_t Permutations[4] = {1, 1, 2, 6};
+
+        for (std::size_t p = 0; p < Permutations[nclued]; ++p)
+        {
+            auto trial = cand;
+            std::array<std::uint8_t, 3> values;
+            std::size_t b = 0, f = 0;
+
+            for (std::size_t i = 0; i < 3; ++i)
+            {
+                auto& col = trial.cols[s * 3 + i];
+                if (col == Unbound && b < blanks)
+                {
+                    ++b;
+                    values[i] = 0;
+                    continue;
+                }
+                if (col == Unbound)
+                    col = clued[Orders[p][f++]];
+
+                auto num = row[col];
+                if (num != 0 && trial.labels[num] == 0)
+                    trial.labels[num] = trial.next_label++;
+                values[i] = trial.labels[num];
+            }
+
+            if (options.count > 0 && values != options.values)
+            {
+                if (values > options.values)
+                    continue;
+                options.count = 0;
+            }
+
+            options.values = values;
+            options.cands[options.count++] = trial;
+        }
+    }
+
+    bool Greater(const std::array<std::uint8_t, 9>& out, std::size_t length) const noexcept
+    {
+        return std::lexicographical_compare(best.begin(), best.begin() + length, out.begin(), out.begin() + length);
+    }
+
+    void Finish(const MinLexCandidate& cand, const std::array<std::uint8_t, 9>& out)
+    {
+        if (out < best)
+        {
+            best = out;
+            next.clear();
+        }
+        if (out == best)
+            next.push_back(cand);
+    }
+};
+
+/* Whether a band of a solution grid is pure: the minirows of its second
+   row hold the same digits as the minirows of its first, only moved to
+   other stacks. One stack tells, as the other two then have no choice.
+   The canonical second row starts 4 5 6 only under a pure top band,
+   any other gives at best 4 5 7, so pure bands, when there are any,
+   are the only ones worth trying on top */
+inline bool PureBand(const std::uint8_t* first, const std::uint8_t* second) noexcept
+{
+    auto digits = [](const std::uint8_t* minirow) {
+        return (1u << minirow[0]) | (1u << minirow[1]) | (1u << minirow[2]);
+    };
+    auto mini = digits(second);
+    return mini == digits(first + 3) || mini == digits(first + 6);
+}
+
+/* Places the first two rows of a solution grid together. The first row
+   reads 1 2 ... 9 under every column order, so binding its columns
+   would leave 1296 ties per source row. Instead columns are bound for
+   the second row: the digit at position c of the second row is labeled
+   with the position of the column holding it in the first row, so that
+   column either is placed already or goes to the first position its
+   stack may still take, which gives the smallest value at c. Only the
+   choice of column at positions nothing has bound yet branches */
+class SolutionTopRows
+{
+public:
+    std::array<std::uint8_t, 9> best; // the second row
+    std::vector<MinLexCandidate> next;
+
+    void Reset()
+    {
+        best.fill(10);
+        next.clear();
+    }
+
+    void Extend(const MinLexCandidate& cand, const std::uint8_t* first, const std::uint8_t* second)
+    {
+        row = first;
+        for (std::uint8_t c = 0; c < 9; ++c)
+            for (std::uint8_t j = 0; j < 9; ++j)
+                if (first[j] == second[c])
+                    above[c] = j;
+
+        std::array<std::uint8_t, 9> out;
+        Place(cand, 0, out);
+    }
+
+private:
+    const std::uint8_t* row = nullptr;
+    std::array<std::uint8_t, 9> above; // column of the first row with the digit of each column of the second
+
+    static bool Bound(const MinLexCandidate& cand, std::uint8_t stack) noexcept
+    {
+        return cand.stacks[0] == stack || cand.stacks[1] == stack || cand.stacks[2] == stack;
+    }
+
+    void Place(const MinLexCandidate& cand, std::size_t c, std::array<std::uint8_t, 9>& out)
+    {
+        if (c == 9)
+        {
+            Finish(cand, out);
+            return;
+        }
+        if (cand.cols[c] != Unbound)
+        {
+            Follow(cand, c, out);
+            return;
+        }
+
+        auto s = c / 3;
+        for (std::uint8_t stack = 0; stack < 3; ++stack)
+        {
+            if (cand.stacks[s] != Unbound ? cand.stacks[s] != stack : Bound(cand, stack))
+                continue;
+
+            for (std::uint8_t col = stack * 3; col < stack * 3 + 3; ++col)
+            {
+                if (std::find(cand.cols.begin(), cand.cols.end(), col) != cand.cols.end())
+                    continue;
+
+                auto trial = cand;
+                trial.stacks[s] = stack;
+                trial.cols[c] = col;
+                Follow(trial, c, out);
+            }
+        }
+    }
+
+    /* Position c is bound: places the first row column its digit labels
+       with, if it is not placed yet, and goes on unless that makes the
+       row greater than best */
+    void Follow(MinLexCandidate cand, std::size_t c, std::array<std::uint8_t, 9>& out)
+    {
+        auto col = above[cand.cols[c]];
+        auto pos = static_cast<std::size_t>(std::find(cand.cols.begin(), cand.cols.end(), col) - cand.cols.begin());
+        if (pos == 9)
+        {
+            auto stack = static_cast<std::uint8_t>(col / 3);
+            std::size_t s = 0;
+            while (s < 3 && cand.stacks[s] != stack)
+                ++s;
+            if (s == 3)
+            {
+                s = 0;
+                while (cand.stacks[s] != Unbound)
+                    ++s;
+                cand.stacks[s] = stack;
+            }
+
+            pos = s * 3;
+            while (cand.cols[pos] != Unbound)
+                ++pos;
+            cand.cols[pos] = col;
+        }
+
+        out[c] = static_cast<std::uint8_t>(pos + 1);
+        if (!std::lexicographical_compare(best.begin(), best.begin() + c + 1, out.begin(), out.begin() + c + 1))
+            Place(cand, c + 1, out);
+    }
+
+    void Finish(MinLexCandidate cand, const std::array<std::uint8_t, 9>& out)
+    {
+        for (std::size_t c = 0; c < 9; ++c)
+            cand.labels[row[cand.cols[c]]] = static_cast<std::uint8_t>(c + 1);
+        cand.next_label = 10;
+
+        if (out < best)
+        {
+            best = out;
+            next.clear();
+        }
+        if (out == best)
+            next.push_back(cand);
+    }
+};
+
+} // End of namespace detail
+
+/* Maps grid to the lexicographically smallest grid it can be turned
+   into by the 3,359,232 Sudoku symmetries (transpose, band, row, stack
+   and column permutations) and a relabeling of the digits. Blanks
+   count as 0, so canonical puzzles start with their empty cells. Two
+   puzzles are equivalent exactly when their canonical grids are equal.
+
+   Rows are placed one at a time. For each row every candidate still
+   tied for the minimum is tried with every source row it may take
+   next, and candidates fall out at the first slot where they compare
+   greater than the best row so far. Digits are labeled in order of
+   first appearance, which is the smallest labeling for a fixed cell
+   order, and columns are only bound once a clue tells them apart */
+inline CanonicalForm Canonicalize(const Puzzle_t& grid)
+{
+    using detail::MinLexCandidate;
+    using detail::Unbound;
+
+    std::array<std::array<std::uint8_t, 81>, 2> source; // as is, transposed
+    std::size_t clues = 0;
+    for (std::size_t r = 0; r < 9; ++r)
+        for (std::size_t c = 0; c < 9; ++c)
+        {
+            source[0][r * 9 + c] = static_cast<std::uint8_t>(grid[r][c]);
+            source[1][c * 9 + r] = static_cast<std::uint8_t>(grid[r][c]);
+            clues += grid[r][c] != 0;
+        }
+
+    CanonicalForm form;
+    std::vector<MinLexCandidate> current;
+    detail::MinLexStep step;
+
+    auto first = [](std::uint8_t t, std::uint8_t r) {
+        MinLexCandidate cand;
+        cand.rows[0] = r;
+        cand.cols.fill(Unbound);
+        cand.stacks.fill(Unbound);
+        cand.labels.fill(0);
+        cand.next_label = 1;
+        cand.used_bands = static_cast<std::uint8_t>(1u << (r / 3));
+        cand.transpose = t != 0;
+        return cand;
+    };
+
+    std::size_t k = 0;      // rows done
+    std::size_t placed = 0; // clues in the rows done, the same for every candidate
+    if (clues == 81)
+    {
+        // Solution grid: the first two rows of every top band worth
+        // trying, the pure ones if there are any
+        std::array<bool, 6> pure;
+        bool any_pure = false;
+        for (std::size_t b = 0; b < 6; ++b)
+        {
+            const auto* band = &source[b / 3][b % 3 * 27];
+            pure[b] = detail::PureBand(band, band + 9);
+            any_pure = any_pure || pure[b];
+        }
+
+        detail::SolutionTopRows top;
+        top.Reset();
+        for (std::uint8_t t = 0; t < 2; ++t)
+            for (std::uint8_t r = 0; r < 9; ++r)
+            {
+                if (any_pure && !pure[t * 3 + r / 3])
+                    continue;
+
+                for (std::uint8_t second = r / 3 * 3; second < r / 3 * 3 + 3; ++second)
+                    if (second != r)
+                    {
+                        auto cand = first(t, r);
+                        cand.rows[1] = second;
+                        top.Extend(cand, &source[t][r * 9], &source[t][second * 9]);
+                    }
+            }
+
+        current.swap(top.next);
+        for (std::size_t c = 0; c < 9; ++c)
+        {
+            form.grid[0][c] = c + 1;
+            form.grid[1][c] = top.best[c];
+        }
+        k = 2;
+        placed = 18;
+    }
+    else
+    {
+        // First row: every transpose and source row, nothing bound yet
+        step.Reset();
+        for (std::uint8_t t = 0; t < 2; ++t)
+            for (std::uint8_t r = 0; r < 9; ++r)
+                step.Extend(first(t, r), &source[t][r * 9]);
+
+        current.swap(step.next);
+        for (std::size_t c = 0; c < 9; ++c)
+        {
+            form.grid[0][c] = step.best[c];
+            placed += step.best[c] != 0;
+        }
+        k = 1;
+    }
+
+    // Remaining rows: the next row of the current band, or the first
+    // row of a band not placed yet. Once every clue is placed the rest
+    // is blank whatever the order
+    for (; k < 9 && placed < clues; ++k)
+    {
+        step.Reset();
+
+        for (const auto& base : current)
+        {
+            auto band = base.rows[k - 1] / 3;
+
+            for (std::uint8_t r = 0; r < 9; ++r)
+            {
+                if (k % 3 != 0)
+                {
+                    if (r / 3 != band || std::find(base.rows.begin(), base.rows.begin() + k, r) !=
+                                         base.rows.begin() + k)
+                        continue;
+                }
+                else if (base.used_bands & (1u << (r / 3)))
+                    continue;
+
+                auto cand = base;
+                cand.rows[k] = r;
+                cand.used_bands = static_cast<std::uint8_t>(cand.used_bands | (1u << (r / 3)));
+
+                step.Extend(cand, &source[cand.transpose][r * 9]);
+            }
+        }
+
+        current.swap(step.next);
+        for (std::size_t c = 0; c < 9; ++c)
+        {
+            form.grid[k][c] = step.best[c];
+            placed += step.best[c] != 0;
+        }
+    }
+
+    // Any survivor gives the minimum. Complete its rows if it stopped
+    // early: first the current band, then the bands left in order
+    auto& winner = current.front();
+    for (; k < 9; ++k)
+    {
+        auto band = k % 3 != 0 ? winner.rows[k - 1] / 3 : 0;
+        for (std::uint8_t r = 0; r < 9; ++r)
+        {
+            bool fits = k % 3 != 0 ? r / 3 == band : (winner.used_bands & (1u << (r / 3))) == 0;
+            if (fits && std::find(winner.rows.begin(), winner.rows.begin() + k, r) == winner.rows.begin() + k)
+            {
+                winner.rows[k] = r;
+                winner.used_bands = static_cast<std::uint8_t>(winner.used_bands | (1u << (r / 3)));
+                break;
+            }
+        }
+
+        for (auto& cell : form.grid[k])
+            cell = 0;
+    }
+
+    // Columns still unbound are blank everywhere: any order will do
+    for (std::size_t s = 0; s < 3; ++s)
+    {
+        for (std::uint8_t stack = 0; winner.stacks[s] == Unbound; ++stack)
+            if (std::find(winner.stacks.begin(), winner.stacks.end(), stack) == winner.stacks.end())
+                winner.stacks[s] = stack;
+
+        auto first = winner.cols.begin() + s * 3;
+        for (std::size_t i = 0; i < 3; ++i)
+            for (std::uint8_t c = winner.stacks[s] * 3; first[i] == Unbound; ++c)
+                if (std::find(first, first + 3, c) == first + 3)
+                    first[i] = c;
+    }
+
+    // Hand the digits missing from the grid the labels left, in order
+    for (std::size_t d = 1; d <= 9; ++d)
+        if (winner.labels[d] == 0)
+            winner.labels[d] = winner.next_label++;
+
+    form.transform.transpose = winner.transpose;
+    form.transform.rows = winner.rows;
+    form.transform.cols = winner.cols;
+    form.transform.digits = winner.labels;
+
+    return form;
+}
+
+/* HashGrid of the canonical grid: the same for every variant of grid */
+inline std::uint64_t CanonicalHash(const Puzzle_t& grid)
+{
+    return HashGrid(Canonicalize(grid).grid);
+}
+
+} // End of namespace Sudoku
+
+#endif // CANONICAL_HPP
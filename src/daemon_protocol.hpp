@@ -0,0 +1,87 @@
+#ifndef DAEMON_PROTOCOL_HPP
+#define DAEMON_PROTOCOL_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+
+namespace Sudoku {
+
+/* Line protocol of sudokud, over a Unix stream socket.
+
+   A client writes one request per line and gets one reply line per
+   request, in the order of the requests, whatever order the solver
+   pool finishes them in. A request is a puzzle in the 81 character
+   format of io.hpp, or the word "stats". The reply to a puzzle is
+
+       GRID STATUS NODES MICROSECONDS
+
+   where GRID is the solution, or the puzzle as given if it was not
+   solved, STATUS one of the StatusName() words or "invalid", NODES the
+   search nodes spent (0 on a cache hit) and MICROSECONDS the solve
+   time. The reply to "stats" is "stats" followed by key=value counters
+   of the whole daemon. Closing the write side makes the daemon send
+   the replies still owed and close the connection */
+namespace Daemon {
+
+constexpr std::string_view StatsRequest = "stats";
+
+/* $SUDOKUD_SOCKET, else sudokud.sock in $XDG_RUNTIME_DIR, else in /tmp
+   with the user id in the name */
+inline std::string DefaultSocketPath()
+{
+    if (auto path = std::getenv("SUDOKUD_SOCKET"); path != nullptr && *path != '\0')
+        return path;
+    if (auto dir = std::getenv("XDG_RUNTIME_DIR"); dir != nullptr && *dir != '\0')
+        return std::string(dir) + "/sudokud.sock";
+    return "/tmp/sudokud-" + std::to_string(::getuid()) + ".sock";
+}
+
+struct Reply
+{
+    std::string grid;
+    std::string status;
+    std::uint64_t nodes = 0;
+    std::uint64_t micros = 0;
+
+    bool Solved() const noexcept {return status == "solved";}
+};
+
+inline std::string FormatReply(std::string_view grid, std::string_view status,
+                               std::uint64_t nodes, std::uint64_t micros)
+{
+    std::string line;
+    line.reserve(grid.size() + status.size() + 24);
+    line += grid;
+    line += ' ';
+    line += status;
+    line += ' ';
+    line += std::to_string(nodes);
+    line += ' ';
+    line += std::to_string(micros);
+    line += '\n';
+    return line;
+}
+
+/* Empty if line is not a puzzle reply */
+inline std::optional<Reply> ParseReply(const std::string& line)
+{
+    std::istringstream in(line);
+    Reply reply;
+    if (!(in >> reply.grid >> reply.status >> reply.nodes >> reply.micros))
+        return {};
+    return reply;
+}
+
+} // End of namespace Daemon
+
+
+} // End of namespace Sudoku
+
+#endif // DAEMON_PROTOCOL_HPP
@@ -0,0 +1,254 @@
+#ifndef DLX_HPP
+#define DLX_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "my_types.h"
+#include "budget.hpp"
+#include "stats.hpp"
+
+
+namespace Sudoku {
+
+/* Knuth's Algorithm X with dancing links, applied to the exact cover
+   form of Sudoku: 324 constraints (cell filled, digit once per row,
+   column and box) and 729 candidate placements covering 4 each.
+
+   It searches a very different tree from the cell based backtrackers,
+   which is what makes it useful next to them in the portfolio solver.
+
+   A constraint column with a single row left is a forced move: a naked
+   single for the cell constraints, a hidden single for the others */
+template <typename Stats = NoStats>
+class BasicDancingLinks
+{
+public:
+    explicit BasicDancingLinks(const Puzzle_t& grid)
+    {
+        constexpr std::size_t Columns = 324;
+        nodes.reserve(Columns + 1 + 729 * 4);
+        sizes.assign(Columns + 1, 0);
+
+        // Header list: node 0 is the root, nodes 1..324 the columns
+        for (std::size_t i = 0; i <= Columns; ++i)
+            nodes.push_back(Node{i == 0 ? Columns : i - 1, i == Columns ? 0 : i + 1, i, i, i, 0});
+
+        for (std::size_t row = 0; row < 9; ++row)
+            for (std::size_t col = 0; col < 9; ++col)
+                for (std::size_t num = 1; num <= 9; ++num)
+                    AddRow(row, col, num);
+
+        // Givens are chosen up front
+        for (std::size_t row = 0; row < 9; ++row)
+            for (std::size_t col = 0; col < 9; ++col)
+            {
+                auto num = grid[row][col];
+                if (num == 0)
+                    continue;
+
+                if (num > 9 || !Uncovered(row_start[(row * 9 + col) * 9 + num - 1]))
+                {
+                    consistent = false;
+                    return;
+                }
+
+                auto first = row_start[(row * 9 + col) * 9 + num - 1];
+
+                SelectRow(first);
+                solution.push_back(first);
+            }
+
+        givens = solution.size();
+    }
+
+    /* Limits the search, see Budget */
+    void SetBudget(const Budget& b) noexcept {budget = b;}
+
+    /* Status to report when Solve() returned false */
+    SolveStatus Failure() const noexcept {return budget.Failure();}
+
+    std::uint64_t Nodes() const noexcept {return budget.Nodes();}
+
+    /* The statistics policy, holding a SolveStats with CollectStats */
+    const Stats& GetStats() const noexcept {return stats;}
+
+    /* Finds one exact cover. On success grid is filled in */
+    bool Solve(Puzzle_t& grid)
+    {
+        if (!consistent)
+            return false;
+
+        stats.Start();
+        bool found = Search();
+        stats.Stop();
+
+        if (!found)
+            return false;
+
+        for (auto node : solution)
+        {
+            auto id = nodes[node].id;
+            grid[id / 81][(id / 9) % 9] = id % 9 + 1;
+        }
+
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        std::size_t left, right, up, down, column;
+        std::size_t id; // candidate number: (row*9 + col)*9 + num-1
+    };
+
+    void AddRow(std::size_t row, std::size_t col, std::size_t num)
+    {
+        std::size_t id = (row * 9 + col) * 9 + num - 1;
+        std::size_t box = (row / 3) * 3 + col / 3;
+        std::array<std::size_t, 4> columns{
+            1 + row * 9 + col,
+            1 + 81 + row * 9 + num - 1,
+            1 + 162 + col * 9 + num - 1,
+            1 + 243 + box * 9 + num - 1
+        };
+
+        auto first = nodes.size();
+        row_start[id] = first;
+
+        for (std::size_t k = 0; k < 4; ++k)
+        {
+            auto c = columns[k];
+            auto self = nodes.size();
+            nodes.push_back(Node{k == 0 ? first + 3 : self - 1,
+                                 k == 3 ? first : self + 1,
+                                 nodes[c].up, c, c, id});
+            nodes[nodes[c].up].down = self;
+            nodes[c].up = self;
+            ++sizes[c];
+        }
+    }
+
+    /* True if no column of this row has been covered yet */
+    bool Uncovered(std::size_t row) const noexcept
+    {
+        auto n = row;
+        do
+        {
+            auto c = nodes[n].column;
+            if (nodes[nodes[c].left].right != c)
+                return false;
+            n = nodes[n].right;
+        }
+        while (n != row);
+        return true;
+    }
+
+    void Cover(std::size_t c) noexcept
+    {
+        nodes[nodes[c].right].left = nodes[c].left;
+        nodes[nodes[c].left].right = nodes[c].right;
+
+        for (auto i = nodes[c].down; i != c; i = nodes[i].down)
+            for (auto j = nodes[i].right; j != i; j = nodes[j].right)
+            {
+                nodes[nodes[j].down].up = nodes[j].up;
+                nodes[nodes[j].up].down = nodes[j].down;
+                --sizes[nodes[j].column];
+            }
+    }
+
+    void Uncover(std::size_t c) noexcept
+    {
+        for (auto i = nodes[c].up; i != c; i = nodes[i].up)
+            for (auto j = nodes[i].left; j != i; j = nodes[j].left)
+            {
+                ++sizes[nodes[j].column];
+                nodes[nodes[j].down].up = j;
+                nodes[nodes[j].up].down = j;
+            }
+
+        nodes[nodes[c].right].left = c;
+        nodes[nodes[c].left].right = c;
+    }
+
+    void SelectRow(std::size_t row) noexcept
+    {
+        Cover(nodes[row].column);
+        for (auto j = nodes[row].right; j != row; j = nodes[j].right)
+            Cover(nodes[j].column);
+    }
+
+    void UnselectRow(std::size_t row) noexcept
+    {
+        for (auto j = nodes[row].left; j != row; j = nodes[j].left)
+            Uncover(nodes[j].column);
+        Uncover(nodes[row].column);
+    }
+
+    bool Search()
+    {
+        if (nodes[0].right == 0)
+            return true;
+
+        if (budget.Tick())
+            return false;
+
+        // Column with the fewest rows left
+        auto best = nodes[0].right;
+        for (auto c = nodes[best].right; c != 0; c = nodes[c].right)
+            if (sizes[c] < sizes[best])
+                best = c;
+
+        if (sizes[best] == 0)
+        {
+            stats.Backtrack();
+            return false;
+        }
+
+        for (auto r = nodes[best].down; r != best; r = nodes[r].down)
+        {
+            stats.Node();
+            if (sizes[best] > 1)
+                stats.Guess();
+            else if (best <= 81)
+                stats.NakedSingle();
+            else
+                stats.HiddenSingle();
+
+            SelectRow(r);
+            solution.push_back(r);
+            stats.Depth(solution.size() - givens);
+
+            if (Search())
+                return true;
+
+            solution.pop_back();
+            UnselectRow(r);
+
+            if (budget.Stopped())
+                return false;
+        }
+
+        stats.Backtrack();
+        return false;
+    }
+
+    std::vector<Node> nodes;
+    std::vector<std::size_t> sizes;
+    std::array<std::size_t, 729> row_start{};
+    std::vector<std::size_t> solution;
+    std::size_t givens = 0;
+    Budget budget;
+    Stats stats;
+    bool consistent = true;
+};
+
+using DancingLinks = BasicDancingLinks<NoStats>;
+
+
+} // End of namespace Sudoku
+
+#endif // DLX_HPP
@@ -0,0 +1,156 @@
+#ifndef ENGINES_HPP
+#define ENGINES_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string_view>
+
+#include "my_types.h"
+#include "budget.hpp"
+#include "dlx.hpp"
+#include "search.hpp"
+#include "solver.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+
+namespace Sudoku {
+
+/* The solving engines available in this tree */
+enum class Engine
+{
+    Naive,      // SolveSudoku: first empty cell, digits in order
+    MRV,        // SearchState: bitmasks, fewest candidates first
+    RandomMRV,  // SearchState with a random digit order
+    DLX         // DancingLinks: exact cover
+};
+
+inline const char* EngineName(Engine engine) noexcept
+{
+    switch (engine)
+    {
+        case Engine::Naive:
+            return "naive";
+        case Engine::MRV:
+            return "mrv";
+        case Engine::RandomMRV:
+            return "random-mrv";
+        case Engine::DLX:
+            return "dlx";
+    }
+    return "unknown";
+}
+
+/* Inverse of EngineName */
+inline std::optional<Engine> EngineFromName(std::string_view name) noexcept
+{
+    for (auto engine : {Engine::Naive, Engine::MRV, Engine::RandomMRV, Engine::DLX})
+        if (name == EngineName(engine))
+            return engine;
+
+    return {};
+}
+
+namespace detail {
+
+/* Runs engine on grid under an already built budget, with the
+   statistics policy Stats (see stats.hpp) */
+template <typename Stats>
+SolveResult RunEngine(Engine engine, const Puzzle_t& grid, const Budget& budget,
+                      std::uint64_t seed, Stats& stats)
+{
+    SolveResult result;
+    result.grid = grid;
+
+    switch (engine)
+    {
+        case Engine::Naive:
+        {
+            SUDOKU_TRACE_SCOPE("solve/naive");
+
+            auto b = budget;
+            stats.Start();
+            bool solved = SolveSudoku(result.grid, b, stats);
+            stats.Stop();
+            result.status = solved ? SolveStatus::Solved : b.Failure();
+            result.nodes = b.Nodes();
+            break;
+        }
+        case Engine::MRV:
+        case Engine::RandomMRV:
+        {
+            SUDOKU_TRACE_SCOPE("solve/mrv");
+
+            BasicSearchState<Stats> state(grid);
+            state.SetBudget(budget);
+
+            if (engine == Engine::RandomMRV)
+            {
+                std::array<std::uint8_t, 9> order;
+                std::iota(order.begin(), order.end(), std::uint8_t{0});
+                std::mt19937_64 gen(seed);
+                std::shuffle(order.begin(), order.end(), gen);
+                state.SetValueOrder(order);
+            }
+
+            bool solved = state.Next();
+            if (solved)
+                result.grid = state.Grid();
+            result.status = solved ? SolveStatus::Solved : state.Failure();
+            result.nodes = state.Nodes();
+            stats = state.GetStats();
+            break;
+        }
+        case Engine::DLX:
+        {
+            SUDOKU_TRACE_SCOPE("solve/dlx");
+
+            BasicDancingLinks<Stats> dlx(grid);
+            dlx.SetBudget(budget);
+
+            bool solved = dlx.Solve(result.grid);
+            result.status = solved ? SolveStatus::Solved : dlx.Failure();
+            result.nodes = dlx.Nodes();
+            stats = dlx.GetStats();
+            break;
+        }
+    }
+
+    return result;
+}
+
+inline SolveResult RunEngine(Engine engine, const Puzzle_t& grid,
+                             const Budget& budget, std::uint64_t seed)
+{
+    NoStats stats;
+    return RunEngine(engine, grid, budget, seed, stats);
+}
+
+} // End of namespace detail
+
+/* Runs one engine on grid within the limits of options. The seed only
+   matters to RandomMRV. If stats is given it receives the engine's
+   counters; otherwise the engine runs without any statistics code */
+inline SolveResult SolveWith(Engine engine, const Puzzle_t& grid,
+                             const SolveOptions& options = SolveOptions{},
+                             std::uint64_t seed = 0,
+                             SolveStats* stats = nullptr)
+{
+    if (stats == nullptr)
+        return detail::RunEngine(engine, grid, Budget{options}, seed);
+
+    CollectStats collect;
+    auto result = detail::RunEngine(engine, grid, Budget{options}, seed, collect);
+    *stats = collect.stats;
+
+    return result;
+}
+
+
+} // End of namespace Sudoku
+
+#endif // ENGINES_HPP
@@ -0,0 +1,58 @@
+#ifndef FUTEX_HPP
+#define FUTEX_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+
+namespace Sudoku {
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+              std::atomic<std::uint32_t>::is_always_lock_free,
+              "futex words are plain 32 bit integers");
+
+/* Sleeps while word holds expected, for at most timeout; returns early
+   on FutexWake, on a spurious wakeup or if word already moved on, so
+   callers check again in a loop. Works across processes when word is
+   in shared memory. Where there is no futex (not Linux) it just sleeps
+   a little, which keeps the callers correct if slower to react */
+inline void FutexWait(const std::atomic<std::uint32_t>& word, std::uint32_t expected,
+                      std::chrono::nanoseconds timeout) noexcept
+{
+#if defined(__linux__)
+    auto ns = timeout.count() < 0 ? 0 : timeout.count();
+    timespec ts{static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+    ::syscall(SYS_futex, const_cast<std::atomic<std::uint32_t>*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+    if (word.load(std::memory_order_acquire) == expected)
+        std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(timeout, std::chrono::microseconds(50)));
+#endif
+}
+
+/* Wakes up to count threads and processes sleeping on word, all of
+   them by default */
+inline void FutexWake(std::atomic<std::uint32_t>& word, int count = INT_MAX) noexcept
+{
+#if defined(__linux__)
+    ::syscall(SYS_futex, &word, FUTEX_WAKE, count, nullptr, nullptr, 0);
+#else
+    (void)word;
+    (void)count;
+#endif
+}
+
+
+} // End of namespace Sudoku
+
+#endif // FUTEX_HPP
@@ -0,0 +1,222 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "my_types.h"
+#include "grader.hpp"
+#include "search.hpp"
+#include "trace.hpp"
+
+
+namespace Sudoku {
+
+/* The techniques a generated puzzle must need: its hardest technique
+   falls between min and max, both included. A puzzle that needs
+   nothing harder than max is always solvable by logic, hence unique */
+struct RatingBand
+{
+    Technique min = Technique::HiddenSingle;
+    Technique max = Technique::Chain;
+
+    /* Digging stops at this many clues even if more could go */
+    std::size_t min_clues = 0;
+
+    bool Contains(Technique technique) const noexcept
+    {
+        return technique >= min && technique <= max;
+    }
+};
+
+/* Band of each level of the game */
+inline RatingBand BandFor(Difficulty dif) noexcept
+{
+    switch (dif)
+    {
+        case Difficulty::Easy:
+            return {Technique::HiddenSingle, Technique::NakedSingle, 36};
+        case Difficulty::Intermediate:
+            return {Technique::LockedCandidates, Technique::HiddenTriple, 0};
+        case Difficulty::Hard:
+            return {Technique::XWing, Technique::Chain, 0};
+    }
+    return {};
+}
+
+struct GenerateOptions
+{
+    RatingBand band;
+
+    /* Threads digging candidates at once, 0 for one per core */
+    std::size_t threads = 0;
+
+    /* Time allowed to find a puzzle inside the band. When it runs out
+       the hardest candidate seen so far is returned */
+    std::chrono::steady_clock::duration timeout = std::chrono::seconds(1);
+
+    const std::atomic<bool>* cancel = nullptr;
+
+    std::uint64_t seed = 0; // 0 picks one from random_device
+};
+
+struct GenerateResult
+{
+    Puzzle_t grid{};
+    Grade grade;
+    bool in_band = false;
+    std::uint64_t candidates = 0; // puzzles dug before one fit
+};
+
+namespace detail {
+
+/* A random solution grid. The three boxes of the diagonal do not see
+   each other, so they are filled with random permutations first and a
+   search with a random digit order completes the rest */
+template <typename Gen>
+Puzzle_t RandomSolution(Gen& gen)
+{
+    SUDOKU_TRACE_SCOPE("generate/fill");
+
+    Puzzle_t grid{};
+    std::array<std::size_t, 9> digits;
+
+    for (std::size_t box = 0; box < 9; box += 4)
+    {
+        std::iota(digits.begin(), digits.end(), std::size_t{1});
+        std::shuffle(digits.begin(), digits.end(), gen);
+        for (std::size_t k = 0; k < 9; ++k)
+            grid[box / 3 * 3 + k / 3][box % 3 * 3 + k % 3] = digits[k];
+    }
+
+    std::array<std::uint8_t, 9> order;
+    std::iota(order.begin(), order.end(), std::uint8_t{0});
+    std::shuffle(order.begin(), order.end(), gen);
+
+    SearchState state(grid);
+    state.SetValueOrder(order);
+    state.Next();
+
+    return state.Grid();
+}
+
+/* Removes clues of solution one at a time in random order, regrading
+   after each removal. A removal that leaves the band's ceiling, or the
+   reach of logic altogether, is undone. The result is minimal for the
+   ceiling (or down to min_clues) */
+template <typename Gen>
+Grade Dig(Puzzle_t& grid, const RatingBand& band, Gen& gen)
+{
+    SUDOKU_TRACE_SCOPE("generate/dig");
+
+    std::array<std::uint8_t, 81> cells;
+    std::iota(cells.begin(), cells.end(), std::uint8_t{0});
+    std::shuffle(cells.begin(), cells.end(), gen);
+
+    Grade grade = GradePuzzle(grid);
+    std::size_t clues = 81;
+
+    for (auto cell : cells)
+    {
+        if (clues <= band.min_clues)
+            break;
+
+        auto& slot = grid[cell / 9][cell % 9];
+        auto num = slot;
+        slot = 0;
+
+        auto next = GradePuzzle(grid);
+        if (!next.solved || next.hardest > band.max)
+        {
+            slot = num;
+            continue;
+        }
+
+        grade = next;
+        --clues;
+    }
+
+    return grade;
+}
+
+} // End of namespace detail
+
+/* Generates a puzzle whose grade falls in options.band.
+
+   Every thread digs puzzles out of fresh random solutions until one
+   fits; the first to find one stops the others. Digging never goes past
+   the band's ceiling, so misses are always too easy, never unsolvable
+   by logic. When the time runs out the hardest miss is returned with
+   in_band false */
+inline GenerateResult GenerateRated(const GenerateOptions& options = {})
+{
+    SUDOKU_TRACE_SCOPE("generate");
+
+    auto threads = options.threads;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::uint64_t seed = options.seed;
+    if (seed == 0)
+        seed = std::random_device{}();
+
+    auto deadline = std::chrono::steady_clock::now() + options.timeout;
+    std::atomic<bool> done{false};
+    std::atomic<std::uint64_t> candidates{0};
+    std::mutex mutex;
+    GenerateResult best;
+    bool have_best = false;
+
+    auto run = [&](std::size_t k) {
+        std::mt19937_64 gen(seed + k);
+
+        do
+        {
+            auto grid = detail::RandomSolution(gen);
+            auto grade = detail::Dig(grid, options.band, gen);
+            candidates.fetch_add(1, std::memory_order_relaxed);
+
+            bool fits = options.band.Contains(grade.hardest);
+            if (fits && done.exchange(true))
+                return; // someone else got there first
+
+            std::lock_guard<std::mutex> lk(mutex);
+            if (fits || !have_best || grade.hardest > best.grade.hardest)
+            {
+                best.grid = grid;
+                best.grade = grade;
+                best.in_band = fits;
+                have_best = true;
+            }
+        }
+        while (!done.load(std::memory_order_relaxed) &&
+               !(options.cancel && options.cancel->load(std::memory_order_relaxed)) &&
+               std::chrono::steady_clock::now() < deadline);
+    };
+
+    std::vector<std::thread> pool;
+    for (std::size_t k = 1; k < threads; ++k)
+        pool.emplace_back(run, k);
+
+    run(0);
+
+    for (auto& t : pool)
+        t.join();
+
+    best.candidates = candidates.load();
+    return best;
+}
+
+
+} // End of namespace Sudoku
+
+#endif // GENERATOR_HPP
@@ -0,0 +1,675 @@
+#ifndef GRADER_HPP
+#define GRADER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "my_types.h"
+#include "search.hpp"
+
+
+namespace Sudoku {
+
+/* The techniques of the logical solver, from the easiest to the
+   hardest. They are tried in this order and the solver goes back to the
+   top after every step, so a step is only taken with a technique when
+   every easier one is stuck */
+enum class Technique
+{
+    None,              // nothing to do, the grid was already full
+    HiddenSingle,      // a digit has one place left in a unit
+    NakedSingle,       // a cell has one candidate left
+    LockedCandidates,  // pointing and claiming (box/line interaction)
+    NakedPair,
+    HiddenPair,
+    NakedTriple,
+    HiddenTriple,
+    XWing,
+    Swordfish,
+    XYWing,
+    Chain,             // simple colouring and XY-chains
+    Trial              // none of the above applies: trial and error
+};
+
+constexpr std::size_t TechniqueCount = static_cast<std::size_t>(Technique::Trial) + 1;
+
+inline const char* TechniqueName(Technique technique) noexcept
+{
+    static const char* const names[TechniqueCount] = {
+        "none", "hidden single", "naked single", "locked candidates",
+        "naked pair", "hidden pair", "naked triple", "hidden triple",
+        "x-wing", "swordfish", "xy-wing", "chain", "trial"};
+    return names[static_cast<std::size_t>(technique)];
+}
+
+/* Rating of a puzzle that needs technique, on a scale close to the
+   one of Sudoku Explainer: 1.2 for hidden singles up to 5.5 for chains.
+   Puzzles that need trial and error are rated 8.0 */
+inline double TechniqueWeight(Technique technique) noexcept
+{
+    static const double weights[TechniqueCount] = {
+        0.0, 1.2, 1.5, 2.0, 2.5, 2.8, 3.0, 3.3, 3.5, 4.0, 4.5, 5.5, 8.0};
+    return weights[static_cast<std::size_t>(technique)];
+}
+
+/* What the logical solver made of a puzzle */
+struct Grade
+{
+    bool valid = true;                          // false if the clues contradict
+    bool solved = false;                        // logic alone filled the grid
+    Technique hardest = Technique::None;        // hardest technique needed
+    double rating = 0.0;                        // TechniqueWeight(hardest)
+    std::array<std::uint32_t, TechniqueCount> steps{}; // times each was applied
+    Puzzle_t grid{};                            // as far as logic got
+};
+
+namespace detail {
+
+/* Units (rows 0-8, columns 9-17, boxes 18-26) and peers of every
+   cell, computed once */
+struct GridTables
+{
+    std::array<std::array<std::uint8_t, 9>, 27> units;
+    std::array<std::array<std::uint8_t, 20>, 81> peers;
+    std::array<std::array<std::uint8_t, 3>, 81> units_of;
+
+    GridTables() noexcept
+    {
+        for (std::size_t i = 0; i < 9; ++i)
+            for (std::size_t j = 0; j < 9; ++j)
+            {
+                units[i][j] = static_cast<std::uint8_t>(i * 9 + j);
+                units[9 + i][j] = static_cast<std::uint8_t>(j * 9 + i);
+                units[18 + i][j] = static_cast<std::uint8_t>((i / 3 * 3 + j / 3) * 9 + i % 3 * 3 + j % 3);
+            }
+
+        for (std::size_t cell = 0; cell < 81; ++cell)
+        {
+            auto row = cell / 9, col = cell % 9;
+            units_of[cell] = {static_cast<std::uint8_t>(row), static_cast<std::uint8_t>(9 + col),
+                              static_cast<std::uint8_t>(18 + BoxOf(row, col))};
+
+            std::size_t n = 0;
+            for (std::size_t other = 0; other < 81; ++other)
+                if (other != cell && (other / 9 == row || other % 9 == col ||
+                                      BoxOf(other / 9, other % 9) == BoxOf(row, col)))
+                    peers[cell][n++] = static_cast<std::uint8_t>(other);
+        }
+    }
+};
+
+inline const GridTables& Tables() noexcept
+{
+    static const GridTables tables;
+    return tables;
+}
+
+inline bool Sees(std::size_t a, std::size_t b) noexcept
+{
+    return a != b && (a / 9 == b / 9 || a % 9 == b % 9 ||
+                      BoxOf(a / 9, a % 9) == BoxOf(b / 9, b % 9));
+}
+
+/* Candidate grid worked on by the techniques. Every technique returns
+   true as soon as it placed a digit or removed a candidate */
+class LogicalSolver
+{
+public:
+    explicit LogicalSolver(const Puzzle_t& grid) noexcept : tables{Tables()}
+    {
+        cells.fill(0);
+        cand.fill(AllDigits);
+
+        for (std::size_t cell = 0; cell < 81; ++cell)
+        {
+            auto num = grid[cell / 9][cell % 9];
+            if (num == 0)
+                continue;
+
+            if (num > 9 || (cand[cell] & (1u << (num - 1))) == 0)
+                valid = false;
+            else
+                Place(cell, num);
+        }
+    }
+
+    Grade Run() noexcept
+    {
+        Grade grade;
+
+        while (valid && filled < 81)
+        {
+            auto technique = Step();
+            if (technique == Technique::Trial)
+                break;
+
+            ++grade.steps[static_cast<std::size_t>(technique)];
+            if (technique > grade.hardest)
+                grade.hardest = technique;
+        }
+
+        grade.valid = valid;
+        grade.solved = valid && filled == 81;
+        if (valid && !grade.solved)
+            grade.hardest = Technique::Trial;
+        grade.rating = TechniqueWeight(grade.hardest);
+
+        for (std::size_t cell = 0; cell < 81; ++cell)
+            grade.grid[cell / 9][cell % 9] = cells[cell];
+
+        return grade;
+    }
+
+private:
+    /* Applies the easiest technique that makes progress */
+    Technique Step() noexcept
+    {
+        for (std::size_t cell = 0; cell < 81; ++cell)
+            if (cells[cell] == 0 && cand[cell] == 0)
+            {
+                valid = false;
+                return Technique::Trial;
+            }
+
+        if (HiddenSingles())
+            return Technique::HiddenSingle;
+        if (!valid)
+            return Technique::Trial;
+        if (NakedSingles())
+            return Technique::NakedSingle;
+        if (LockedCandidates())
+            return Technique::LockedCandidates;
+        if (NakedSubset(2))
+            return Technique::NakedPair;
+        if (HiddenSubset(2))
+            return Technique::HiddenPair;
+        if (NakedSubset(3))
+            return Technique::NakedTriple;
+        if (HiddenSubset(3))
+            return Technique::HiddenTriple;
+        if (Fish(2))
+            return Technique::XWing;
+        if (Fish(3))
+            return Technique::Swordfish;
+        if (XYWing())
+            return Technique::XYWing;
+        if (Coloring() || XYChain())
+            return Technique::Chain;
+
+        return Technique::Trial;
+    }
+
+    void Place(std::size_t cell, std::size_t num) noexcept
+    {
+        auto bit = static_cast<Mask_t>(1u << (num - 1));
+        cells[cell] = static_cast<std::uint8_t>(num);
+        cand[cell] = 0;
+        ++filled;
+
+        for (auto peer : tables.peers[cell])
+            cand[peer] = static_cast<Mask_t>(cand[peer] & ~bit);
+    }
+
+    bool Eliminate(std::size_t cell, Mask_t digits) noexcept
+    {
+        if ((cand[cell] & digits) == 0)
+            return false;
+
+        cand[cell] = static_cast<Mask_t>(cand[cell] & ~digits);
+        return true;
+    }
+
+    /* Every hidden single of every unit in one sweep. A digit without
+       any place left in a unit makes the grid invalid */
+    bool HiddenSingles() noexcept
+    {
+        bool progress = false;
+
+        for (const auto& unit : tables.units)
+        {
+            Mask_t once = 0, twice = 0, placed = 0;
+            for (auto cell : unit)
+            {
+                if (cells[cell] != 0)
+                    placed = static_cast<Mask_t>(placed | (1u << (cells[cell] - 1)));
+                twice = static_cast<Mask_t>(twice | (once & cand[cell]));
+                once = static_cast<Mask_t>(once | cand[cell]);
+            }
+
+            if ((AllDigits & ~(once | placed)) != 0)
+            {
+                valid = false;
+                return false;
+            }
+
+            for (auto single = static_cast<unsigned>(once & ~twice); single != 0; single &= single - 1)
+            {
+                auto bit = single & (0u - single);
+                for (auto cell : unit)
+                    if (cand[cell] & bit)
+                    {
+                        Place(cell, static_cast<std::size_t>(LowestBit(bit) + 1));
+                        progress = true;
+                        break;
+                    }
+            }
+        }
+
+        return progress;
+    }
+
+    bool NakedSingles() noexcept
+    {
+        bool progress = false;
+
+        for (std::size_t cell = 0; cell < 81; ++cell)
+            if (cells[cell] == 0 && cand[cell] != 0 && (cand[cell] & (cand[cell] - 1)) == 0)
+            {
+                Place(cell, static_cast<std::size_t>(LowestBit(cand[cell]) + 1));
+                progress = true;
+            }
+
+        return progress;
+    }
+
+    /* Pointing: the candidates of a digit in a box lie on one line, so
+       the rest of the line loses it. Claiming: the candidates of a digit
+       on a line lie in one box, so the rest of the box loses it */
+    bool LockedCandidates() noexcept
+    {
+        for (std::size_t box = 18; box < 27; ++box)
+            for (std::size_t line = 0; line < 18; ++line)
+            {
+                Mask_t in_both = 0, box_only = 0, line_only = 0;
+                for (auto cell : tables.units[box])
+                    if (tables.units_of[cell][line < 9 ? 0 : 1] == line)
+                        in_both = static_cast<Mask_t>(in_both | cand[cell]);
+                    else
+                        box_only = static_cast<Mask_t>(box_only | cand[cell]);
+
+                if (in_both == 0)
+                    continue;
+
+                for (auto cell : tables.units[line])
+                    if (tables.units_of[cell][2] != box)
+                        line_only = static_cast<Mask_t>(line_only | cand[cell]);
+
+                bool progress = false;
+                auto pointing = static_cast<Mask_t>(in_both & ~box_only & line_only);
+                auto claiming = static_cast<Mask_t>(in_both & ~line_only & box_only);
+
+                if (pointing != 0)
+                    for (auto cell : tables.units[line])
+                        if (tables.units_of[cell][2] != box)
+                            progress |= Eliminate(cell, pointing);
+
+                if (claiming != 0)
+                    for (auto cell : tables.units[box])
+                        if (tables.units_of[cell][line < 9 ? 0 : 1] != line)
+                            progress |= Eliminate(cell, claiming);
+
+                if (progress)
+                    return true;
+            }
+
+        return false;
+    }
+
+    /* size cells of a unit holding only size digits between them: the
+       other cells of the unit lose those digits */
+    bool NakedSubset(std::size_t size) noexcept
+    {
+        for (const auto& unit : tables.units)
+        {
+            std::array<std::uint8_t, 9> open;
+            std::size_t n = 0;
+            for (auto cell : unit)
+                if (cells[cell] == 0 && static_cast<std::size_t>(PopCount(cand[cell])) <= size)
+                    open[n++] = cell;
+
+            auto found = AnySubset(n, size, [&](std::size_t a, std::size_t b, std::size_t c) {
+                auto digits = static_cast<Mask_t>(cand[open[a]] | cand[open[b]] |
+                                                  (c < n ? cand[open[c]] : 0));
+                if (static_cast<std::size_t>(PopCount(digits)) != size)
+                    return false;
+
+                bool progress = false;
+                for (auto cell : unit)
+                    if (cell != open[a] && cell != open[b] && (c == n || cell != open[c]))
+                        progress |= Eliminate(cell, digits);
+                return progress;
+            });
+
+            if (found)
+                return true;
+        }
+
+        return false;
+    }
+
+    /* size digits of a unit confined to size cells between them: those
+       cells lose every other digit */
+    bool HiddenSubset(std::size_t size) noexcept
+    {
+        for (const auto& unit : tables.units)
+        {
+            std::array<Mask_t, 9> where{}; // unit positions of each digit
+            for (std::size_t k = 0; k < 9; ++k)
+                for (auto bits = static_cast<unsigned>(cand[unit[k]]); bits != 0; bits &= bits - 1)
+                    where[static_cast<std::size_t>(LowestBit(bits))] |= static_cast<Mask_t>(1u << k);
+
+            std::array<std::uint8_t, 9> digits;
+            std::size_t n = 0;
+            for (std::size_t d = 0; d < 9; ++d)
+                if (where[d] != 0 && static_cast<std::size_t>(PopCount(where[d])) <= size)
+                    digits[n++] = static_cast<std::uint8_t>(d);
+
+            auto found = AnySubset(n, size, [&](std::size_t a, std::size_t b, std::size_t c) {
+                auto places = static_cast<unsigned>(where[digits[a]] | where[digits[b]] |
+                                                    (c < n ? where[digits[c]] : 0));
+                if (static_cast<std::size_t>(PopCount(places)) != size)
+                    return false;
+
+                auto keep = static_cast<Mask_t>((1u << digits[a]) | (1u << digits[b]) |
+                                                (c < n ? 1u << digits[c] : 0u));
+                bool progress = false;
+                for (; places != 0; places &= places - 1)
+                    progress |= Eliminate(unit[static_cast<std::size_t>(LowestBit(places))],
+                                          static_cast<Mask_t>(~keep & AllDigits));
+                return progress;
+            });
+
+            if (found)
+                return true;
+        }
+
+        return false;
+    }
+
+    /* X-Wing (size 2) and Swordfish (size 3): a digit confined to the
+       same size columns on size rows can be removed from the rest of
+       those columns, and the same with rows and columns swapped */
+    bool Fish(std::size_t size) noexcept
+    {
+        for (std::size_t d = 0; d < 9; ++d)
+            for (std::size_t base = 0; base < 18; base += 9)
+            {
+                std::array<Mask_t, 9> where{}; // positions on each base line
+                std::array<std::uint8_t, 9> lines;
+                std::size_t n = 0;
+
+                for (std::size_t i = 0; i < 9; ++i)
+                {
+                    for (std::size_t k = 0; k < 9; ++k)
+                        if (cand[tables.units[base + i][k]] & (1u << d))
+                            where[i] |= static_cast<Mask_t>(1u << k);
+
+                    auto count = static_cast<std::size_t>(PopCount(where[i]));
+                    if (count >= 2 && count <= size)
+                        lines[n++] = static_cast<std::uint8_t>(i);
+                }
+
+                auto found = AnySubset(n, size, [&](std::size_t a, std::size_t b, std::size_t c) {
+                    auto cover = static_cast<unsigned>(where[lines[a]] | where[lines[b]] |
+                                                       (c < n ? where[lines[c]] : 0));
+                    if (static_cast<std::size_t>(PopCount(cover)) != size)
+                        return false;
+
+                    bool progress = false;
+                    for (std::size_t i = 0; i < 9; ++i)
+                    {
+                        if (i == lines[a] || i == lines[b] || (c < n && i == lines[c]))
+                            continue;
+                        for (auto bits = cover; bits != 0; bits &= bits - 1)
+                        {
+                            auto cell = tables.units[base + i][static_cast<std::size_t>(LowestBit(bits))];
+                            progress |= Eliminate(cell, static_cast<Mask_t>(1u << d));
+                        }
+                    }
+                    return progress;
+                });
+
+                if (found)
+                    return true;
+            }
+
+        return false;
+    }
+
+    /* Pivot {x,y} seeing pincers {x,z} and {y,z}: whatever the pivot
+       holds, one pincer is z, so cells seeing both pincers lose z */
+    bool XYWing() noexcept
+    {
+        for (std::size_t pivot = 0; pivot < 81; ++pivot)
+        {
+            if (PopCount(cand[pivot]) != 2)
+                continue;
+
+            for (auto a : tables.peers[pivot])
+            {
+                auto shared = static_cast<Mask_t>(cand[a] & cand[pivot]);
+                if (PopCount(cand[a]) != 2 || PopCount(shared) != 1)
+                    continue;
+
+                auto z = static_cast<Mask_t>(cand[a] & ~shared);
+                auto want = static_cast<Mask_t>((cand[pivot] & ~shared) | z);
+
+                for (auto b : tables.peers[pivot])
+                {
+                    if (b == a || cand[b] != want)
+                        continue;
+
+                    bool progress = false;
+                    for (auto cell : tables.peers[a])
+                        if (cell != b && Sees(cell, b))
+                            progress |= Eliminate(cell, z);
+
+                    if (progress)
+                        return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /* Simple colouring. The strong links of a digit (units where it has
+       exactly two places) are coloured alternately; one colour is true.
+       A colour with two cells seeing each other is false, and a cell
+       seeing both colours cannot hold the digit */
+    bool Coloring() noexcept
+    {
+        for (std::size_t d = 0; d < 9; ++d)
+        {
+            auto bit = static_cast<Mask_t>(1u << d);
+
+            // partner[cell][u]: the other place of d in unit u, if only two
+            std::array<std::array<std::uint8_t, 3>, 81> partner;
+            for (auto& p : partner)
+                p.fill(81);
+
+            for (std::size_t u = 0; u < 27; ++u)
+            {
+                std::size_t first = 81, second = 81, count = 0;
+                for (auto cell : tables.units[u])
+                    if (cand[cell] & bit)
+                        (count++ == 0 ? first : second) = cell;
+
+                if (count != 2)
+                    continue;
+
+                partner[first][u / 9] = static_cast<std::uint8_t>(second);
+                partner[second][u / 9] = static_cast<std::uint8_t>(first);
+            }
+
+            std::array<std::uint8_t, 81> color;    // 0 or 1
+            std::array<std::uint8_t, 81> component; // root of the cell's component
+            component.fill(81);
+
+            for (std::size_t root = 0; root < 81; ++root)
+            {
+                if (component[root] != 81 || (partner[root][0] == 81 && partner[root][1] == 81 &&
+                                              partner[root][2] == 81))
+                    continue;
+
+                // Colour the component of root
+                std::array<std::uint8_t, 81> members;
+                std::size_t n = 0;
+                members[n++] = static_cast<std::uint8_t>(root);
+                component[root] = static_cast<std::uint8_t>(root);
+                color[root] = 0;
+
+                for (std::size_t i = 0; i < n; ++i)
+                    for (auto next : partner[members[i]])
+                        if (next != 81 && component[next] == 81)
+                        {
+                            component[next] = static_cast<std::uint8_t>(root);
+                            color[next] = static_cast<std::uint8_t>(1 - color[members[i]]);
+                            members[n++] = next;
+                        }
+
+                if (n < 3)
+                    continue;
+
+                // Colour wrap
+                for (std::size_t i = 0; i < n; ++i)
+                    for (std::size_t j = i + 1; j < n; ++j)
+                        if (color[members[i]] == color[members[j]] && Sees(members[i], members[j]))
+                        {
+                            auto wrong = color[members[i]];
+                            for (std::size_t k = 0; k < n; ++k)
+                                if (color[members[k]] == wrong)
+                                    Eliminate(members[k], bit);
+                            return true;
+                        }
+
+                // Colour trap
+                bool progress = false;
+                for (std::size_t cell = 0; cell < 81; ++cell)
+                {
+                    if ((cand[cell] & bit) == 0 || component[cell] == root)
+                        continue;
+
+                    bool sees[2] = {false, false};
+                    for (std::size_t i = 0; i < n; ++i)
+                        if (Sees(cell, members[i]))
+                            sees[color[members[i]]] = true;
+
+                    if (sees[0] && sees[1])
+                        progress |= Eliminate(cell, bit);
+                }
+
+                if (progress)
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    /* XY-chain: bivalue cells c0 = {x,a}, c1 = {a,b}, ..., cn = {.,x},
+       each seeing the next. If c0 is not x the chain forces cn to x, so
+       cells seeing both ends lose x. Chains are searched depth first up
+       to MaxChain cells */
+    bool XYChain() noexcept
+    {
+        for (std::size_t start = 0; start < 81; ++start)
+        {
+            if (PopCount(cand[start]) != 2)
+                continue;
+
+            for (auto bits = static_cast<unsigned>(cand[start]); bits != 0; bits &= bits - 1)
+            {
+                auto x = static_cast<Mask_t>(bits & (0u - bits));
+                std::array<bool, 81> used{};
+                used[start] = true;
+
+                if (ExtendChain(start, start, static_cast<Mask_t>(cand[start] & ~x), x, 1, used))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    static constexpr std::size_t MaxChain = 8;
+
+    bool ExtendChain(std::size_t start, std::size_t cell, Mask_t link, Mask_t x,
+                     std::size_t length, std::array<bool, 81>& used) noexcept
+    {
+        if (length == MaxChain)
+            return false;
+
+        for (auto next : tables.peers[cell])
+        {
+            if (used[next] || PopCount(cand[next]) != 2 || (cand[next] & link) == 0)
+                continue;
+
+            auto forced = static_cast<Mask_t>(cand[next] & ~link);
+
+            if (forced == x && length >= 2)
+            {
+                bool progress = false;
+                for (auto other : tables.peers[start])
+                    if (other != next && Sees(other, next))
+                        progress |= Eliminate(other, x);
+
+                if (progress)
+                    return true;
+            }
+
+            used[next] = true;
+            if (ExtendChain(start, next, forced, x, length + 1, used))
+                return true;
+            used[next] = false;
+        }
+
+        return false;
+    }
+
+    /* Calls fn(a, b, c) for the subsets of size 2 or 3 of 0..n-1 until
+       it returns true. Pairs are passed with c == n */
+    template <typename F>
+    static bool AnySubset(std::size_t n, std::size_t size, F&& fn)
+    {
+        for (std::size_t a = 0; a < n; ++a)
+            for (std::size_t b = a + 1; b < n; ++b)
+            {
+                if (size == 2)
+                {
+                    if (fn(a, b, n))
+                        return true;
+                    continue;
+                }
+
+                for (std::size_t c = b + 1; c < n; ++c)
+                    if (fn(a, b, c))
+                        return true;
+            }
+
+        return false;
+    }
+
+    const GridTables& tables;
+    std::array<std::uint8_t, 81> cells;
+    std::array<Mask_t, 81> cand;
+    std::size_t filled = 0;
+    bool valid = true;
+};
+
+} // End of namespace detail
+
+/* Solves grid the way a person would, with the techniques of Technique
+   in order of difficulty, and reports the hardest one it needed. Unlike
+   the search engines it never guesses: a puzzle it cannot finish is
+   graded Trial, which also covers puzzles with several solutions */
+inline Grade GradePuzzle(const Puzzle_t& grid) noexcept
+{
+    return detail::LogicalSolver{grid}.Run();
+}
+
+
+} // End of namespace Sudoku
+
+#endif // GRADER_HPP
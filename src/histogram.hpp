@@ -0,0 +1,146 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <string>
+
+
+namespace Sudoku {
+
+/* Histogram with power of two buckets: bucket 0 holds 0, bucket k
+   holds [2^(k-1), 2^k). Fixed size and trivially mergeable, so workers
+   keep their own and the results are summed at the end */
+class Log2Histogram
+{
+public:
+    static constexpr std::size_t Buckets = 65;
+
+    static std::size_t BucketOf(std::uint64_t value) noexcept
+    {
+        std::size_t k = 0;
+        while (value != 0)
+        {
+            value >>= 1;
+            ++k;
+        }
+        return k;
+    }
+
+    /* Smallest value that falls in bucket k */
+    static std::uint64_t LowerBound(std::size_t k) noexcept
+    {
+        return k == 0 ? 0 : std::uint64_t{1} << (k - 1);
+    }
+
+    void Add(std::uint64_t value) noexcept
+    {
+        ++counts[BucketOf(value)];
+        ++total;
+        sum += value;
+        if (value > max)
+            max = value;
+    }
+
+    Log2Histogram& operator+=(const Log2Histogram& other) noexcept
+    {
+        for (std::size_t k = 0; k < Buckets; ++k)
+            counts[k] += other.counts[k];
+        total += other.total;
+        sum += other.sum;
+        if (other.max > max)
+            max = other.max;
+        return *this;
+    }
+
+    std::uint64_t Count() const noexcept {return total;}
+    std::uint64_t Sum() const noexcept {return sum;}
+    std::uint64_t Max() const noexcept {return max;}
+    std::uint64_t Bucket(std::size_t k) const noexcept {return counts[k];}
+
+    double Mean() const noexcept
+    {
+        return total == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(total);
+    }
+
+    /* Upper bound of the bucket holding the p-quantile (0 <= p <= 1) */
+    std::uint64_t Percentile(double p) const noexcept
+    {
+        if (total == 0)
+            return 0;
+
+        auto rank = static_cast<std::uint64_t>(p * static_cast<double>(total - 1));
+        std::uint64_t seen = 0;
+
+        for (std::size_t k = 0; k < Buckets; ++k)
+        {
+            seen += counts[k];
+            if (seen > rank)
+                return k + 1 < Buckets && LowerBound(k + 1) < max ? LowerBound(k + 1) : max;
+        }
+
+        return max;
+    }
+
+    /* Text form, for checkpoints: count, sum, max, then the buckets */
+    void Save(std::ostream& out) const
+    {
+        out << total << ' ' << sum << ' ' << max;
+        for (auto c : counts)
+            out << ' ' << c;
+    }
+
+    /* Reads what Save wrote, false (and the stream failed) if it is not
+       that */
+    bool Load(std::istream& in)
+    {
+        Log2Histogram h;
+        in >> h.total >> h.sum >> h.max;
+        for (auto& c : h.counts)
+            in >> c;
+        if (!in)
+            return false;
+
+        *this = h;
+        return true;
+    }
+
+    /* Prints the non empty buckets, one per line, with a bar */
+    void Print(std::ostream& out, const std::string& title) const
+    {
+        out << title << ": count " << total << ", mean " << std::fixed << std::setprecision(1)
+            << Mean() << ", p50 " << Percentile(0.5) << ", p99 " << Percentile(0.99)
+            << ", max " << max << "\n";
+
+        std::uint64_t widest = 0;
+        for (auto c : counts)
+            if (c > widest)
+                widest = c;
+
+        for (std::size_t k = 0; k < Buckets; ++k)
+        {
+            if (counts[k] == 0)
+                continue;
+
+            auto bar = static_cast<std::size_t>(40 * counts[k] / widest);
+            out << "  [" << std::setw(20) << LowerBound(k) << ", "
+                << std::setw(20) << (k == 0 ? 1 : LowerBound(k) * 2) << ") "
+                << std::setw(10) << counts[k] << " " << std::string(bar, '#') << "\n";
+        }
+    }
+
+private:
+    std::array<std::uint64_t, Buckets> counts{};
+    std::uint64_t total = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+};
+
+
+} // End of namespace Sudoku
+
+#endif // HISTOGRAM_HPP
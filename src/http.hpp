@@ -0,0 +1,244 @@
+#ifndef HTTP_HPP
+#define HTTP_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace Sudoku {
+
+/* Just enough HTTP/1.1 for a local JSON service (sudoku_httpd): request
+   parsing that works on a buffer holding any number of pipelined
+   requests, query strings and response framing. Bodies are sized by
+   Content-Length only; chunked requests are refused */
+
+struct HttpRequest
+{
+    std::string method;
+    std::string path;      // target up to the '?'
+    std::string query;     // after the '?', still encoded
+    std::vector<std::pair<std::string, std::string>> headers; // names lowercase
+    std::string body;
+    bool keep_alive = true;
+
+    /* Value of the first header called name (lowercase), if any */
+    std::optional<std::string_view> Header(std::string_view name) const
+    {
+        for (const auto& [key, value] : headers)
+            if (key == name)
+                return std::string_view(value);
+        return {};
+    }
+};
+
+namespace HttpLimits {
+
+constexpr std::size_t HeaderBytes = 16 * 1024;
+constexpr std::size_t BodyBytes = 1024 * 1024;
+
+} // End of namespace HttpLimits
+
+enum class HttpParse
+{
+    Done,       // a request was read, see consumed
+    Incomplete, // more bytes are needed
+    Bad,        // malformed: answer 400 and close
+    TooLarge    // past HttpLimits: answer 413 and close
+};
+
+namespace detail {
+
+inline std::string_view Trim(std::string_view s) noexcept
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        s.remove_suffix(1);
+    return s;
+}
+
+inline std::string Lower(std::string_view s)
+{
+    std::string out(s);
+    for (auto& c : out)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return out;
+}
+
+inline bool HasToken(std::string_view list, std::string_view token)
+{
+    auto lower = Lower(list);
+    std::string_view rest = lower;
+    while (!rest.empty())
+    {
+        auto comma = rest.find(',');
+        if (Trim(rest.substr(0, comma)) == token)
+            return true;
+        rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+    }
+    return false;
+}
+
+} // End of namespace detail
+
+/* Parses the first request in buffer into request. On Done, consumed is
+   the number of bytes it took, and the next pipelined request starts
+   right after them */
+inline HttpParse ParseHttpRequest(std::string_view buffer, HttpRequest& request, std::size_t& consumed)
+{
+    auto head_end = buffer.find("\r\n\r\n");
+    if (head_end == std::string_view::npos)
+        return buffer.size() > HttpLimits::HeaderBytes ? HttpParse::TooLarge : HttpParse::Incomplete;
+    if (head_end > HttpLimits::HeaderBytes)
+        return HttpParse::TooLarge;
+
+    auto head = buffer.substr(0, head_end + 2);
+    auto line_end = head.find("\r\n");
+    auto line = head.substr(0, line_end);
+    head.remove_prefix(line_end + 2);
+
+    // METHOD SP target SP HTTP/1.x
+    auto sp1 = line.find(' ');
+    auto sp2 = line.rfind(' ');
+    if (sp1 == std::string_view::npos || sp1 == sp2)
+        return HttpParse::Bad;
+
+    auto target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    auto version = line.substr(sp2 + 1);
+    if (target.empty() || target[0] != '/' || (version != "HTTP/1.1" && version != "HTTP/1.0"))
+        return HttpParse::Bad;
+
+    request = HttpRequest{};
+    request.method = std::string(line.substr(0, sp1));
+    auto question = target.find('?');
+    request.path = std::string(target.substr(0, question));
+    if (question != std::string_view::npos)
+        request.query = std::string(target.substr(question + 1));
+    request.keep_alive = version == "HTTP/1.1";
+
+    std::size_t length = 0;
+    while (!head.empty())
+    {
+        line_end = head.find("\r\n");
+        line = head.substr(0, line_end);
+        head.remove_prefix(line_end + 2);
+
+        auto colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0)
+            return HttpParse::Bad;
+
+        auto name = detail::Lower(line.substr(0, colon));
+        auto value = detail::Trim(line.substr(colon + 1));
+
+        if (name == "content-length")
+        {
+            if (value.empty() || value.size() > 9 ||
+                !std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; }))
+                return HttpParse::Bad;
+            length = std::stoul(std::string(value));
+            if (length > HttpLimits::BodyBytes)
+                return HttpParse::TooLarge;
+        }
+        else if (name == "transfer-encoding")
+            return HttpParse::Bad;
+        else if (name == "connection")
+        {
+            if (detail::HasToken(value, "close"))
+                request.keep_alive = false;
+            else if (detail::HasToken(value, "keep-alive"))
+                request.keep_alive = true;
+        }
+
+        request.headers.emplace_back(std::move(name), std::string(value));
+    }
+
+    auto total = head_end + 4 + length;
+    if (buffer.size() < total)
+        return HttpParse::Incomplete;
+
+    request.body = std::string(buffer.substr(head_end + 4, length));
+    consumed = total;
+    return HttpParse::Done;
+}
+
+/* Value of the parameter name in an encoded query string, decoded
+   ('+' and %XX). Empty if it is not there */
+inline std::optional<std::string> QueryParam(std::string_view query, std::string_view name)
+{
+    auto hex = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+
+    while (!query.empty())
+    {
+        auto amp = query.find('&');
+        auto pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view{} : query.substr(amp + 1);
+
+        auto eq = pair.find('=');
+        if (pair.substr(0, eq) != name)
+            continue;
+
+        std::string value;
+        auto raw = eq == std::string_view::npos ? std::string_view{} : pair.substr(eq + 1);
+        for (std::size_t i = 0; i < raw.size(); ++i)
+        {
+            if (raw[i] == '+')
+                value += ' ';
+            else if (raw[i] == '%' && i + 2 < raw.size() && hex(raw[i + 1]) >= 0 && hex(raw[i + 2]) >= 0)
+            {
+                value += static_cast<char>(hex(raw[i + 1]) * 16 + hex(raw[i + 2]));
+                i += 2;
+            }
+            else
+                value += raw[i];
+        }
+        return value;
+    }
+    return {};
+}
+
+inline const char* HttpReason(int status) noexcept
+{
+    switch (status)
+    {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 422: return "Unprocessable Entity";
+        case 503: return "Service Unavailable";
+        default:  return "Internal Server Error";
+    }
+}
+
+/* Appends a complete response to out */
+inline void AppendHttpResponse(std::string& out, int status, std::string_view content_type,
+                               std::string_view body, bool keep_alive)
+{
+    out += "HTTP/1.1 ";
+    out += std::to_string(status);
+    out += ' ';
+    out += HttpReason(status);
+    out += "\r\nContent-Type: ";
+    out += content_type;
+    out += "\r\nContent-Length: ";
+    out += std::to_string(body.size());
+    out += keep_alive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    out += body;
+}
+
+
+} // End of namespace Sudoku
+
+#endif // HTTP_HPP
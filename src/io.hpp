@@ -0,0 +1,153 @@
+#ifndef IO_HPP
+#define IO_HPP
+
+#include <cstddef>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "my_types.h"
+
+
+namespace Sudoku {
+
+/* Reads the usual 81 character line format: digits row by row, with
+   '0' or '.' for empty cells. Trailing characters after the 81st cell
+   (a CR, a comment) are ignored. Returns an empty optional if the line
+   is too short or has anything else in it */
+inline std::optional<Puzzle_t> ParsePuzzle(std::string_view line) noexcept
+{
+    if (line.size() < 81)
+        return {};
+
+    Puzzle_t grid;
+
+    for (std::size_t i = 0; i < 81; ++i)
+    {
+        auto c = line[i];
+        if (c == '.' || c == '0')
+            grid[i / 9][i % 9] = 0;
+        else if (c >= '1' && c <= '9')
+            grid[i / 9][i % 9] = static_cast<std::size_t>(c - '0');
+        else
+            return {};
+    }
+
+    return grid;
+}
+
+/* Inverse of ParsePuzzle, empty cells are written as '.' */
+inline std::string ToString(const Puzzle_t& grid)
+{
+    std::string line(81, '.');
+
+    for (std::size_t i = 0; i < 81; ++i)
+        if (grid[i / 9][i % 9] != 0)
+            line[i] = static_cast<char>('0' + grid[i / 9][i % 9]);
+
+    return line;
+}
+
+/* Digit of a cell in the line format of grids larger than 9x9: 1-9,
+   then A (or a) for 10 up to P for 25, and 0 for '.' or '0'. -1 for
+   any other character */
+inline int GridDigit(char c) noexcept
+{
+    if (c == '.' || c == '0')
+        return 0;
+    if (c >= '1' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'P')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'p')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/* ParsePuzzle for a BoxGrid: Box^4 cells row by row, in the digits of
+   GridDigit, so "1-9A-G" for 16x16. On 9x9 it reads what ParsePuzzle
+   reads */
+template <std::size_t Box>
+std::optional<BoxGrid<Box>> ParseBoxPuzzle(std::string_view line) noexcept
+{
+    constexpr std::size_t Side = Box * Box;
+    if (line.size() < Side * Side)
+        return {};
+
+    BoxGrid<Box> grid;
+
+    for (std::size_t i = 0; i < Side * Side; ++i)
+    {
+        auto num = GridDigit(line[i]);
+        if (num < 0 || static_cast<std::size_t>(num) > Side)
+            return {};
+        grid[i / Side][i % Side] = static_cast<std::size_t>(num);
+    }
+
+    return grid;
+}
+
+/* Inverse of ParseBoxPuzzle, empty cells are written as '.' */
+template <std::size_t Box>
+std::string ToBoxString(const BoxGrid<Box>& grid)
+{
+    constexpr std::size_t Side = Box * Box;
+    std::string line(Side * Side, '.');
+
+    for (std::size_t i = 0; i < Side * Side; ++i)
+    {
+        auto num = grid[i / Side][i % Side];
+        if (num != 0)
+            line[i] = num <= 9 ? static_cast<char>('0' + num) : static_cast<char>('A' + num - 10);
+    }
+
+    return line;
+}
+
+/* Reads every puzzle line of a stream. Blank lines and lines starting
+   with '#' are skipped, so corpus files can carry a comment header */
+inline std::vector<Puzzle_t> ReadPuzzles(std::istream& in)
+{
+    std::vector<Puzzle_t> puzzles;
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        if (auto grid = ParsePuzzle(line))
+            puzzles.push_back(*grid);
+    }
+
+    return puzzles;
+}
+
+/* ReadPuzzles for BoxGrid puzzles. Lines of other lengths are skipped,
+   so one file can hold 16x16 and 25x25 puzzles */
+template <std::size_t Box>
+std::vector<BoxGrid<Box>> ReadBoxPuzzles(std::istream& in)
+{
+    std::vector<BoxGrid<Box>> puzzles;
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.size() != Box * Box * Box * Box)
+            continue;
+
+        if (auto grid = ParseBoxPuzzle<Box>(line))
+            puzzles.push_back(*grid);
+    }
+
+    return puzzles;
+}
+
+
+} // End of namespace Sudoku
+
+#endif // IO_HPP
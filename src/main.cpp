@@ -2,11 +2,15 @@
 #include <QTranslator>
 #include <mainwindow.h>
 
+#include <cstdlib>
 #include <iostream>
 
+#include "trace.hpp"
+
 int main(int argc, char* argv[])
 {
     QApplication app (argc, argv);
+    SUDOKU_TRACE_THREAD("gui");
 
     QTranslator translator;
 
@@ -22,6 +26,13 @@ int main(int argc, char* argv[])
     win.setWindowTitle("Sudoku");
     win.move(200, 200);
     win.show();
-    
-    return app.exec();
+
+    auto status = app.exec();
+
+    // With tracing compiled in, SUDOKU_TRACE=file.json keeps the session's trace
+    if (auto path = std::getenv("SUDOKU_TRACE"))
+        if (!Sudoku::WriteChromeTrace(std::string(path)))
+            std::cerr << "cannot write trace to " << path << "\n";
+
+    return status;
 }
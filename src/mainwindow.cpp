@@ -2,19 +2,30 @@
 #include "ui_mainwindow.h"
 #include "mylineedit.h"
 #include "solver.hpp"
+#include "engines.hpp"
+#include "trace.hpp"
 
+#include <QDir>
+#include <QFile>
 #include <QMessageBox>
 #include <QGridLayout>
+#include <QStandardPaths>
+#include <QStatusBar>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent), ui(new Ui::MainWindow{}), dif{Difficulty::Easy},
-    btn_storage{}, grid{Sudoku::GeneratePuzzle(dif)}, layout{nullptr}, serifFont{"Times", 13, QFont::Bold}
+    btn_storage{}, grid{}, layout{nullptr}, serifFont{"Times", 13, QFont::Bold},
+    book_data{}, book{}, gen{std::random_device{}()}, seen{}
 {
   for (auto& row : btn_storage)
         row.fill(nullptr);
 
     ui->setupUi(this);
 
+    load_book();
+    open_seen();
+    grid = next_puzzle();
+
     init_board();
     create_puzzle();
 }
@@ -32,6 +43,8 @@ void MainWindow::about()
 
 void MainWindow::cell_changed(Row row, Col col)
 {
+    SUDOKU_TRACE_SCOPE("gui/cell_changed");
+
     auto x = row.get();
     auto y = col.get();
 
@@ -77,9 +90,12 @@ void MainWindow::cell_changed(Row row, Col col)
 
 void MainWindow::new_game()
 {
+    SUDOKU_TRACE_SCOPE("gui/new_game");
+
     clear_all();
+    statusBar()->clearMessage();
 
-    grid = Sudoku::GeneratePuzzle(dif);
+    grid = next_puzzle();
 
     create_puzzle();
 }
@@ -113,11 +129,69 @@ void MainWindow::hard()
 
 void MainWindow::solve()
 {
-    Sudoku::SolveSudoku(grid);
+    SUDOKU_TRACE_SCOPE("gui/solve");
+
+    // The board may hold user moves that make it unsolvable, and proving
+    // that can take long, so never block the UI for more than a few seconds
+    Sudoku::SolveOptions options;
+    options.Timeout(std::chrono::seconds(3));
+
+    Sudoku::SolveStats stats;
+    auto result = Sudoku::SolveWith(Sudoku::Engine::MRV, grid, options, 0, &stats);
+
+    statusBar()->showMessage(tr("%1 nodes, %2 guesses, %3 backtracks, %4 naked singles, max depth %5")
+                             .arg(stats.nodes).arg(stats.guesses).arg(stats.backtracks)
+                             .arg(stats.naked_singles).arg(stats.max_depth));
+
+    if (result.Solved())
+        grid = result.grid;
+    else if (result.status == Sudoku::SolveStatus::Unsolvable)
+        QMessageBox::warning(this, tr("Solve"),
+                             tr("This board has no solution."));
+    else
+        QMessageBox::warning(this, tr("Solve"),
+                             tr("Gave up, this board takes too long to solve."));
+
     clear_highlights();
     create_puzzle();
 }
 
+void MainWindow::load_book()
+{
+    QFile file(":/book/book.bin");
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    book_data = file.readAll();
+    book = Sudoku::PuzzleBook::FromBytes(reinterpret_cast<const unsigned char*>(book_data.constData()),
+                                         static_cast<std::size_t>(book_data.size()));
+}
+
+/* Without a writable config directory the game simply forgets what was
+   played */
+void MainWindow::open_seen()
+{
+    auto dir = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation);
+    if (dir.isEmpty() || !QDir().mkpath(dir))
+        return;
+
+    seen = Sudoku::SeenFilter(QDir(dir).filePath("seen.bin").toStdString());
+}
+
+/* A random variant of a book puzzle not played before, or a freshly
+   generated one if the book is missing, has no puzzle of this
+   difficulty or keeps drawing puzzles already played */
+Puzzle_t MainWindow::next_puzzle()
+{
+    if (book && book->Count(dif) != 0)
+        if (auto puzzle = Sudoku::DrawUnseen(seen, [this]{ return book->RandomVariant(dif, gen); }, 32))
+            return *puzzle;
+
+    auto puzzle = Sudoku::GeneratePuzzle(dif);
+    seen.Insert(puzzle);
+    return puzzle;
+}
+
 void MainWindow::init_board()
 {
     layout = new QGridLayout(ui->centralwidget);
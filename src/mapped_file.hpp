@@ -0,0 +1,229 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SUDOKU_HAVE_MMAP 1
+#endif
+
+
+namespace Sudoku {
+
+/* A whole file, for the readers that work on bytes in place (PuzzleBook,
+   PuzzleDb) and, opened with Writable(), for the stores that update
+   bytes in place (SeenFilter). Mapped where the system has mmap, so
+   opening a large file costs nothing until pages are touched and
+   writes reach the file without a save step; read into memory
+   otherwise, and then a writable file is written back when the object
+   goes. Data() is valid as long as the object lives, or until Reset() */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path)
+    {
+#ifdef SUDOKU_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0)
+        {
+            auto size = static_cast<std::size_t>(st.st_size);
+            void* addr = size == 0 ? MAP_FAILED : ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+
+            if (addr != MAP_FAILED)
+            {
+                map = addr;
+                bytes = static_cast<unsigned char*>(addr);
+                length = size;
+            }
+            else if (size == 0)
+                bytes = &Empty(); // open, but nothing to map
+        }
+
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return;
+
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        bytes = reinterpret_cast<unsigned char*>(buffer.data());
+        length = buffer.size();
+#endif
+    }
+
+    /* Opens path for reading and writing, creating it empty if it does
+       not exist. Not open if the file cannot be created or mapped */
+    static MappedFile Writable(const std::string& path)
+    {
+        MappedFile file;
+#ifdef SUDOKU_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return file;
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !file.MapWritable(fd, static_cast<std::size_t>(st.st_size)))
+        {
+            ::close(fd);
+            return file;
+        }
+        file.descriptor = fd;
+#else
+        {
+            std::ifstream in(path, std::ios::binary);
+            file.buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        if (!std::ofstream(path, std::ios::binary | std::ios::app))
+            return file;
+
+        file.save_path = path;
+        file.bytes = file.buffer.empty() ? &Empty() : reinterpret_cast<unsigned char*>(file.buffer.data());
+        file.length = file.buffer.size();
+#endif
+        file.writable = true;
+        return file;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Release();
+            std::swap(map, other.map);
+            std::swap(bytes, other.bytes);
+            std::swap(length, other.length);
+            std::swap(writable, other.writable);
+            std::swap(descriptor, other.descriptor);
+            std::swap(save_path, other.save_path);
+            buffer.swap(other.buffer);
+        }
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        Release();
+    }
+
+    bool IsOpen() const noexcept {return bytes != nullptr;}
+    const unsigned char* Data() const noexcept {return bytes;}
+    std::size_t Size() const noexcept {return length;}
+
+    /* The bytes to update in place, null unless opened with Writable() */
+    unsigned char* MutableData() noexcept {return writable ? bytes : nullptr;}
+
+    /* Replaces the contents of a writable file with size zero bytes;
+       false, and the file no longer open, if that fails */
+    bool Reset(std::size_t size)
+    {
+        if (!writable)
+            return false;
+#ifdef SUDOKU_HAVE_MMAP
+        if (map != nullptr)
+            ::munmap(map, length);
+        map = nullptr;
+        bytes = nullptr;
+        length = 0;
+
+        if (::ftruncate(descriptor, 0) != 0 || ::ftruncate(descriptor, static_cast<off_t>(size)) != 0 ||
+            !MapWritable(descriptor, size))
+        {
+            Release();
+            return false;
+        }
+#else
+        buffer.assign(size, 0);
+        bytes = size == 0 ? &Empty() : reinterpret_cast<unsigned char*>(buffer.data());
+        length = size;
+#endif
+        return true;
+    }
+
+private:
+    /* Where an empty file points, so that it still shows as open. Never
+       written: there is no byte of it to write */
+    static unsigned char& Empty() noexcept
+    {
+        static unsigned char empty = 0;
+        return empty;
+    }
+
+#ifdef SUDOKU_HAVE_MMAP
+    bool MapWritable(int file, std::size_t size) noexcept
+    {
+        if (size == 0)
+        {
+            bytes = &Empty();
+            return true;
+        }
+
+        void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (addr == MAP_FAILED)
+            return false;
+
+        map = addr;
+        bytes = static_cast<unsigned char*>(addr);
+        length = size;
+        return true;
+    }
+#endif
+
+    void Release() noexcept
+    {
+#ifdef SUDOKU_HAVE_MMAP
+        if (map != nullptr)
+            ::munmap(map, length);
+        if (descriptor >= 0)
+            ::close(descriptor);
+#else
+        if (writable && bytes != nullptr)
+        {
+            std::ofstream out(save_path, std::ios::binary | std::ios::trunc);
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        }
+#endif
+        map = nullptr;
+        bytes = nullptr;
+        length = 0;
+        writable = false;
+        descriptor = -1;
+        save_path.clear();
+        buffer.clear();
+    }
+
+    void* map = nullptr;
+    unsigned char* bytes = nullptr;
+    std::size_t length = 0;
+    bool writable = false;
+    int descriptor = -1;       // kept by a writable file for Reset()
+    std::string save_path;     // without mmap, where a writable file goes back
+    std::vector<char> buffer;  // without mmap
+};
+
+
+} // End of namespace Sudoku
+
+#endif // MAPPED_FILE_HPP
@@ -0,0 +1,409 @@
+#ifndef MPMC_QUEUE_HPP
+#define MPMC_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "futex.hpp"
+
+
+namespace Sudoku {
+
+/* Bounded lock-free queue for any number of producers and consumers,
+   after Dmitry Vyukov's bounded MPMC queue.
+
+   Every cell carries a sequence number. The cell of position pos is
+   free for the producer of pos when its sequence is pos, and holds that
+   producer's item for the consumer of pos when it is pos + 1; the
+   consumer then sets it to pos + capacity, which frees the cell for the
+   producer of the next lap. Producers claim positions with a CAS on the
+   enqueue index and consumers with a CAS on the dequeue index, so each
+   side only contends with its own kind, and the item itself is handed
+   over through the cell's sequence. Each index sits on a cache line of
+   its own.
+
+   TryPushBatch and TryPopBatch claim a run of ready cells with a single
+   CAS, so that workers moving several items at a time touch the shared
+   indices that much less often */
+template <typename T>
+class MpmcRing
+{
+public:
+    static constexpr std::size_t CacheLine = 64;
+
+    /* capacity is rounded up to a power of two, 2 at least */
+    explicit MpmcRing(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        mask = size - 1;
+        cells = std::make_unique<Cell[]>(size);
+        for (std::size_t i = 0; i < size; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    ~MpmcRing()
+    {
+        while (TryPop())
+            ;
+    }
+
+    std::size_t Capacity() const noexcept {return mask + 1;}
+
+    /* Nothing to pop, or no room to push, at the time of the call */
+    bool Empty() const noexcept
+    {
+        auto pos = dequeue_pos.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    bool Full() const noexcept
+    {
+        auto pos = enqueue_pos.load(std::memory_order_relaxed);
+        return Lag(cells[pos & mask].sequence.load(std::memory_order_acquire), pos) < 0;
+    }
+
+    /* Pushes value unless the ring is full. An rvalue is only moved from
+       when it went in */
+    template <typename U>
+    bool TryPush(U&& value)
+    {
+        auto pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells[pos & mask];
+            auto lag = Lag(cell.sequence.load(std::memory_order_acquire), pos);
+            if (lag == 0)
+            {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    new (cell.storage) T(std::forward<U>(value));
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0)
+                return false;   // the consumer of the previous lap is not done
+            else
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::optional<T> TryPop()
+    {
+        auto pos = dequeue_pos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells[pos & mask];
+            auto lag = Lag(cell.sequence.load(std::memory_order_acquire), pos + 1);
+            if (lag == 0)
+            {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    std::optional<T> value{std::move(*cell.Item())};
+                    cell.Item()->~T();
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return value;
+                }
+            }
+            else if (lag < 0)
+                return {};      // empty
+            else
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    /* Moves in up to count items from first on; returns how many, 0 if
+       the ring is full */
+    template <typename It>
+    std::size_t TryPushBatch(It first, std::size_t count)
+    {
+        auto pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            std::size_t ready = 0;
+            while (ready < count && ready <= mask &&
+                   cells[(pos + ready) & mask].sequence.load(std::memory_order_acquire) == pos + ready)
+                ++ready;
+
+            if (ready == 0)
+            {
+                if (count == 0 || Lag(cells[pos & mask].sequence.load(std::memory_order_acquire), pos) < 0)
+                    return 0;
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (enqueue_pos.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed))
+            {
+                for (std::size_t k = 0; k < ready; ++k, ++first)
+                {
+                    auto& cell = cells[(pos + k) & mask];
+                    new (cell.storage) T(std::move(*first));
+                    cell.sequence.store(pos + k + 1, std::memory_order_release);
+                }
+                return ready;
+            }
+        }
+    }
+
+    /* Pops up to count items into out; returns how many, 0 if the ring
+       is empty */
+    template <typename Out>
+    std::size_t TryPopBatch(Out out, std::size_t count)
+    {
+        auto pos = dequeue_pos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            std::size_t ready = 0;
+            while (ready < count && ready <= mask &&
+                   cells[(pos + ready) & mask].sequence.load(std::memory_order_acquire) == pos + ready + 1)
+                ++ready;
+
+            if (ready == 0)
+            {
+                if (count == 0 || Lag(cells[pos & mask].sequence.load(std::memory_order_acquire), pos + 1) < 0)
+                    return 0;
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (dequeue_pos.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed))
+            {
+                for (std::size_t k = 0; k < ready; ++k)
+                {
+                    auto& cell = cells[(pos + k) & mask];
+                    *out++ = std::move(*cell.Item());
+                    cell.Item()->~T();
+                    cell.sequence.store(pos + k + mask + 1, std::memory_order_release);
+                }
+                return ready;
+            }
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence{0};
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* Item() noexcept {return std::launder(reinterpret_cast<T*>(storage));}
+    };
+
+    /* How far sequence is from the one expected, modulo wrap around */
+    static std::ptrdiff_t Lag(std::size_t sequence, std::size_t expected) noexcept
+    {
+        return static_cast<std::ptrdiff_t>(sequence - expected);
+    }
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask = 0;
+    alignas(CacheLine) std::atomic<std::size_t> enqueue_pos{0};
+    alignas(CacheLine) std::atomic<std::size_t> dequeue_pos{0};
+};
+
+/* MpmcRing behind the interface of BlockingQueue: Push waits while the
+   ring is full, Pop while it is empty, Close() wakes everybody and Pop
+   drains what is left. A waiter spins a little, then sleeps on a futex.
+   The other side only pays for the wake call when somebody sleeps, so a
+   busy pipeline never enters the kernel.
+
+   Close() is meant for the producers once they are done, as in the
+   pipelines here: an item pushed concurrently with Close() may be left
+   for the destructor */
+template <typename T>
+class BlockingMpmcQueue
+{
+public:
+    explicit BlockingMpmcQueue(std::size_t capacity) : ring{capacity} {}
+
+    bool Push(T value)
+    {
+        while (!closed.load())
+        {
+            if (ring.TryPush(std::move(value)))
+            {
+                Signal(not_empty, 1);
+                return true;
+            }
+            Wait(not_full, [this]{ return !ring.Full(); }, Forever());
+        }
+        return false;
+    }
+
+    /* Pushes the count items from first on, waiting for room as needed;
+       false if the queue was closed first */
+    template <typename It>
+    bool PushBatch(It first, std::size_t count)
+    {
+        while (count != 0 && !closed.load())
+        {
+            auto pushed = ring.TryPushBatch(first, count);
+            if (pushed != 0)
+            {
+                Signal(not_empty, static_cast<int>(std::min<std::size_t>(pushed, INT_MAX)));
+                std::advance(first, pushed);
+                count -= pushed;
+            }
+            else
+                Wait(not_full, [this]{ return !ring.Full(); }, Forever());
+        }
+        return count == 0;
+    }
+
+    std::optional<T> Pop()
+    {
+        return PopUntil(Forever());
+    }
+
+    /* Pop without waiting: nothing if the queue is empty */
+    std::optional<T> TryPop()
+    {
+        auto value = ring.TryPop();
+        if (value)
+            Signal(not_full, 1);
+        return value;
+    }
+
+    /* Pop waiting at most timeout: nothing if the queue stays empty */
+    template <typename Rep, typename Period>
+    std::optional<T> PopFor(std::chrono::duration<Rep, Period> timeout)
+    {
+        return PopUntil(std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout));
+    }
+
+    /* Waits for at least one item and pops up to count into out; returns
+       how many, 0 once the queue is closed and drained */
+    template <typename Out>
+    std::size_t PopBatch(Out out, std::size_t count)
+    {
+        for (;;)
+        {
+            auto popped = ring.TryPopBatch(out, count);
+            if (popped != 0)
+            {
+                Signal(not_full, static_cast<int>(std::min<std::size_t>(popped, INT_MAX)));
+                return popped;
+            }
+            if (closed.load())
+            {
+                popped = ring.TryPopBatch(out, count);
+                if (popped != 0)
+                    Signal(not_full, static_cast<int>(std::min<std::size_t>(popped, INT_MAX)));
+                return popped;
+            }
+            Wait(not_empty, [this]{ return !ring.Empty() || closed.load(); }, Forever());
+        }
+    }
+
+    void Close()
+    {
+        closed.store(true);
+        for (auto waiters : {&not_empty, &not_full})
+        {
+            waiters->epoch.fetch_add(1);
+            FutexWake(waiters->epoch);
+        }
+    }
+
+    /* Closed and empty: Pop will never return anything again */
+    bool Drained() const noexcept
+    {
+        return closed.load() && ring.Empty();
+    }
+
+private:
+    static constexpr std::size_t SpinLimit = 32;
+
+    /* The threads asleep on one condition and the futex word they sleep
+       on, bumped whenever the condition may have changed for them */
+    struct alignas(MpmcRing<T>::CacheLine) Waiters
+    {
+        std::atomic<std::uint32_t> epoch{0};
+        std::atomic<std::uint32_t> sleepers{0};
+    };
+
+    static std::chrono::steady_clock::time_point Forever() noexcept
+    {
+        return std::chrono::steady_clock::time_point::max();
+    }
+
+    std::optional<T> PopUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        for (;;)
+        {
+            if (auto value = TryPop())
+                return value;
+            if (closed.load())
+                return TryPop();
+            if (!Wait(not_empty, [this]{ return !ring.Empty() || closed.load(); }, deadline))
+                return TryPop();
+        }
+    }
+
+    /* Tells the waiters that the ring changed for them. The fence pairs
+       with the one after the sleepers increment in Wait(): either this
+       sees the sleeper, or the sleeper sees the change */
+    static void Signal(Waiters& waiters, int count) noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.sleepers.load(std::memory_order_relaxed) != 0)
+        {
+            waiters.epoch.fetch_add(1);
+            FutexWake(waiters.epoch, count);
+        }
+    }
+
+    /* Spins, then sleeps until ready() may hold; false once past
+       deadline */
+    template <typename Ready>
+    bool Wait(Waiters& waiters, Ready ready, std::chrono::steady_clock::time_point deadline)
+    {
+        for (std::size_t spin = 0; spin < SpinLimit; ++spin)
+        {
+            if (ready())
+                return true;
+            std::this_thread::yield();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return false;
+
+        auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+        waiters.sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto seen = waiters.epoch.load();
+        if (!ready())
+            FutexWait(waiters.epoch, seen, std::min<std::chrono::nanoseconds>(left, std::chrono::milliseconds(100)));
+        waiters.sleepers.fetch_sub(1);
+        return true;
+    }
+
+    MpmcRing<T> ring;
+    Waiters not_empty;
+    Waiters not_full;
+    std::atomic<bool> closed{false};
+};
+
+
+} // End of namespace Sudoku
+
+#endif // MPMC_QUEUE_HPP
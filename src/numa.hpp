@@ -0,0 +1,303 @@
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <filesystem>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace Sudoku {
+
+/* Just enough NUMA for placing worker threads, without libnuma: the
+   CPUs of each node as the kernel lists them under
+   /sys/devices/system/node, restricted to the CPUs this process may run
+   on, and thread pinning. Memory placement is left to the kernel's
+   default first-touch policy: a page lands on the node of the thread
+   that writes it first, so buffers allocated and filled by a pinned
+   worker stay local to it. Elsewhere than on Linux the machine is one
+   node and pinning does nothing */
+
+struct NumaNode
+{
+    int id = 0;
+    std::vector<int> cpus;
+    std::vector<int> distances;    // to every node, by id, as the kernel gives them
+};
+
+struct NumaTopology
+{
+    std::vector<NumaNode> nodes;   // the nodes with CPUs we may use, by id
+
+    /* Index in nodes of the node holding cpu, 0 if unknown */
+    std::size_t NodeOf(int cpu) const noexcept
+    {
+        for (std::size_t n = 0; n < nodes.size(); ++n)
+            if (std::find(nodes[n].cpus.begin(), nodes[n].cpus.end(), cpu) != nodes[n].cpus.end())
+                return n;
+        return 0;
+    }
+
+    /* Relative cost of node a reaching the memory of node b (indices in
+       nodes), 10 for itself as in the ACPI tables */
+    int Distance(std::size_t a, std::size_t b) const noexcept
+    {
+        auto id = static_cast<std::size_t>(nodes[b].id);
+        if (id < nodes[a].distances.size())
+            return nodes[a].distances[id];
+        return a == b ? 10 : 20;
+    }
+
+    /* The other nodes, nearest first */
+    std::vector<std::size_t> Neighbours(std::size_t node) const
+    {
+        std::vector<std::size_t> order;
+        for (std::size_t n = 0; n < nodes.size(); ++n)
+            if (n != node)
+                order.push_back(n);
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            return Distance(node, a) < Distance(node, b);
+        });
+        return order;
+    }
+};
+
+/* Parses a kernel CPU list such as "0-3,8,10-11"; empty if malformed */
+inline std::vector<int> ParseCpuList(std::string_view list)
+{
+    std::vector<int> cpus;
+    while (!list.empty() && (list.back() == '\n' || list.back() == ' '))
+        list.remove_suffix(1);
+
+    while (!list.empty())
+    {
+        auto comma = list.find(',');
+        auto range = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+
+        auto dash = range.find('-');
+        std::string low(range.substr(0, dash));
+        std::string high(dash == std::string_view::npos ? low : std::string(range.substr(dash + 1)));
+        if (low.empty() || high.empty() ||
+            low.find_first_not_of("0123456789") != std::string::npos ||
+            high.find_first_not_of("0123456789") != std::string::npos)
+            return {};
+
+        int first = std::atoi(low.c_str());
+        int last = std::atoi(high.c_str());
+        if (last < first)
+            return {};
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+inline std::string FormatCpuList(const std::vector<int>& cpus)
+{
+    std::string out;
+    for (std::size_t i = 0; i < cpus.size();)
+    {
+        auto j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            ++j;
+
+        if (!out.empty())
+            out += ',';
+        out += std::to_string(cpus[i]);
+        if (j != i)
+            out += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+/* CPUs the calling thread may run on, as set by taskset or a cgroup */
+inline std::vector<int> AllowedCpus()
+{
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof set, &set) == 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+#endif
+    if (cpus.empty())
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+            cpus.push_back(static_cast<int>(cpu));
+    return cpus;
+}
+
+inline NumaTopology DetectNuma()
+{
+    auto allowed = AllowedCpus();
+    NumaTopology topology;
+
+#if defined(__linux__)
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it("/sys/devices/system/node", ec), end; !ec && it != end;
+         it.increment(ec))
+    {
+        auto name = it->path().filename().string();
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+            name.find_first_not_of("0123456789", 4) != std::string::npos)
+            continue;
+
+        std::ifstream in(it->path() / "cpulist");
+        std::string list;
+        std::getline(in, list);
+
+        NumaNode node;
+        node.id = std::atoi(name.c_str() + 4);
+        for (int cpu : ParseCpuList(list))
+            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                node.cpus.push_back(cpu);
+
+        std::ifstream distances(it->path() / "distance");
+        for (int d; distances >> d;)
+            node.distances.push_back(d);
+
+        if (!node.cpus.empty())
+            topology.nodes.push_back(std::move(node));
+    }
+    std::sort(topology.nodes.begin(), topology.nodes.end(),
+              [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+#endif
+
+    if (topology.nodes.empty())
+    {
+        topology.nodes.emplace_back();
+        topology.nodes.back().cpus = std::move(allowed);
+    }
+    return topology;
+}
+
+/* The CPU of each of threads workers under policy:
+     compact   fills the CPUs of the first node before the next one
+     scatter   deals workers out to the nodes in turn
+     a list    such as "0-7,16-23", used in order
+   Workers wrap around when there are more of them than CPUs. Empty if
+   policy is none of these */
+inline std::optional<std::vector<int>> WorkerCpus(const NumaTopology& topology, std::string_view policy,
+                                                  std::size_t threads)
+{
+    std::vector<int> order;
+    if (policy == "compact")
+    {
+        for (const auto& node : topology.nodes)
+            order.insert(order.end(), node.cpus.begin(), node.cpus.end());
+    }
+    else if (policy == "scatter")
+    {
+        for (std::size_t k = 0; order.size() < threads; ++k)
+        {
+            auto before = order.size();
+            for (const auto& node : topology.nodes)
+                if (k < node.cpus.size())
+                    order.push_back(node.cpus[k]);
+            if (order.size() == before)
+                break;
+        }
+    }
+    else
+        order = ParseCpuList(policy);
+
+    if (order.empty())
+        return {};
+
+    std::vector<int> cpus(threads);
+    for (std::size_t w = 0; w < threads; ++w)
+        cpus[w] = order[w % order.size()];
+    return cpus;
+}
+
+namespace detail {
+
+/* Part j of m of cpus, cut in contiguous slices as even as they go.
+   With more parts than CPUs, a part too small for a CPU of its own
+   shares the one where it would start, which spreads the sharing */
+inline std::vector<int> CpuSlice(const std::vector<int>& cpus, std::size_t j, std::size_t m)
+{
+    auto begin = cpus.size() * j / m;
+    auto end = cpus.size() * (j + 1) / m;
+    if (begin == end)
+        return {cpus[std::min(begin, cpus.size() - 1)]};
+    return std::vector<int>(cpus.begin() + static_cast<std::ptrdiff_t>(begin),
+                            cpus.begin() + static_cast<std::ptrdiff_t>(end));
+}
+
+} // End of namespace detail
+
+/* The CPUs of each of shards processes under policy, disjoint as long
+   as there are at least as many CPUs as shards:
+     compact   cuts the CPUs, node after node, in consecutive slices
+     scatter   deals shards out to the nodes in turn, and splits the
+               CPUs of a node between the shards it got
+     a list    cut in consecutive slices
+   Empty if policy is none of these */
+inline std::optional<std::vector<std::vector<int>>> ShardCpus(const NumaTopology& topology,
+                                                             std::string_view policy, std::size_t shards)
+{
+    std::vector<int> order;
+    if (policy == "scatter")
+    {
+        std::vector<std::vector<int>> cpus(shards);
+        auto nodes = topology.nodes.size();
+        for (std::size_t k = 0; k < shards; ++k)
+        {
+            auto node = k % nodes;
+            auto sharing = shards / nodes + (node < shards % nodes);
+            cpus[k] = detail::CpuSlice(topology.nodes[node].cpus, k / nodes, sharing);
+        }
+        return cpus;
+    }
+    else if (policy == "compact")
+    {
+        for (const auto& node : topology.nodes)
+            order.insert(order.end(), node.cpus.begin(), node.cpus.end());
+    }
+    else
+        order = ParseCpuList(policy);
+
+    if (order.empty())
+        return {};
+
+    std::vector<std::vector<int>> cpus(shards);
+    for (std::size_t k = 0; k < shards; ++k)
+        cpus[k] = detail::CpuSlice(order, k, shards);
+    return cpus;
+}
+
+/* Binds the calling thread to cpu; false where that is not possible */
+inline bool PinThread(int cpu) noexcept
+{
+#if defined(__linux__)
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+
+} // End of namespace Sudoku
+
+#endif // NUMA_HPP
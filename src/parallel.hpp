@@ -0,0 +1,420 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "my_types.h"
+#include "budget.hpp"
+#include "search.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+
+namespace Sudoku {
+
+/* Tuning knobs for the parallel searches. The tree is split into one
+   task per candidate until split_depth real guesses (cells with more
+   than one candidate) have been made, below that each task runs the
+   sequential SearchState, or BoxSearchState on 16x16 and 25x25 grids */
+struct ParallelOptions
+{
+    std::size_t split_depth = 4;
+};
+
+/* Snapshot handed to the progress callback of CountSolutionsParallel */
+struct CountProgress
+{
+    std::uint64_t solutions;   // solutions counted so far
+    std::uint64_t tasks_done;  // finished subtrees
+    std::uint64_t tasks_total; // subtrees created so far
+};
+
+struct CountOptions
+{
+    std::uint64_t limit = 0;   // 0 counts every solution
+
+    /* Digits that do not appear among the givens are interchangeable:
+       swapping two of them maps solutions to solutions. When set, only
+       one representative per orbit is searched and its count is
+       multiplied by the orbit size */
+    bool use_symmetry = true;
+
+    std::function<void(const CountProgress&)> progress;
+    std::chrono::milliseconds progress_interval{500};
+
+    /* max_nodes is shared by all workers */
+    SolveOptions budget;
+
+    ParallelOptions parallel;
+};
+
+struct CountResult
+{
+    std::uint64_t solutions = 0;
+
+    /* Solved when the count is complete (or reached the limit),
+       BudgetExceeded or Cancelled when it is only a lower bound */
+    SolveStatus status = SolveStatus::Solved;
+};
+
+namespace detail {
+
+/* Counter padded to its own cache line, so per-thread counters
+   do not false-share. Only the owning worker writes it */
+struct alignas(64) PaddedCounter
+{
+    std::atomic<std::uint64_t> value{0};
+
+    void Add(std::uint64_t n) noexcept
+    {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+/* Shared state of one parallel search over grids of boxes Box cells
+   wide */
+template <std::size_t Box>
+struct ParallelSearch
+{
+    ThreadPool& pool;
+    ParallelOptions options;
+    SolveOptions budget;
+    std::uint64_t limit = 0;               // 0 means no limit
+    std::atomic<bool> cancel{false};       // stops every task
+    std::atomic<int> stop_reason{-1};      // first budget failure, as a SolveStatus
+    std::atomic<std::uint64_t> charged{0}; // nodes charged against budget.max_nodes
+    std::atomic<std::uint64_t> found{0};   // only used when limit != 0
+    std::atomic<std::uint64_t> tasks_total{0};
+    std::atomic<std::uint64_t> tasks_done{0};
+    std::vector<PaddedCounter> counters;   // solutions, one per worker
+    std::vector<PaddedCounter> nodes;      // nodes, one per worker
+    std::mutex solution_mutex;
+    std::optional<BoxGrid<Box>> solution;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    bool finished = false;                 // guarded by done_mutex
+
+    ParallelSearch(ThreadPool& p, ParallelOptions opt, const SolveOptions& b, std::uint64_t lim)
+        : pool{p}, options{opt}, budget{b}, limit{lim}, counters(p.Size()), nodes(p.Size()) {}
+
+    Budget MakeBudget() {return Budget{budget, &cancel, &charged};}
+
+    /* Called when a task returns, stops the others if its budget ran out */
+    void Finish(const Budget& b)
+    {
+        nodes[ThreadPool::CurrentWorker()].Add(b.Nodes());
+
+        if (b.Stopped() && !cancel.load(std::memory_order_relaxed))
+        {
+            int expected = -1;
+            stop_reason.compare_exchange_strong(expected, static_cast<int>(b.Reason()));
+            cancel.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    /* Called as a task returns. Children are counted in tasks_total
+       before their parent is done, so done catching up with total means
+       every task of this search finished. The last one raises finished
+       under the lock and touches nothing after, as the waiter may then
+       destroy the search */
+    void TaskDone()
+    {
+        if (tasks_done.fetch_add(1) + 1 != tasks_total.load())
+            return;
+
+        std::lock_guard<std::mutex> lk(done_mutex);
+        finished = true;
+        done_cv.notify_all();
+    }
+
+    /* Blocks until every task of this search finished, whatever else
+       the pool is running */
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lk(done_mutex);
+        done_cv.wait(lk, [this]{ return finished; });
+    }
+
+    /* Same as Wait, but gives up after timeout.
+       Returns true if the search finished */
+    template <typename Duration>
+    bool WaitFor(Duration timeout)
+    {
+        std::unique_lock<std::mutex> lk(done_mutex);
+        return done_cv.wait_for(lk, timeout, [this]{ return finished; });
+    }
+
+    /* Records weight solutions, returns false when the search should stop */
+    bool Report(const BoxSearchState<Box>& state, std::uint64_t weight)
+    {
+        counters[ThreadPool::CurrentWorker()].Add(weight);
+
+        if (limit == 0)
+            return true;
+
+        if (found.fetch_add(weight, std::memory_order_relaxed) == 0)
+        {
+            std::lock_guard<std::mutex> lk(solution_mutex);
+            solution = state.Grid();
+        }
+
+        if (found.load(std::memory_order_relaxed) >= limit)
+        {
+            cancel.store(true, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    static std::uint64_t Sum(const std::vector<PaddedCounter>& v) noexcept
+    {
+        std::uint64_t total = 0;
+        for (const auto& c : v)
+            total += c.value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    std::uint64_t Total() const noexcept {return Sum(counters);}
+
+    /* Status of a search that did not reach its goal */
+    SolveStatus Failure() const noexcept
+    {
+        auto reason = stop_reason.load();
+        return reason < 0 ? SolveStatus::Unsolvable : static_cast<SolveStatus>(reason);
+    }
+};
+
+/* Sequential count of the subtree below state, where the digits in free
+   have not been placed yet and are still interchangeable. Once free is
+   empty the plain iterative search takes over */
+template <std::size_t Box>
+std::uint64_t CountSymmetric(BoxSearchState<Box>& state, typename BoxGeometry<Box>::Mask free,
+                             Budget& budget)
+{
+    using Mask = typename BoxGeometry<Box>::Mask;
+
+    if (free == 0)
+    {
+        BoxSearchState<Box> rest(state.Grid());
+        rest.SetBudget(budget);
+
+        std::uint64_t count = 0;
+        while (rest.Next())
+            ++count;
+
+        budget = rest.GetBudget();
+        return count;
+    }
+
+    auto cell = state.ChooseCell();
+    if (cell == state.Cells)
+        return 1;
+
+    auto cand = state.Candidates(cell);
+    std::uint64_t count = 0;
+
+    for (auto other = static_cast<Mask>(cand & ~free); other != 0; other &= other - 1)
+    {
+        if (budget.Tick())
+            return count;
+
+        state.Place(cell, static_cast<std::size_t>(LowestBit(other) + 1));
+        count += CountSymmetric(state, free, budget);
+        state.Remove(cell);
+
+        if (budget.Stopped())
+            return count;
+    }
+
+    // Free digits are candidates everywhere, trying the lowest one covers them all
+    auto bit = LowestBit(free);
+    state.Place(cell, static_cast<std::size_t>(bit + 1));
+    count += static_cast<std::uint64_t>(PopCount(free)) *
+             CountSymmetric(state, static_cast<Mask>(free & (free - 1)), budget);
+    state.Remove(cell);
+
+    return count;
+}
+
+/* Explores the subtree rooted at grid, whose solutions each stand for
+   weight solutions of the original puzzle. Forced cells are filled in
+   place, real guesses above split_depth become new pool tasks */
+template <std::size_t Box>
+void SearchTask(ParallelSearch<Box>& search, const BoxGrid<Box>& grid,
+                std::size_t depth, std::uint64_t weight, typename BoxGeometry<Box>::Mask free)
+{
+    using Mask = typename BoxGeometry<Box>::Mask;
+
+    struct Done
+    {
+        ParallelSearch<Box>& s;
+        ~Done() {s.TaskDone();}
+    } done{search};
+
+    if (search.cancel.load(std::memory_order_relaxed))
+        return;
+
+    BoxSearchState<Box> state(grid);
+    if (!state.Consistent())
+        return;
+
+    if (depth < search.options.split_depth)
+    {
+        SUDOKU_TRACE_SCOPE("search/branch");
+
+        for (;;)
+        {
+            auto cell = state.ChooseCell();
+            if (cell == state.Cells) // full grid
+            {
+                search.Report(state, weight);
+                return;
+            }
+
+            auto cand = state.Candidates(cell);
+            if (cand == 0)
+                return;
+
+            if (PopCount(cand) == 1) // forced, no need for a new task
+            {
+                auto bit = static_cast<Mask>(cand);
+                state.Place(cell, static_cast<std::size_t>(LowestBit(bit) + 1));
+                free = static_cast<Mask>(free & ~bit);
+                continue;
+            }
+
+            auto spawn = [&](int bit, std::uint64_t w, Mask f) {
+                auto child = state.Grid();
+                child[cell / state.Side][cell % state.Side] = static_cast<std::size_t>(bit + 1);
+                search.tasks_total.fetch_add(1);
+                search.pool.Submit([&search, child, depth, w, f]{
+                    SearchTask(search, child, depth + 1, w, f);
+                });
+            };
+
+            for (auto other = static_cast<Mask>(cand & ~free); other != 0; other &= other - 1)
+                spawn(LowestBit(other), weight, free);
+
+            if (free != 0)
+                spawn(LowestBit(free), weight * static_cast<std::uint64_t>(PopCount(free)),
+                      static_cast<Mask>(free & (free - 1)));
+            return;
+        }
+    }
+
+    SUDOKU_TRACE_SCOPE("search/subtree");
+
+    auto budget = search.MakeBudget();
+
+    if (free != 0)
+    {
+        auto count = CountSymmetric(state, free, budget);
+        if (count != 0 && !budget.Stopped())
+            search.Report(state, weight * count);
+        search.Finish(budget);
+        return;
+    }
+
+    state.SetBudget(budget);
+    while (state.Next())
+        if (!search.Report(state, weight))
+            break;
+
+    search.Finish(state.GetBudget());
+}
+
+} // End of namespace detail
+
+
+/* Solves grid, a Puzzle_t or any BoxGrid, on every worker of pool at
+   once. The first worker to find a solution raises the cancel flag and
+   the others stop at their next check point. max_nodes in options is
+   shared by all workers. It only waits for its own tasks, so several
+   searches can share a pool */
+template <std::size_t Side>
+BasicSolveResult<std::array<std::array<std::size_t, Side>, Side>>
+SolveParallel(const std::array<std::array<std::size_t, Side>, Side>& grid,
+              ThreadPool& pool,
+              const SolveOptions& options = SolveOptions{},
+              ParallelOptions parallel = {})
+{
+    constexpr auto Box = BoxWidth(Side);
+    using Mask = typename BoxGeometry<Box>::Mask;
+
+    detail::ParallelSearch<Box> search(pool, parallel, options, 1);
+    search.tasks_total = 1;
+    pool.Submit([&search, grid]{ detail::SearchTask<Box>(search, grid, 0, 1, Mask{0}); });
+    search.Wait();
+
+    BasicSolveResult<BoxGrid<Box>> result;
+    result.grid = search.solution.value_or(grid);
+    result.status = search.solution ? SolveStatus::Solved : search.Failure();
+    result.nodes = detail::ParallelSearch<Box>::Sum(search.nodes);
+
+    return result;
+}
+
+/* Counts the solutions of grid, a Puzzle_t or any BoxGrid, in parallel,
+   stopping once options.limit solutions were seen. Every worker keeps
+   its own counter, they are only summed for progress reports and after
+   the search finished */
+template <std::size_t Side>
+CountResult CountSolutionsParallel(const std::array<std::array<std::size_t, Side>, Side>& grid,
+                                   ThreadPool& pool,
+                                   const CountOptions& options = {})
+{
+    constexpr auto Box = BoxWidth(Side);
+    using Mask = typename BoxGeometry<Box>::Mask;
+
+    detail::ParallelSearch<Box> search(pool, options.parallel, options.budget, options.limit);
+
+    // Symmetry makes a single subtree count for many solutions, which
+    // would overshoot a limit, so it is only used for exhaustive counts
+    Mask free = 0;
+    if (options.use_symmetry && options.limit == 0)
+    {
+        free = BoxGeometry<Box>::AllDigits;
+        for (const auto& row : grid)
+            for (auto num : row)
+                if (num >= 1 && num <= Side)
+                    free = static_cast<Mask>(free & ~(1u << (num - 1)));
+    }
+
+    search.tasks_total = 1;
+    pool.Submit([&search, grid, free]{ detail::SearchTask<Box>(search, grid, 0, 1, free); });
+
+    if (options.progress)
+    {
+        while (!search.WaitFor(options.progress_interval))
+            options.progress(CountProgress{search.Total(), search.tasks_done.load(),
+                                           search.tasks_total.load()});
+    }
+    else
+    {
+        search.Wait();
+    }
+
+    CountResult result;
+    result.solutions = search.Total();
+    if (options.limit != 0 && result.solutions >= options.limit)
+        result.solutions = options.limit;
+    else if (search.stop_reason.load() >= 0)
+        result.status = search.Failure();
+
+    return result;
+}
+
+
+} // End of namespace Sudoku
+
+#endif // PARALLEL_HPP
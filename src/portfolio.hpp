@@ -0,0 +1,93 @@
+#ifndef PORTFOLIO_HPP
+#define PORTFOLIO_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "my_types.h"
+#include "budget.hpp"
+#include "engines.hpp"
+
+
+namespace Sudoku {
+
+struct PortfolioOptions
+{
+    std::vector<Engine> engines{Engine::MRV, Engine::DLX, Engine::RandomMRV};
+
+    /* Number of threads racing. 0 runs one thread per engine; threads
+       beyond the engine list run RandomMRV with different seeds */
+    std::size_t threads = 0;
+
+    std::uint64_t seed = 0; // 0 picks one from random_device
+
+    /* Limits applied to every engine separately */
+    SolveOptions budget;
+};
+
+struct PortfolioResult : SolveResult
+{
+    Engine winner = Engine::MRV; // engine that finished first, else the first engine
+};
+
+/* Races several engines on the same puzzle and returns the answer of
+   the first one to solve it or prove it unsolvable. The others are
+   cancelled and joined before returning. An engine running out of its
+   budget only drops out of the race: when every engine stops without
+   an answer the result is the first engine's, BudgetExceeded or
+   Cancelled */
+inline PortfolioResult SolvePortfolio(const Puzzle_t& grid, const PortfolioOptions& options = {})
+{
+    auto engines = options.engines.empty() ? std::vector<Engine>{Engine::MRV} : options.engines;
+    auto threads = options.threads == 0 ? engines.size() : options.threads;
+
+    std::uint64_t seed = options.seed;
+    if (seed == 0)
+        seed = std::random_device{}();
+
+    std::atomic<bool> done{false};
+    PortfolioResult result;
+    SolveResult first; // the answer of engine 0 if nobody wins
+
+    auto run = [&](std::size_t k) {
+        auto engine = k < engines.size() ? engines[k] : Engine::RandomMRV;
+        auto r = detail::RunEngine(engine, grid, Budget{options.budget, &done}, seed + k);
+        if (k == 0)
+            first = r;
+
+        // Losers are stopped through done, which the winner raised first,
+        // so only the first engine to get here with an answer writes the
+        // result
+        bool answer = r.status == SolveStatus::Solved || r.status == SolveStatus::Unsolvable;
+        if (answer && !done.exchange(true))
+        {
+            static_cast<SolveResult&>(result) = r;
+            result.winner = engine;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (std::size_t k = 1; k < threads; ++k)
+        pool.emplace_back(run, k);
+
+    run(0);
+
+    for (auto& t : pool)
+        t.join();
+
+    if (!done.load())
+    {
+        static_cast<SolveResult&>(result) = first;
+        result.winner = engines.front();
+    }
+    return result;
+}
+
+
+} // End of namespace Sudoku
+
+#endif // PORTFOLIO_HPP
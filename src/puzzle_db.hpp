@@ -0,0 +1,581 @@
+#ifndef PUZZLE_DB_HPP
+#define PUZZLE_DB_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include "my_types.h"
+
+
+namespace Sudoku {
+
+/* Puzzle database: a large corpus in a compact file that can be mapped
+   and read in place, puzzle i in constant time.
+
+   Layout, all integers little endian:
+
+       0   "SDKD"                      magic
+       4   u8  version (2)
+       5   u8  fields (DbField bits)
+       6   u16 records per block
+       8   u64 record count
+       16  u64 offset of the block index
+       24  u64 reserved, 0
+       32  records, block after block
+       ..  block index: u64 offset of each block, plus the end
+
+   A record starts with a u8 clue count n, then comes a bit stream,
+   least significant bit first:
+     - the clue positions as their rank among the C(81, n) sets of n
+       cells, in as many bits as the largest rank needs (57 for 17
+       clues), in the combinatorial number system: the sum over the
+       positions p1 < p2 < ... of C(pk, k)
+     - the clue digits in reading order, base 9 in groups of up to 20
+       (9^20 < 2^64), each group in the bits its largest value needs
+     - with DbField::Solution the digits of the empty cells, three per
+       10 bits (d0 + 10 d1 + 100 d2), 0 where unknown
+   The stream is padded to a byte, then come a u8 rating in tenths
+   (DbField::Rating) and a u64 canonical hash (DbField::Hash).
+
+   A 17 clue puzzle takes 15 bytes and a 25 clue puzzle 20, against 82
+   as a text line. The size of a record follows from its first byte, so
+   the index points at every block and puzzle i is found by skipping at
+   most block size - 1 records */
+namespace DbFormat {
+
+constexpr std::size_t HeaderSize = 32;
+constexpr std::uint8_t Version = 2;
+constexpr std::size_t DefaultBlockRecords = 32;
+
+} // End of namespace DbFormat
+
+namespace DbField {
+
+constexpr unsigned Solution = 1;
+constexpr unsigned Rating = 2;
+constexpr unsigned Hash = 4;
+constexpr unsigned All = Solution | Rating | Hash;
+
+} // End of namespace DbField
+
+struct DbRecord
+{
+    Puzzle_t puzzle{};
+    Puzzle_t solution{}; // with DbField::Solution; 0 in cells not known
+    double rating = 0.0; // with DbField::Rating, see Grade::rating
+    std::uint64_t hash = 0; // with DbField::Hash, HashGrid of the canonical grid
+};
+
+namespace detail {
+
+inline std::uint64_t Load64(const unsigned char* p) noexcept
+{
+    std::uint64_t value = 0;
+    for (std::size_t k = 0; k < 8; ++k)
+        value |= static_cast<std::uint64_t>(p[k]) << (8 * k);
+    return value;
+}
+
+inline void Store64(unsigned char* p, std::uint64_t value) noexcept
+{
+    for (std::size_t k = 0; k < 8; ++k)
+        p[k] = static_cast<unsigned char>(value >> (8 * k));
+}
+
+/* An unsigned of 128 bits, enough for C(81, 40) ~ 2^77, kept in two
+   words as standard C++ has no wider integer */
+struct DbWide
+{
+    std::uint64_t high = 0;
+    std::uint64_t low = 0;
+
+    DbWide& operator+=(const DbWide& other) noexcept
+    {
+        auto sum = low + other.low;
+        high += other.high + (sum < low);
+        low = sum;
+        return *this;
+    }
+
+    DbWide& operator-=(const DbWide& other) noexcept
+    {
+        high -= other.high + (low < other.low);
+        low -= other.low;
+        return *this;
+    }
+
+    bool operator<=(const DbWide& other) const noexcept
+    {
+        return high != other.high ? high < other.high : low <= other.low;
+    }
+
+    /* Bits of the largest value below this one */
+    std::size_t BitsBelow() const noexcept
+    {
+        auto max = *this;
+        max -= DbWide{0, 1};
+        std::size_t bits = 0;
+        for (auto word = max.high; word != 0; word >>= 1)
+            ++bits;
+        if (bits != 0)
+            return bits + 64;
+        for (auto word = max.low; word != 0; word >>= 1)
+            ++bits;
+        return bits;
+    }
+};
+
+/* The binomials C(p, k) for p, k <= 81, and the rank bits of each clue
+   count, built on first use */
+struct DbBinomials
+{
+    std::array<std::array<DbWide, 82>, 82> choose;
+    std::array<std::size_t, 82> rank_bits;
+
+    DbBinomials() noexcept
+    {
+        for (std::size_t p = 0; p < 82; ++p)
+        {
+            choose[p][0] = DbWide{0, 1};
+            for (std::size_t k = 1; k < 82; ++k)
+            {
+                choose[p][k] = p == 0 ? DbWide{} : choose[p - 1][k - 1];
+                if (p != 0)
+                    choose[p][k] += choose[p - 1][k];
+            }
+        }
+        for (std::size_t n = 0; n < 82; ++n)
+            rank_bits[n] = choose[81][n].BitsBelow();
+    }
+
+    static const DbBinomials& Get() noexcept
+    {
+        static const DbBinomials table;
+        return table;
+    }
+};
+
+/* Base 9 digits per group, and the bits of a group of k digits */
+constexpr std::size_t DbDigitGroup = 20;
+
+constexpr std::size_t DbDigitBits(std::size_t k) noexcept
+{
+    std::uint64_t max = 1;
+    for (std::size_t j = 0; j < k; ++j)
+        max *= 9;
+    std::size_t bits = 0;
+    for (--max; max != 0; max >>= 1)
+        ++bits;
+    return bits;
+}
+
+/* Bytes of a record with clues clues */
+inline std::size_t DbRecordSize(std::size_t clues, unsigned fields) noexcept
+{
+    std::size_t bits = DbBinomials::Get().rank_bits[clues] +
+                       clues / DbDigitGroup * DbDigitBits(DbDigitGroup) + DbDigitBits(clues % DbDigitGroup);
+    if (fields & DbField::Solution)
+        bits += 10 * ((81 - clues + 2) / 3);
+
+    return 1 + (bits + 7) / 8 + (fields & DbField::Rating ? 1 : 0) + (fields & DbField::Hash ? 8 : 0);
+}
+
+/* Bit stream over a record buffer, least significant bit first, at
+   most 16 bits at a time below Wide(). Reads may touch the two bytes
+   past the end of the record: the index, or the next record, is always
+   there */
+class DbBits
+{
+public:
+    explicit DbBits(unsigned char* buffer) noexcept : out{buffer}, in{buffer} {}
+    explicit DbBits(const unsigned char* buffer) noexcept : in{buffer} {}
+
+    void Put(unsigned value, std::size_t bits) noexcept
+    {
+        auto p = out + pos / 8;
+        value <<= pos % 8;
+        p[0] = static_cast<unsigned char>(p[0] | value);
+        if (pos % 8 + bits > 8)
+            p[1] = static_cast<unsigned char>(p[1] | value >> 8);
+        if (pos % 8 + bits > 16)
+            p[2] = static_cast<unsigned char>(p[2] | value >> 16);
+        pos += bits;
+    }
+
+    unsigned Get(std::size_t bits) noexcept
+    {
+        auto p = in + pos / 8;
+        auto window = static_cast<unsigned>(p[0]) | static_cast<unsigned>(p[1]) << 8 |
+                      static_cast<unsigned>(p[2]) << 16;
+        auto value = (window >> (pos % 8)) & ((1u << bits) - 1);
+        pos += bits;
+        return value;
+    }
+
+    /* Up to 64 bits, 16 at a time */
+    void PutWide(std::uint64_t value, std::size_t bits) noexcept
+    {
+        for (; bits > 16; bits -= 16, value >>= 16)
+            Put(static_cast<unsigned>(value & 0xFFFF), 16);
+        Put(static_cast<unsigned>(value), bits);
+    }
+
+    std::uint64_t GetWide(std::size_t bits) noexcept
+    {
+        std::uint64_t value = 0;
+        std::size_t shift = 0;
+        for (; bits > 16; bits -= 16, shift += 16)
+            value |= static_cast<std::uint64_t>(Get(16)) << shift;
+        return value | static_cast<std::uint64_t>(Get(bits)) << shift;
+    }
+
+    /* The rank of a set of clue positions, in the bits of its count */
+    void PutRank(const DbWide& rank, std::size_t bits) noexcept
+    {
+        PutWide(rank.low, std::min<std::size_t>(bits, 64));
+        if (bits > 64)
+            PutWide(rank.high, bits - 64);
+    }
+
+    DbWide GetRank(std::size_t bits) noexcept
+    {
+        DbWide rank;
+        rank.low = GetWide(std::min<std::size_t>(bits, 64));
+        if (bits > 64)
+            rank.high = GetWide(bits - 64);
+        return rank;
+    }
+
+    /* Clue digits 1-9, base 9 in groups of DbDigitGroup */
+    void PutClues(const std::uint8_t* digits, std::size_t count) noexcept
+    {
+        for (std::size_t k = 0; k < count; k += DbDigitGroup)
+        {
+            auto group = std::min(DbDigitGroup, count - k);
+            std::uint64_t value = 0;
+            for (std::size_t j = group; j-- > 0;)
+                value = value * 9 + (digits[k + j] - 1u);
+            PutWide(value, DbDigitBits(group));
+        }
+    }
+
+    void GetClues(std::uint8_t* digits, std::size_t count) noexcept
+    {
+        for (std::size_t k = 0; k < count; k += DbDigitGroup)
+        {
+            auto group = std::min(DbDigitGroup, count - k);
+            auto value = GetWide(DbDigitBits(group));
+            for (std::size_t j = 0; j < group; ++j, value /= 9)
+                digits[k + j] = static_cast<std::uint8_t>(value % 9 + 1);
+        }
+    }
+
+    /* Digits 0-9 three per 10 bits; a short last group is padded with 0 */
+    void PutDigits(const std::uint8_t* digits, std::size_t count) noexcept
+    {
+        for (std::size_t k = 0; k < count; k += 3)
+        {
+            unsigned group = digits[k];
+            if (k + 1 < count)
+                group += 10u * digits[k + 1];
+            if (k + 2 < count)
+                group += 100u * digits[k + 2];
+            Put(group, 10);
+        }
+    }
+
+    void GetDigits(std::uint8_t* digits, std::size_t count) noexcept
+    {
+        for (std::size_t k = 0; k < count; k += 3)
+        {
+            auto group = Get(10);
+            for (std::size_t j = 0; j < 3 && k + j < count; ++j, group /= 10)
+                digits[k + j] = static_cast<std::uint8_t>(group % 10);
+        }
+    }
+
+    std::size_t Bytes() const noexcept {return (pos + 7) / 8;}
+
+private:
+    unsigned char* out = nullptr;
+    const unsigned char* in;
+    std::size_t pos = 0;
+};
+
+} // End of namespace detail
+
+/* Encodes record at out and returns its size. out must hold
+   DbWriter::MaxRecordSize zeroed bytes */
+inline std::size_t EncodeDbRecord(const DbRecord& record, unsigned fields, unsigned char* out) noexcept
+{
+    const auto& binomials = detail::DbBinomials::Get();
+    std::array<std::uint8_t, 81> clues, rest;
+    std::size_t nclues = 0, nrest = 0;
+    detail::DbWide rank;
+
+    for (std::size_t cell = 0; cell < 81; ++cell)
+    {
+        auto num = record.puzzle[cell / 9][cell % 9];
+        if (num != 0)
+        {
+            clues[nclues++] = static_cast<std::uint8_t>(num);
+            rank += binomials.choose[cell][nclues];
+        }
+        else
+            rest[nrest++] = static_cast<std::uint8_t>(record.solution[cell / 9][cell % 9]);
+    }
+
+    out[0] = static_cast<unsigned char>(nclues);
+    detail::DbBits bits(out + 1);
+    bits.PutRank(rank, binomials.rank_bits[nclues]);
+    bits.PutClues(clues.data(), nclues);
+    if (fields & DbField::Solution)
+        bits.PutDigits(rest.data(), nrest);
+
+    auto size = 1 + bits.Bytes();
+    if (fields & DbField::Rating)
+        out[size++] = static_cast<unsigned char>(std::lround(std::min(record.rating, 25.5) * 10));
+    if (fields & DbField::Hash)
+    {
+        detail::Store64(out + size, record.hash);
+        size += 8;
+    }
+    return size;
+}
+
+/* Inverse of EncodeDbRecord; fields the database lacks stay default.
+   The clue count in[0] must be at most 81 */
+inline DbRecord DecodeDbRecord(const unsigned char* in, unsigned fields) noexcept
+{
+    const auto& binomials = detail::DbBinomials::Get();
+    DbRecord record;
+    std::size_t nclues = in[0];
+    detail::DbBits bits(in + 1);
+
+    // Greedy unranking, from the last cell down: cell is a clue when
+    // C(cell, clues left) still fits in what is left of the rank
+    auto rank = bits.GetRank(binomials.rank_bits[nclues]);
+    std::array<std::uint8_t, 81> given{};
+    for (std::size_t cell = 81, left = nclues; cell-- > 0 && left != 0;)
+        if (binomials.choose[cell][left] <= rank)
+        {
+            rank -= binomials.choose[cell][left];
+            given[cell] = 1;
+            --left;
+        }
+
+    // One past the end, read and dropped by the branch free loop below
+    std::array<std::uint8_t, 82> clues{}, rest{};
+    bits.GetClues(clues.data(), nclues);
+    if (fields & DbField::Solution)
+        bits.GetDigits(rest.data(), 81 - nclues);
+
+    // Clue positions are random: selects rather than branches
+    bool solution = fields & DbField::Solution;
+    for (std::size_t cell = 0, c = 0, r = 0; cell < 81; ++cell)
+    {
+        std::size_t clue_here = given[cell];
+        auto clue = clues[c];
+        record.puzzle[cell / 9][cell % 9] = clue_here ? clue : 0;
+        if (solution)
+            record.solution[cell / 9][cell % 9] = clue_here ? clue : rest[r];
+        c += clue_here;
+        r += 1 - clue_here;
+    }
+
+    auto size = 1 + bits.Bytes();
+    if (fields & DbField::Rating)
+        record.rating = in[size++] / 10.0;
+    if (fields & DbField::Hash)
+        record.hash = detail::Load64(in + size);
+
+    return record;
+}
+
+/* Writes a database to a seekable stream: the header is patched in by
+   Finish() once the count and the index are known */
+class DbWriter
+{
+public:
+    static constexpr std::size_t MaxRecordSize = 64;
+
+    DbWriter(std::ostream& stream, unsigned fields, std::size_t block_records = DbFormat::DefaultBlockRecords)
+        : out{stream}, flags{fields & DbField::All},
+          block{block_records == 0 ? 1 : std::min<std::size_t>(block_records, 0xFFFF)}
+    {
+        std::array<char, DbFormat::HeaderSize> zeros{};
+        out.write(zeros.data(), zeros.size());
+        offset = DbFormat::HeaderSize;
+    }
+
+    void Add(const DbRecord& record)
+    {
+        if (count % block == 0)
+            index.push_back(offset);
+
+        std::array<unsigned char, MaxRecordSize> buffer{};
+        auto size = EncodeDbRecord(record, flags, buffer.data());
+        out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(size));
+
+        offset += size;
+        ++count;
+    }
+
+    std::uint64_t Count() const noexcept {return count;}
+
+    /* Bytes written so far; the file size once finished */
+    std::uint64_t Bytes() const noexcept {return offset + 8 * index.size();}
+
+    /* Writes the index and the header. Returns false if the stream
+       failed at any point */
+    bool Finish()
+    {
+        index.push_back(offset);
+        for (auto at : index)
+        {
+            unsigned char bytes[8];
+            detail::Store64(bytes, at);
+            out.write(reinterpret_cast<const char*>(bytes), 8);
+        }
+
+        std::array<unsigned char, DbFormat::HeaderSize> header{};
+        header[0] = 'S';
+        header[1] = 'D';
+        header[2] = 'K';
+        header[3] = 'D';
+        header[4] = DbFormat::Version;
+        header[5] = static_cast<unsigned char>(flags);
+        header[6] = static_cast<unsigned char>(block);
+        header[7] = static_cast<unsigned char>(block >> 8);
+        detail::Store64(&header[8], count);
+        detail::Store64(&header[16], offset);
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(header.data()), header.size());
+        out.flush();
+        return static_cast<bool>(out);
+    }
+
+private:
+    std::ostream& out;
+    unsigned flags;
+    std::size_t block;
+    std::uint64_t count = 0;
+    std::uint64_t offset = 0;
+    std::vector<std::uint64_t> index;
+};
+
+/* Read only view of a database held in memory, usually a MappedFile.
+   Records are decoded straight from the bytes, which must outlive the
+   view */
+class PuzzleDb
+{
+public:
+    /* Checks the header and the index. Returns an empty optional if
+       data is not a database this version understands */
+    static std::optional<PuzzleDb> FromBytes(const unsigned char* data, std::size_t size) noexcept
+    {
+        if (data == nullptr || size < DbFormat::HeaderSize ||
+            data[0] != 'S' || data[1] != 'D' || data[2] != 'K' || data[3] != 'D' ||
+            data[4] != DbFormat::Version || (data[5] & ~DbField::All) != 0)
+            return {};
+
+        PuzzleDb db;
+        db.data = data;
+        db.flags = data[5];
+        db.block = static_cast<std::size_t>(data[6]) | static_cast<std::size_t>(data[7]) << 8;
+        db.count = detail::Load64(data + 8);
+        auto index = detail::Load64(data + 16);
+
+        if (db.block == 0)
+            return {};
+
+        // The index holds blocks + 1 offsets. Compared without the + 1,
+        // which a forged count such as 2^64 - 1 would wrap around
+        auto blocks = db.count / db.block + (db.count % db.block != 0);
+        if (index < DbFormat::HeaderSize || index > size || blocks >= (size - index) / 8)
+            return {};
+
+        db.index = data + index;
+        for (std::size_t b = 0; b <= blocks; ++b)
+        {
+            auto at = detail::Load64(db.index + 8 * b);
+            auto prev = b == 0 ? DbFormat::HeaderSize : detail::Load64(db.index + 8 * (b - 1));
+            if (at < prev || at > index)
+                return {};
+        }
+        db.end = index;
+
+        return db;
+    }
+
+    std::size_t Size() const noexcept {return static_cast<std::size_t>(count);}
+    unsigned Fields() const noexcept {return flags;}
+    std::size_t BlockRecords() const noexcept {return block;}
+
+    /* Record i, or nothing if i is out of range or its block is cut
+       short */
+    std::optional<DbRecord> Get(std::size_t i) const noexcept
+    {
+        if (i >= count)
+            return {};
+
+        auto b = i / block;
+        auto at = detail::Load64(index + 8 * b);
+        auto limit = detail::Load64(index + 8 * (b + 1));
+
+        for (std::size_t k = b * block; ; ++k)
+        {
+            if (at == limit || data[at] > 81)
+                return {};
+
+            auto size = detail::DbRecordSize(data[at], flags);
+            if (limit - at < size)
+                return {};
+            if (k == i)
+                return DecodeDbRecord(data + at, flags);
+            at += size;
+        }
+    }
+
+    /* Calls f(i, record) for every record in order, without the index.
+       Stops early if the data is cut short */
+    template <typename F>
+    void ForEach(F&& f) const
+    {
+        std::uint64_t at = DbFormat::HeaderSize;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (at == end || data[at] > 81)
+                return;
+
+            auto size = detail::DbRecordSize(data[at], flags);
+            if (end - at < size)
+                return;
+
+            f(i, DecodeDbRecord(data + at, flags));
+            at += size;
+        }
+    }
+
+private:
+    PuzzleDb() = default;
+
+    const unsigned char* data = nullptr;
+    const unsigned char* index = nullptr;
+    std::uint64_t count = 0;
+    std::uint64_t end = 0;
+    std::size_t block = 1;
+    unsigned flags = 0;
+};
+
+
+} // End of namespace Sudoku
+
+#endif // PUZZLE_DB_HPP
@@ -0,0 +1,461 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+#include "my_types.h"
+#include "budget.hpp"
+#include "stats.hpp"
+
+
+namespace Sudoku {
+
+/* Bitmask helpers. Digit d (1..9) is stored at bit d-1 */
+using Mask_t = std::uint16_t;
+
+constexpr Mask_t AllDigits = 0x1FF;
+
+inline int PopCount(unsigned v) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(v);
+#else
+    int n = 0;
+    for (; v != 0; v &= v - 1)
+        ++n;
+    return n;
+#endif
+}
+
+inline int LowestBit(unsigned v) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(v);
+#else
+    int n = 0;
+    while ((v & 1u) == 0) { v >>= 1; ++n; }
+    return n;
+#endif
+}
+
+constexpr std::size_t BoxOf(std::size_t row, std::size_t col) noexcept
+{
+    return (row / 3) * 3 + col / 3;
+}
+
+/* Box width of a grid with side rows, 0 if side is not a square */
+constexpr std::size_t BoxWidth(std::size_t side) noexcept
+{
+    for (std::size_t box = 1; box * box <= side; ++box)
+        if (box * box == side)
+            return box;
+    return 0;
+}
+
+/* Digit masks of a grid of boxes Box cells wide, one bit per digit */
+template <std::size_t Box>
+struct BoxGeometry
+{
+    static_assert(Box >= 2 && Box <= 5, "digit masks hold up to 25 digits");
+
+    static constexpr std::size_t Side = Box * Box;
+    static constexpr std::size_t Cells = Side * Side;
+
+    using Mask = std::conditional_t<Side <= 16, std::uint16_t, std::uint32_t>;
+    static constexpr Mask AllDigits = static_cast<Mask>((std::uint32_t{1} << Side) - 1);
+
+    static constexpr std::size_t BoxOf(std::size_t row, std::size_t col) noexcept
+    {
+        return (row / Box) * Box + col / Box;
+    }
+};
+
+
+/* Iterative backtracking state over a single grid.
+
+   Instead of recursing like SolveSudoku, the search keeps an explicit
+   stack of frames (cell, candidates still to try). This lets the search
+   be suspended after a solution and resumed later with Next(), and lets
+   callers (the parallel solver, the enumerators) place and remove digits
+   by hand while splitting the tree.
+
+   Cells are chosen by the minimum remaining values heuristic and row,
+   column and box usage are kept as bitmasks, so every step is O(cells)
+   at worst instead of the repeated scans done by isSafe.
+
+   Box sets the size of the grid (see BoxGrid), 3 for the usual 9x9;
+   16x16 and 25x25 grids run the same search on wider masks.
+
+   Stats is one of the policies in stats.hpp; SearchState (NoStats)
+   carries no statistics code at all. */
+template <typename Stats = NoStats, std::size_t Box = 3>
+class BasicSearchState
+{
+public:
+    using Geometry = BoxGeometry<Box>;
+    using Mask = typename Geometry::Mask;
+
+    static constexpr std::size_t Side = Geometry::Side;
+    static constexpr std::size_t Cells = Geometry::Cells; // ChooseCell() of a full grid
+
+    explicit BasicSearchState(const BoxGrid<Box>& grid) noexcept
+    {
+        rows.fill(0);
+        cols.fill(0);
+        boxes.fill(0);
+
+        for (std::size_t row = 0; row < Side; ++row)
+            for (std::size_t col = 0; col < Side; ++col)
+            {
+                auto num = grid[row][col];
+                cells[row * Side + col] = 0;
+
+                if (num == 0)
+                    continue;
+
+                if (num > Side || !CanPlace(row * Side + col, num))
+                    consistent = false;
+                else
+                    Place(row * Side + col, num);
+            }
+    }
+
+    /* False if the givens already break a row, column or box */
+    bool Consistent() const noexcept {return consistent;}
+
+    /* True once Next() gave up because the budget ran out */
+    bool Stopped() const noexcept {return budget.Stopped();}
+
+    /* Status to report when Next() returned false */
+    SolveStatus Failure() const noexcept {return budget.Failure();}
+
+    /* Number of digits tried since construction */
+    std::uint64_t Nodes() const noexcept {return budget.Nodes();}
+
+    /* The statistics policy, holding a SolveStats with CollectStats */
+    const Stats& GetStats() const noexcept {return stats;}
+
+    /* Number of guesses currently on the stack */
+    std::size_t Depth() const noexcept {return depth;}
+
+    /* Limits the search, see Budget */
+    void SetBudget(const Budget& b) noexcept {budget = b;}
+    const Budget& GetBudget() const noexcept {return budget;}
+
+    /* The search stops at the next check point when *flag becomes true */
+    void SetCancelFlag(const std::atomic<bool>* flag) noexcept
+    {
+        SolveOptions options;
+        options.cancel = flag;
+        budget = Budget{options};
+    }
+
+    /* Tries digits in the given order (a permutation of 0..Side-1,
+       standing for digits 1..Side) instead of ascending. Used to
+       diversify searches */
+    void SetValueOrder(const std::array<std::uint8_t, Side>& digits) noexcept
+    {
+        order = digits;
+        shuffled = true;
+    }
+
+    Mask Candidates(std::size_t cell) const noexcept
+    {
+        auto row = cell / Side, col = cell % Side;
+        return static_cast<Mask>(~(rows[row] | cols[col] | boxes[Geometry::BoxOf(row, col)]) &
+                                 Geometry::AllDigits);
+    }
+
+    bool CanPlace(std::size_t cell, std::size_t num) const noexcept
+    {
+        return cells[cell] == 0 && (Candidates(cell) & (1u << (num - 1))) != 0;
+    }
+
+    void Place(std::size_t cell, std::size_t num) noexcept
+    {
+        auto row = cell / Side, col = cell % Side;
+        Mask bit = static_cast<Mask>(1u << (num - 1));
+        cells[cell] = static_cast<std::uint8_t>(num);
+        rows[row] |= bit;
+        cols[col] |= bit;
+        boxes[Geometry::BoxOf(row, col)] |= bit;
+    }
+
+    void Remove(std::size_t cell) noexcept
+    {
+        auto row = cell / Side, col = cell % Side;
+        Mask bit = static_cast<Mask>(~(1u << (cells[cell] - 1)));
+        cells[cell] = 0;
+        rows[row] &= bit;
+        cols[col] &= bit;
+        boxes[Geometry::BoxOf(row, col)] &= bit;
+    }
+
+    /* Returns the empty cell with the fewest candidates, or Cells (81)
+       when the grid is full. A cell with zero candidates is returned
+       immediately since it proves the current branch is dead */
+    std::size_t ChooseCell() const noexcept
+    {
+        std::size_t best = Cells;
+        int best_count = static_cast<int>(Side) + 1;
+
+        for (std::size_t cell = 0; cell < Cells; ++cell)
+        {
+            if (cells[cell] != 0)
+                continue;
+
+            int count = PopCount(Candidates(cell));
+            if (count < best_count)
+            {
+                best = cell;
+                best_count = count;
+                if (count <= 1)
+                    break;
+            }
+        }
+
+        return best;
+    }
+
+    /* Advances the search to the next solution. Returns true with the
+       solution available through Grid(), false once the tree is exhausted
+       or the budget ran out (see Failure). Calling it again after a solution
+       resumes the search where it stopped */
+    bool Next() noexcept
+    {
+        if (!consistent || exhausted || budget.Stopped())
+            return false;
+
+        stats.Start();
+        bool found = Search();
+        stats.Stop();
+
+        return found;
+    }
+
+    /* Copies the current digits into a grid */
+    BoxGrid<Box> Grid() const noexcept
+    {
+        BoxGrid<Box> grid;
+        for (std::size_t row = 0; row < Side; ++row)
+            for (std::size_t col = 0; col < Side; ++col)
+                grid[row][col] = cells[row * Side + col];
+        return grid;
+    }
+
+private:
+    bool Search() noexcept
+    {
+        if (!started)
+        {
+            started = true;
+            if (!Push())
+            {
+                exhausted = true;
+                return true; // the givens already fill the grid
+            }
+        }
+
+        while (depth > 0)
+        {
+            auto& frame = stack[depth - 1];
+
+            if (frame.placed)
+            {
+                Remove(frame.cell);
+                frame.placed = false;
+            }
+
+            if (frame.remaining == 0) // every value failed, backtrack
+            {
+                stats.Backtrack();
+                --depth;
+                continue;
+            }
+
+            if (budget.Tick())
+                return false;
+
+            stats.Node();
+            if (frame.forced)
+                stats.NakedSingle();
+            else
+                stats.Guess();
+
+            auto bit = LowestBit(frame.remaining);
+            if (shuffled)
+                for (auto d : order)
+                    if (frame.remaining & (1u << d))
+                    {
+                        bit = d;
+                        break;
+                    }
+
+            frame.remaining = static_cast<Mask>(frame.remaining & ~(1u << bit));
+            Place(frame.cell, static_cast<std::size_t>(bit + 1));
+            frame.placed = true;
+
+            if (!Push())
+                return true; // full grid, keep the stack for resuming
+        }
+
+        exhausted = true;
+        return false;
+    }
+
+    /* Picks the next cell and pushes a frame for it.
+       Returns false if the grid is already full */
+    bool Push() noexcept
+    {
+        auto cell = ChooseCell();
+        if (cell == Cells)
+            return false;
+
+        auto cand = Candidates(cell);
+        stack[depth++] = Frame{static_cast<std::uint16_t>(cell), cand, false, PopCount(cand) == 1};
+        stats.Depth(depth);
+        return true;
+    }
+
+    struct Frame
+    {
+        std::uint16_t cell;
+        Mask remaining;
+        bool placed;
+        bool forced; // only one candidate when pushed
+    };
+
+    std::array<std::uint8_t, Cells> cells;
+    std::array<Mask, Side> rows;
+    std::array<Mask, Side> cols;
+    std::array<Mask, Side> boxes;
+    std::array<Frame, Cells> stack;
+    std::size_t depth = 0;
+    Budget budget;
+    Stats stats;
+    std::array<std::uint8_t, Side> order{};
+    bool shuffled = false;
+    bool consistent = true;
+    bool started = false;
+    bool exhausted = false;
+};
+
+using SearchState = BasicSearchState<NoStats>;
+
+/* The search over 16x16 (Box 4) or 25x25 (Box 5) grids */
+template <std::size_t Box>
+using BoxSearchState = BasicSearchState<NoStats, Box>;
+
+
+/* Lazy range over the solutions of a grid.
+
+   The search only runs when the iterator is advanced and stays
+   suspended in between, so a caller that stops after the first k
+   solutions pays only for those k:
+
+       for (const auto& solution : Sudoku::Solutions(grid))
+           ...
+
+   The range is single pass, like an input stream. */
+class SolutionRange
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Puzzle_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Puzzle_t*;
+        using reference = const Puzzle_t&;
+
+        iterator() = default;
+
+        reference operator*() const noexcept {return range->current;}
+        pointer operator->() const noexcept {return &range->current;}
+
+        iterator& operator++() noexcept
+        {
+            if (!range->Advance())
+                range = nullptr;
+            return *this;
+        }
+
+        void operator++(int) noexcept {++*this;}
+
+        bool operator==(const iterator& other) const noexcept {return range == other.range;}
+        bool operator!=(const iterator& other) const noexcept {return range != other.range;}
+
+    private:
+        friend class SolutionRange;
+        explicit iterator(SolutionRange* r) noexcept : range{r} {}
+
+        SolutionRange* range = nullptr;
+    };
+
+    explicit SolutionRange(const Puzzle_t& grid)
+        : state{std::make_unique<SearchState>(grid)} {}
+
+    /* Runs the search up to the first solution not yet seen */
+    iterator begin() noexcept
+    {
+        if (!primed)
+        {
+            primed = true;
+            has_value = Advance();
+        }
+        return has_value ? iterator{this} : iterator{};
+    }
+
+    iterator end() noexcept {return {};}
+
+    /* The underlying search, e.g. for its node count */
+    const SearchState& State() const noexcept {return *state;}
+
+private:
+    bool Advance() noexcept
+    {
+        has_value = state->Next();
+        if (has_value)
+            current = state->Grid();
+        return has_value;
+    }
+
+    std::unique_ptr<SearchState> state; // big, keep the range cheap to move
+    Puzzle_t current{};
+    bool primed = false;
+    bool has_value = false;
+};
+
+/* Returns a lazy range over every solution of grid */
+inline SolutionRange Solutions(const Puzzle_t& grid)
+{
+    return SolutionRange{grid};
+}
+
+/* Counts the solutions of grid, of any BoxGrid size, stopping after
+   limit solutions (limit 0 counts them all) */
+template <std::size_t Side>
+std::uint64_t CountSolutions(const std::array<std::array<std::size_t, Side>, Side>& grid,
+                             std::uint64_t limit = 0) noexcept
+{
+    BoxSearchState<BoxWidth(Side)> state(grid);
+    std::uint64_t count = 0;
+
+    while (state.Next())
+        if (++count == limit)
+            break;
+
+    return count;
+}
+
+
+} // End of namespace Sudoku
+
+#endif // SEARCH_HPP
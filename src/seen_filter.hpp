@@ -0,0 +1,210 @@
+#ifndef SEEN_FILTER_HPP
+#define SEEN_FILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "my_types.h"
+#include "canonical.hpp"
+#include "mapped_file.hpp"
+
+
+namespace Sudoku {
+
+/* Persistent set of the puzzles already handed out, by canonical hash,
+   so that no variant of them comes back.
+
+   A blocked Bloom filter: a hash picks one 64 byte block and sets
+   Probes bits inside it, so a lookup touches a single cache line. At
+   the default 4 MiB it holds 3 million puzzles at about 1% false
+   positives; a false positive only makes the caller draw again.
+
+   The file is a writable MappedFile, so inserts reach the disk without
+   any save step (where mmap is missing it is read whole and written
+   back on destruction). A file with a bad header is started over: losing the
+   set only allows repeats. Not thread safe.
+
+       0   "SDKS"        magic
+       4   u8  version (1)
+       5   u8  probes
+       6   u16 reserved, 0
+       8   u64 puzzles inserted
+       16  u64 blocks (a power of two)
+       24  reserved up to HeaderSize, 0
+       64  blocks */
+class SeenFilter
+{
+public:
+    static constexpr std::size_t HeaderSize = 64;
+    static constexpr std::size_t BlockBytes = 64;
+    static constexpr std::size_t DefaultBlocks = std::size_t{1} << 16;
+    static constexpr unsigned Probes = 7;  // 9 bits each out of one 64 bit mix
+    static constexpr std::uint8_t Version = 1;
+
+    SeenFilter() = default;
+
+    /* Opens the filter at path, creating it with blocks blocks (rounded
+       up to a power of two) if it does not exist or is not a filter */
+    explicit SeenFilter(const std::string& path, std::size_t blocks = DefaultBlocks)
+    {
+        std::size_t count = 1;
+        while (count < blocks)
+            count <<= 1;
+
+        file = MappedFile::Writable(path);
+        if (!file.IsOpen())
+            return;
+
+        if ((file.Size() < HeaderSize || !ValidHeader(file.Data(), file.Size())) &&
+            !file.Reset(HeaderSize + count * BlockBytes))
+            return;
+
+        bytes = file.MutableData();
+        if (std::memcmp(bytes, "SDKS", 4) != 0)
+        {
+            std::memcpy(bytes, "SDKS", 4);
+            bytes[4] = Version;
+            bytes[5] = Probes;
+            Store64(16, count);
+        }
+        mask = Load64(16) - 1;
+    }
+
+    SeenFilter(const SeenFilter&) = delete;
+    SeenFilter& operator=(const SeenFilter&) = delete;
+
+    SeenFilter(SeenFilter&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    SeenFilter& operator=(SeenFilter&& other) noexcept
+    {
+        if (this != &other)
+        {
+            file = std::move(other.file);
+            bytes = std::exchange(other.bytes, nullptr);
+            mask = std::exchange(other.mask, 0);
+        }
+        return *this;
+    }
+
+    bool IsOpen() const noexcept {return bytes != nullptr;}
+
+    /* Puzzles inserted so far (insertions of a hash already present do
+       not count) */
+    std::uint64_t Size() const noexcept {return IsOpen() ? Load64(8) : 0;}
+
+    /* True if hash was inserted, or, rarely, collides with hashes that
+       were. Always false when the filter is not open */
+    bool Contains(std::uint64_t hash) const noexcept
+    {
+        if (!IsOpen())
+            return false;
+
+        auto block = Block(hash);
+        auto probes = Mix(hash);
+        for (unsigned k = 0; k < Probes; ++k, probes >>= 9)
+        {
+            auto bit = probes & 511;
+            if ((block[bit / 8] & (1u << (bit % 8))) == 0)
+                return false;
+        }
+        return true;
+    }
+
+    void Insert(std::uint64_t hash) noexcept
+    {
+        if (!IsOpen())
+            return;
+
+        auto block = Block(hash);
+        auto probes = Mix(hash);
+        bool added = false;
+        for (unsigned k = 0; k < Probes; ++k, probes >>= 9)
+        {
+            auto bit = probes & 511;
+            added = added || (block[bit / 8] & (1u << (bit % 8))) == 0;
+            block[bit / 8] = static_cast<unsigned char>(block[bit / 8] | (1u << (bit % 8)));
+        }
+
+        if (added)
+            Store64(8, Load64(8) + 1);
+    }
+
+    bool Contains(const Puzzle_t& puzzle) const {return Contains(CanonicalHash(puzzle));}
+    void Insert(const Puzzle_t& puzzle) {Insert(CanonicalHash(puzzle));}
+
+private:
+    static bool ValidHeader(const unsigned char* header, std::size_t size) noexcept
+    {
+        std::uint64_t blocks = 0;
+        for (std::size_t k = 0; k < 8; ++k)
+            blocks |= static_cast<std::uint64_t>(header[16 + k]) << (8 * k);
+
+        return std::memcmp(header, "SDKS", 4) == 0 && header[4] == Version && header[5] == Probes &&
+               blocks != 0 && (blocks & (blocks - 1)) == 0 &&
+               (size - HeaderSize) / BlockBytes == blocks && (size - HeaderSize) % BlockBytes == 0;
+    }
+
+    /* splitmix64 finalizer: the block comes from the low bits of hash,
+       the probes from all of its bits mixed */
+    static std::uint64_t Mix(std::uint64_t x) noexcept
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    unsigned char* Block(std::uint64_t hash) const noexcept
+    {
+        return bytes + HeaderSize + (hash & mask) * BlockBytes;
+    }
+
+    std::uint64_t Load64(std::size_t at) const noexcept
+    {
+        std::uint64_t value = 0;
+        for (std::size_t k = 0; k < 8; ++k)
+            value |= static_cast<std::uint64_t>(bytes[at + k]) << (8 * k);
+        return value;
+    }
+
+    void Store64(std::size_t at, std::uint64_t value) noexcept
+    {
+        for (std::size_t k = 0; k < 8; ++k)
+            bytes[at + k] = static_cast<unsigned char>(value >> (8 * k));
+    }
+
+    MappedFile file;
+    unsigned char* bytes = nullptr;  // file.MutableData()
+    std::uint64_t mask = 0;          // blocks - 1
+};
+
+/* Calls draw() up to tries times until it returns a puzzle seen has not
+   seen, which is then marked seen. Empty if every draw was seen */
+template <typename Draw>
+std::optional<Puzzle_t> DrawUnseen(SeenFilter& seen, Draw&& draw, std::size_t tries)
+{
+    for (std::size_t k = 0; k < tries; ++k)
+    {
+        auto puzzle = draw();
+        auto hash = CanonicalHash(puzzle);
+        if (!seen.Contains(hash))
+        {
+            seen.Insert(hash);
+            return puzzle;
+        }
+    }
+    return {};
+}
+
+
+} // End of namespace Sudoku
+
+#endif // SEEN_FILTER_HPP
@@ -0,0 +1,376 @@
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS)
+#define SUDOKU_HAVE_MEMFD_SEALS 1
+#endif
+
+#include "my_types.h"
+#include "book.hpp"
+#include "budget.hpp"
+#include "futex.hpp"
+#include "socket.hpp"
+
+
+namespace Sudoku {
+
+/* Shared memory ring between sudokud and a client on the same host, so
+   that batches of puzzles cross without going through a socket.
+
+   The client creates the ring (an anonymous memfd) and passes its
+   descriptor to the daemon over the daemon's socket. Then both map it:
+
+       0    "SDKR", u32 version, u32 slots, u32 slot bytes
+       64   head: puzzles submitted, written by the client
+       128  tail: puzzles answered, written by the daemon
+       192  slots
+
+   Head and tail only grow (modulo 2^32) and puzzle n lives in slot
+   n % slots. The client fills the slots from head on, as long as head
+   stays less than slots ahead of tail, then publishes the new head.
+   The daemon solves them and writes each answer over its own puzzle, in
+   place, then publishes the tail once every slot before it is done, so
+   answers come back in submission order. Each counter sits on its own
+   cache line, with a count of sleepers next to it: a side only makes
+   the futex wake call when the other is asleep.
+
+   A slot holds the grid as a book record (41 bytes, book.hpp), then the
+   SolveStatus, the search nodes and the solve time.
+
+   The memfd is sealed against shrinking and growing before it is sent,
+   and the daemon refuses any descriptor without F_SEAL_SHRINK: a client
+   cutting the file short under the daemon's mapping would kill it with
+   SIGBUS. Where memfd seals do not exist there is no ring */
+namespace ShmFormat {
+
+constexpr std::uint32_t Version = 1;
+constexpr std::size_t HeaderSize = 64;
+constexpr std::size_t CounterSize = 64;
+constexpr std::size_t SlotsOffset = HeaderSize + 2 * CounterSize;
+constexpr std::size_t SlotBytes = 64;
+constexpr std::uint32_t MaxSlots = 1u << 16;
+constexpr std::uint32_t DefaultSlots = 1024;
+
+/* The request that hands a ring to sudokud, sent with its descriptor */
+constexpr std::string_view Request = "shm";
+
+} // End of namespace ShmFormat
+
+struct ShmCounter
+{
+    std::atomic<std::uint32_t> value{0};
+    std::atomic<std::uint32_t> sleepers{0};
+};
+
+struct ShmSlot
+{
+    unsigned char grid[BookFormat::RecordSize];
+    std::uint8_t status;
+    std::uint8_t reserved[6];
+    std::uint64_t nodes;
+    std::uint32_t micros;
+    std::uint32_t reserved2;
+};
+
+static_assert(sizeof(ShmSlot) == ShmFormat::SlotBytes, "a slot is one cache line");
+static_assert(sizeof(ShmCounter) <= ShmFormat::CounterSize, "a counter fits its cache line");
+
+/* One mapping of a ring, on either side */
+class ShmRing
+{
+public:
+    ShmRing() = default;
+
+    /* A new ring of slots slots (a power of two up to MaxSlots), empty
+       if the system refuses or cannot seal it */
+    static ShmRing Create(std::uint32_t slots)
+    {
+        ShmRing ring;
+        if (slots == 0 || slots > ShmFormat::MaxSlots || (slots & (slots - 1)) != 0)
+            return ring;
+
+#if defined(SUDOKU_HAVE_MEMFD_SEALS)
+        Socket fd{::memfd_create("sudoku-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING)};
+        auto size = ShmFormat::SlotsOffset + std::size_t{slots} * ShmFormat::SlotBytes;
+        if (!fd.IsOpen() || ::ftruncate(fd.Fd(), static_cast<off_t>(size)) != 0 ||
+            ::fcntl(fd.Fd(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0 ||
+            !ring.Map(std::move(fd), size))
+            return ShmRing{};
+#else
+        // shm_open objects cannot be sealed, and the daemon would refuse them
+        return ring;
+#endif
+
+        std::memcpy(ring.bytes, "SDKR", 4);
+        ring.Store32(4, ShmFormat::Version);
+        ring.Store32(8, slots);
+        ring.Store32(12, ShmFormat::SlotBytes);
+        new (ring.bytes + ShmFormat::HeaderSize) ShmCounter{};
+        new (ring.bytes + ShmFormat::HeaderSize + ShmFormat::CounterSize) ShmCounter{};
+        ring.mask = slots - 1;
+        return ring;
+    }
+
+    /* Maps the ring a client passed, empty if it is not one or if the
+       client could still shrink it */
+    static ShmRing Attach(Socket fd)
+    {
+        ShmRing ring;
+#if defined(SUDOKU_HAVE_MEMFD_SEALS)
+        auto seals = fd.IsOpen() ? ::fcntl(fd.Fd(), F_GET_SEALS) : -1;
+        if (seals < 0 || (seals & F_SEAL_SHRINK) == 0)
+            return ring;
+#else
+        return ring;
+#endif
+
+        struct stat st;
+        if (!fd.IsOpen() || ::fstat(fd.Fd(), &st) != 0 ||
+            static_cast<std::size_t>(st.st_size) < ShmFormat::SlotsOffset ||
+            !ring.Map(std::move(fd), static_cast<std::size_t>(st.st_size)))
+            return ShmRing{};
+
+        auto slots = ring.Load32(8);
+        if (std::memcmp(ring.bytes, "SDKR", 4) != 0 || ring.Load32(4) != ShmFormat::Version ||
+            ring.Load32(12) != ShmFormat::SlotBytes ||
+            slots == 0 || slots > ShmFormat::MaxSlots || (slots & (slots - 1)) != 0 ||
+            ring.length != ShmFormat::SlotsOffset + std::size_t{slots} * ShmFormat::SlotBytes)
+            return ShmRing{};
+
+        ring.mask = slots - 1;
+        return ring;
+    }
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    ShmRing(ShmRing&& other) noexcept
+        : fd{std::move(other.fd)}, bytes{std::exchange(other.bytes, nullptr)},
+          length{std::exchange(other.length, 0)}, mask{std::exchange(other.mask, 0)} {}
+
+    ShmRing& operator=(ShmRing&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Unmap();
+            fd = std::move(other.fd);
+            bytes = std::exchange(other.bytes, nullptr);
+            length = std::exchange(other.length, 0);
+            mask = std::exchange(other.mask, 0);
+        }
+        return *this;
+    }
+
+    ~ShmRing()
+    {
+        Unmap();
+    }
+
+    bool IsOpen() const noexcept {return bytes != nullptr;}
+    int Fd() const noexcept {return fd.Fd();}
+    std::uint32_t Slots() const noexcept {return mask + 1;}
+
+    ShmCounter& Head() const noexcept
+    {
+        return *std::launder(reinterpret_cast<ShmCounter*>(bytes + ShmFormat::HeaderSize));
+    }
+
+    ShmCounter& Tail() const noexcept
+    {
+        return *std::launder(reinterpret_cast<ShmCounter*>(bytes + ShmFormat::HeaderSize + ShmFormat::CounterSize));
+    }
+
+    /* Slot of puzzle number n */
+    ShmSlot& Slot(std::uint32_t n) const noexcept
+    {
+        return reinterpret_cast<ShmSlot*>(bytes + ShmFormat::SlotsOffset)[n & mask];
+    }
+
+    /* Makes value visible to the other side and wakes it if it sleeps */
+    static void Publish(ShmCounter& counter, std::uint32_t value) noexcept
+    {
+        counter.value.store(value);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (counter.sleepers.load() != 0)
+            FutexWake(counter.value);
+    }
+
+    /* Current value of counter, after sleeping up to timeout if it
+       still is seen */
+    static std::uint32_t Wait(ShmCounter& counter, std::uint32_t seen, std::chrono::nanoseconds timeout) noexcept
+    {
+        auto value = counter.value.load(std::memory_order_acquire);
+        if (value != seen)
+            return value;
+
+        // Pairs with the fence in Publish(): either the publisher sees
+        // this sleeper, or the futex sees the new value
+        counter.sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        FutexWait(counter.value, seen, timeout);
+        counter.sleepers.fetch_sub(1);
+        return counter.value.load(std::memory_order_acquire);
+    }
+
+private:
+    bool Map(Socket descriptor, std::size_t size)
+    {
+        void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor.Fd(), 0);
+        if (addr == MAP_FAILED)
+            return false;
+
+        fd = std::move(descriptor);
+        bytes = static_cast<unsigned char*>(addr);
+        length = size;
+        return true;
+    }
+
+    void Unmap() noexcept
+    {
+        if (bytes != nullptr)
+            ::munmap(bytes, length);
+        bytes = nullptr;
+        length = 0;
+        mask = 0;
+    }
+
+    std::uint32_t Load32(std::size_t at) const noexcept
+    {
+        std::uint32_t value;
+        std::memcpy(&value, bytes + at, 4);
+        return value;
+    }
+
+    void Store32(std::size_t at, std::uint32_t value) noexcept
+    {
+        std::memcpy(bytes + at, &value, 4);
+    }
+
+    Socket fd;                     // kept open to pass it on
+    unsigned char* bytes = nullptr;
+    std::size_t length = 0;
+    std::uint32_t mask = 0;        // slots - 1
+};
+
+struct ShmResult
+{
+    Puzzle_t grid{};  // the solution if solved, the puzzle otherwise
+    SolveStatus status = SolveStatus::Unsolvable;
+    std::uint64_t nodes = 0;
+    std::uint32_t micros = 0;
+
+    bool Solved() const noexcept {return status == SolveStatus::Solved;}
+};
+
+/* Client side of a ring: keeps up to Slots() puzzles in flight with the
+   daemon listening at a socket path. Submit() as many puzzles as there
+   are free slots, Collect() the answers as they come, in order */
+class ShmClient
+{
+public:
+    /* Connects to sudokud at path and hands it a new ring; empty if the
+       daemon cannot be reached or refuses it */
+    static std::optional<ShmClient> Connect(const std::string& path,
+                                            std::uint32_t slots = ShmFormat::DefaultSlots)
+    {
+        ShmClient client;
+        client.conn = ConnectUnix(path);
+        client.ring = ShmRing::Create(slots);
+        if (!client.conn.IsOpen() || !client.ring.IsOpen() ||
+            !SendDescriptor(client.conn.Fd(), client.ring.Fd(), std::string(ShmFormat::Request) + "\n"))
+            return {};
+
+        LineReader reader(client.conn.Fd());
+        std::string line;
+        if (!reader.Next(line) || line.compare(0, 6, "shm ok") != 0)
+            return {};
+        return client;
+    }
+
+    std::uint32_t Slots() const noexcept {return ring.Slots();}
+    std::uint32_t InFlight() const noexcept {return submitted - collected;}
+
+    /* Copies puzzles into the free slots, as many as fit, and wakes the
+       daemon. Returns how many went in */
+    std::size_t Submit(const Puzzle_t* puzzles, std::size_t count) noexcept
+    {
+        auto room = std::min<std::size_t>(count, ring.Slots() - InFlight());
+        for (std::size_t k = 0; k < room; ++k)
+            PackGrid(puzzles[k], ring.Slot(submitted + static_cast<std::uint32_t>(k)).grid);
+
+        if (room != 0)
+        {
+            submitted += static_cast<std::uint32_t>(room);
+            ShmRing::Publish(ring.Head(), submitted);
+        }
+        return room;
+    }
+
+    /* Waits for at least one answer if any puzzle is in flight, then
+       calls f(const ShmResult&) for every answer in, in submission
+       order. False if the daemon went away */
+    template <typename F>
+    bool Collect(F&& f)
+    {
+        if (InFlight() == 0)
+            return true;
+
+        auto tail = ShmRing::Wait(ring.Tail(), collected, std::chrono::milliseconds(100));
+        while (tail == collected)
+        {
+            if (!DaemonAlive())
+                return false;
+            tail = ShmRing::Wait(ring.Tail(), collected, std::chrono::milliseconds(100));
+        }
+
+        for (; collected != tail; ++collected)
+        {
+            const auto& slot = ring.Slot(collected);
+            ShmResult result;
+            result.grid = UnpackGrid(slot.grid);
+            result.status = static_cast<SolveStatus>(slot.status);
+            result.nodes = slot.nodes;
+            result.micros = slot.micros;
+            f(result);
+        }
+        return true;
+    }
+
+private:
+    ShmClient() = default;
+
+    /* The daemon only ever closes the socket, it sends nothing more */
+    bool DaemonAlive() const noexcept
+    {
+        pollfd pfd{conn.Fd(), POLLIN, 0};
+        return ::poll(&pfd, 1, 0) == 0;
+    }
+
+    Socket conn;
+    ShmRing ring;
+    std::uint32_t submitted = 0;
+    std::uint32_t collected = 0;
+};
+
+
+} // End of namespace Sudoku
+
+#endif // SHM_RING_HPP
@@ -0,0 +1,296 @@
+#ifndef SOCKET_HPP
+#define SOCKET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace Sudoku {
+
+/* Owning descriptor, closed on destruction: a socket, or a file passed
+   over one (SendDescriptor). The servers and clients built on it
+   (sudokud, sudoku_client, sudoku_httpd) are POSIX only */
+class Socket
+{
+public:
+    Socket() = default;
+    explicit Socket(int descriptor) noexcept : fd{descriptor} {}
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    Socket(Socket&& other) noexcept : fd{std::exchange(other.fd, -1)} {}
+
+    Socket& operator=(Socket&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+            fd = std::exchange(other.fd, -1);
+        }
+        return *this;
+    }
+
+    ~Socket()
+    {
+        Close();
+    }
+
+    bool IsOpen() const noexcept {return fd >= 0;}
+    int Fd() const noexcept {return fd;}
+
+    void Close() noexcept
+    {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+
+private:
+    int fd = -1;
+};
+
+namespace detail {
+
+inline bool UnixAddress(const std::string& path, sockaddr_un& addr) noexcept
+{
+    std::memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof addr.sun_path)
+        return false;
+
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+} // End of namespace detail
+
+/* Connects to the stream socket at path. Not open on failure, errno
+   tells why */
+inline Socket ConnectUnix(const std::string& path)
+{
+    sockaddr_un addr;
+    if (!detail::UnixAddress(path, addr))
+    {
+        errno = ENAMETOOLONG;
+        return Socket{};
+    }
+
+    Socket s{::socket(AF_UNIX, SOCK_STREAM, 0)};
+    if (s.IsOpen() && ::connect(s.Fd(), reinterpret_cast<const sockaddr*>(&addr), sizeof addr) != 0)
+        s.Close();
+    return s;
+}
+
+/* Listens on a stream socket at path, readable and writable by the
+   owner only. A socket file left behind by a server that is gone is
+   replaced; one that still accepts connections is not (EADDRINUSE) */
+inline Socket ListenUnix(const std::string& path, int backlog = 128)
+{
+    sockaddr_un addr;
+    if (!detail::UnixAddress(path, addr))
+    {
+        errno = ENAMETOOLONG;
+        return Socket{};
+    }
+
+    if (ConnectUnix(path).IsOpen())
+    {
+        errno = EADDRINUSE;
+        return Socket{};
+    }
+    ::unlink(path.c_str());
+
+    Socket s{::socket(AF_UNIX, SOCK_STREAM, 0)};
+    if (!s.IsOpen())
+        return s;
+
+    if (::bind(s.Fd(), reinterpret_cast<const sockaddr*>(&addr), sizeof addr) != 0 ||
+        ::chmod(path.c_str(), 0600) != 0 ||
+        ::listen(s.Fd(), backlog) != 0)
+        s.Close();
+    return s;
+}
+
+/* Listens on a TCP port of the IPv4 address host, the loopback
+   interface unless told otherwise. Port 0 picks a free port, see
+   LocalPort */
+inline Socket ListenTcp(std::uint16_t port, const std::string& host = "127.0.0.1", int backlog = 128)
+{
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+    {
+        errno = EINVAL;
+        return Socket{};
+    }
+
+    Socket s{::socket(AF_INET, SOCK_STREAM, 0)};
+    if (!s.IsOpen())
+        return s;
+
+    int on = 1;
+    if (::setsockopt(s.Fd(), SOL_SOCKET, SO_REUSEADDR, &on, sizeof on) != 0 ||
+        ::bind(s.Fd(), reinterpret_cast<const sockaddr*>(&addr), sizeof addr) != 0 ||
+        ::listen(s.Fd(), backlog) != 0)
+        s.Close();
+    return s;
+}
+
+/* Port a TCP socket is bound to, 0 if it is not */
+inline std::uint16_t LocalPort(const Socket& s) noexcept
+{
+    sockaddr_in addr;
+    socklen_t size = sizeof addr;
+    if (::getsockname(s.Fd(), reinterpret_cast<sockaddr*>(&addr), &size) != 0 || addr.sin_family != AF_INET)
+        return 0;
+    return ntohs(addr.sin_port);
+}
+
+/* Writes all of data, retrying short writes. False once the peer is
+   gone; never raises SIGPIPE */
+inline bool SendAll(int fd, std::string_view data) noexcept
+{
+    while (!data.empty())
+    {
+        auto sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        data.remove_prefix(static_cast<std::size_t>(sent));
+    }
+    return true;
+}
+
+/* Sends data on a Unix socket along with a copy of the descriptor
+   passed (SCM_RIGHTS), which arrives with the first byte of data */
+inline bool SendDescriptor(int fd, int passed, std::string_view data) noexcept
+{
+    if (data.empty())
+        return false;
+
+    iovec iov{const_cast<char*>(data.data()), data.size()};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    std::memset(control, 0, sizeof control);
+
+    msghdr msg;
+    std::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &passed, sizeof(int));
+
+    ssize_t sent;
+    while ((sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+        ;
+    if (sent <= 0)
+        return false;
+    return SendAll(fd, data.substr(static_cast<std::size_t>(sent)));
+}
+
+/* Splits what comes in on a socket into lines, read 64 KiB at a time.
+   The newline is dropped, and so is a CR before it. A descriptor sent
+   along (SendDescriptor) is kept until TakeDescriptor() */
+class LineReader
+{
+public:
+    explicit LineReader(int descriptor) : fd{descriptor}, buffer(1 << 16) {}
+
+    /* The last descriptor received, not open if none came */
+    Socket TakeDescriptor() noexcept {return std::move(received);}
+
+    /* The next line, false at the end of the stream or on an error. A
+       last line without a newline still counts */
+    bool Next(std::string& line)
+    {
+        line.clear();
+        for (;;)
+        {
+            auto end = static_cast<const char*>(std::memchr(buffer.data() + pos, '\n', size - pos));
+            if (end != nullptr)
+            {
+                auto length = static_cast<std::size_t>(end - (buffer.data() + pos));
+                line.append(buffer.data() + pos, length);
+                pos += length + 1;
+                break;
+            }
+
+            line.append(buffer.data() + pos, size - pos);
+            pos = size = 0;
+
+            auto got = Receive();
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+            {
+                if (line.empty())
+                    return false;
+                break;
+            }
+            size = static_cast<std::size_t>(got);
+        }
+
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        return true;
+    }
+
+private:
+    ssize_t Receive() noexcept
+    {
+        iovec iov{buffer.data(), buffer.size()};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+        msghdr msg;
+        std::memset(&msg, 0, sizeof msg);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+
+        auto got = ::recvmsg(fd, &msg, 0);
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); got >= 0 && cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+                cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+            {
+                int passed;
+                std::memcpy(&passed, CMSG_DATA(cmsg), sizeof(int));
+                received = Socket{passed};
+            }
+        return got;
+    }
+
+    int fd;
+    Socket received;
+    std::vector<char> buffer;
+    std::size_t pos = 0;
+    std::size_t size = 0;
+};
+
+
+} // End of namespace Sudoku
+
+#endif // SOCKET_HPP
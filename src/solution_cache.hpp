@@ -0,0 +1,214 @@
+#ifndef SOLUTION_CACHE_HPP
+#define SOLUTION_CACHE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "my_types.h"
+#include "book.hpp"
+#include "budget.hpp"
+#include "canonical.hpp"
+#include "engines.hpp"
+#include "search.hpp"
+#include "stats.hpp"
+
+
+namespace Sudoku {
+
+struct CacheCounters
+{
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t inserts = 0;
+    std::uint64_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;   // estimated, see SolutionCache::EntryBytes
+};
+
+/* Solutions of puzzles already seen, shared by every worker.
+
+   Entries are keyed by the canonical form (see canonical.hpp), so a
+   puzzle hits on any relabeled, permuted or transposed copy of one
+   solved before. An entry holds the canonical puzzle, to rule out hash
+   collisions, and the solution of the canonical puzzle; the caller's
+   own CanonicalForm carries the transform that maps it back.
+
+   The key hash picks one of several shards, each with its own lock and
+   its own LRU list, so workers rarely wait on each other. Every shard
+   gets an equal part of max_bytes and evicts its least recently used
+   entries past that. Only final outcomes are stored: Solved and
+   Unsolvable, never a result cut short by a budget. SolveCached() also
+   keeps out the puzzles with several solutions, since which one a
+   search finds depends on the engine, the seed and the copy of the
+   puzzle it ran on: a hit would answer with whichever came first */
+class SolutionCache
+{
+    struct Entry
+    {
+        std::uint64_t hash;
+        std::array<unsigned char, BookFormat::RecordSize> puzzle;
+        std::array<unsigned char, BookFormat::RecordSize> solution;
+        SolveStatus status;
+    };
+
+    using LruList = std::list<Entry>;
+
+public:
+    /* Approximate heap footprint of one entry: the list node, the map
+       node and its bucket */
+    static constexpr std::size_t EntryBytes =
+        sizeof(Entry) + 2 * sizeof(void*) +
+        sizeof(std::uint64_t) + sizeof(LruList::iterator) + 2 * sizeof(void*) + sizeof(void*);
+
+    explicit SolutionCache(std::size_t max_bytes, std::size_t shards = 16)
+        : nshards{shards == 0 ? 1 : shards},
+          shard_entries{std::max<std::size_t>(1, max_bytes / nshards / EntryBytes)},
+          table{new Shard[nshards]}
+    {
+    }
+
+    /* The cached result for the puzzle form was computed from, mapped
+       back onto that puzzle */
+    std::optional<SolveResult> Find(const CanonicalForm& form)
+    {
+        auto hash = HashGrid(form.grid);
+        std::array<unsigned char, BookFormat::RecordSize> puzzle;
+        PackGrid(form.grid, puzzle.data());
+
+        auto& shard = ShardOf(hash);
+        std::lock_guard<std::mutex> lk(shard.mutex);
+
+        auto it = shard.index.find(hash);
+        if (it == shard.index.end() || it->second->puzzle != puzzle)
+        {
+            ++shard.counters.misses;
+            return {};
+        }
+
+        ++shard.counters.hits;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+
+        SolveResult result;
+        result.status = it->second->status;
+        result.grid = form.transform.Inverse().Apply(UnpackGrid(it->second->solution.data()));
+        return result;
+    }
+
+    /* Stores result, solved from the puzzle form was computed from */
+    void Insert(const CanonicalForm& form, const SolveResult& result)
+    {
+        if (result.status != SolveStatus::Solved && result.status != SolveStatus::Unsolvable)
+            return;
+
+        Entry entry;
+        entry.hash = HashGrid(form.grid);
+        entry.status = result.status;
+        PackGrid(form.grid, entry.puzzle.data());
+        PackGrid(form.transform.Apply(result.grid), entry.solution.data());
+
+        auto& shard = ShardOf(entry.hash);
+        std::lock_guard<std::mutex> lk(shard.mutex);
+
+        if (shard.index.count(entry.hash) != 0)
+            return; // another worker got there first, or a collision
+
+        shard.lru.push_front(entry);
+        shard.index.emplace(entry.hash, shard.lru.begin());
+        ++shard.counters.inserts;
+
+        while (shard.lru.size() > shard_entries)
+        {
+            shard.index.erase(shard.lru.back().hash);
+            shard.lru.pop_back();
+            ++shard.counters.evictions;
+        }
+    }
+
+    /* Sum over the shards */
+    CacheCounters Counters() const
+    {
+        CacheCounters total;
+        for (std::size_t s = 0; s < nshards; ++s)
+        {
+            std::lock_guard<std::mutex> lk(table[s].mutex);
+            const auto& c = table[s].counters;
+            total.hits += c.hits;
+            total.misses += c.misses;
+            total.inserts += c.inserts;
+            total.evictions += c.evictions;
+            total.entries += table[s].lru.size();
+        }
+        total.bytes = total.entries * EntryBytes;
+        return total;
+    }
+
+private:
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        LruList lru; // most recently used first
+        std::unordered_map<std::uint64_t, LruList::iterator> index;
+        CacheCounters counters;
+    };
+
+    Shard& ShardOf(std::uint64_t hash) noexcept
+    {
+        return table[(hash >> 32) % nshards];
+    }
+
+    std::size_t nshards;
+    std::size_t shard_entries; // per shard
+    std::unique_ptr<Shard[]> table;
+};
+
+namespace detail {
+
+/* Whether grid, which has a solution, has no other, within the limits
+   of options. A check cut short counts as not unique */
+inline bool UniqueSolution(const Puzzle_t& grid, const SolveOptions& options)
+{
+    SearchState state(grid);
+    state.SetBudget(Budget{options});
+    return state.Next() && !state.Next() && !state.Stopped();
+}
+
+} // End of namespace detail
+
+/* SolveWith behind a cache: a puzzle equivalent to one solved before
+   costs a canonicalization and a lookup, and comes back with 0 nodes
+   and no stats. Without a cache this is SolveWith.
+
+   A miss that solves the puzzle pays for a second search proving the
+   solution unique before it is stored, so that the answer, with or
+   without a cache, stays the one SolveWith gives for this grid and
+   seed */
+inline SolveResult SolveCached(SolutionCache* cache, Engine engine, const Puzzle_t& grid,
+                               const SolveOptions& options = SolveOptions{},
+                               std::uint64_t seed = 0,
+                               SolveStats* stats = nullptr)
+{
+    if (cache == nullptr)
+        return SolveWith(engine, grid, options, seed, stats);
+
+    auto form = Canonicalize(grid);
+    if (auto hit = cache->Find(form))
+        return *hit;
+
+    auto result = SolveWith(engine, grid, options, seed, stats);
+    if (result.status == SolveStatus::Unsolvable ||
+        (result.status == SolveStatus::Solved && detail::UniqueSolution(grid, options)))
+        cache->Insert(form, result);
+    return result;
+}
+
+
+} // End of namespace Sudoku
+
+#endif // SOLUTION_CACHE_HPP
@@ -3,9 +3,11 @@
 
 #include <array>
 #include <optional>
-#include <random>
 
 #include "my_types.h"
+#include "budget.hpp"
+#include "generator.hpp"
+#include "stats.hpp"
 
 
 namespace Sudoku {
@@ -15,7 +17,7 @@ using namespace std;
 /* Searches the grid to find an entry that is still unassigned. If
    found, a Coordinate is returned. Otherwise, an empty optional
    is returned */
-optional<Coordinate> FindUnassignedLocation(const Puzzle_t& grid) noexcept
+inline optional<Coordinate> FindUnassignedLocation(const Puzzle_t& grid) noexcept
 {
     for (size_t row = 0; row < grid.size(); ++row)
         for (size_t col = 0; col < grid[row].size(); ++col)
@@ -28,9 +30,9 @@ optional<Coordinate> FindUnassignedLocation(const Puzzle_t& grid) noexcept
 /* Searches the row to find an entry that is the same as num.
    If found, a Coordinate is returned.
    Otherwise, an empty optional is returned */
-optional<Coordinate> UsedInRow(const Puzzle_t& grid,
-                               Row row,
-                               std::size_t num) noexcept
+inline optional<Coordinate> UsedInRow(const Puzzle_t& grid,
+                                      Row row,
+                                      std::size_t num) noexcept
 {
     for (size_t col = 0; col < grid[row.get()].size(); ++col)
         if (grid[row.get()][col] == num)
@@ -42,9 +44,9 @@ optional<Coordinate> UsedInRow(const Puzzle_t& grid,
 /* Searches the col to find an entry that is the same as num.
    If found, a Coordinate is returned.
    Otherwise, an empty optional is returned */
-optional<Coordinate> UsedInCol(const Puzzle_t& grid,
-                               Col col,
-                               std::size_t num) noexcept
+inline optional<Coordinate> UsedInCol(const Puzzle_t& grid,
+                                      Col col,
+                                      std::size_t num) noexcept
 {
     for (size_t row = 0; row < grid.size(); ++row)
         if (grid[row][col.get()] == num)
@@ -56,10 +58,10 @@ optional<Coordinate> UsedInCol(const Puzzle_t& grid,
 /* Searches the 3x3 box to find an entry that is the same as num.
    If found, a Coordinate is returned.
    Otherwise, an empty optional is returned */
-optional<Coordinate> UsedInBox(const Puzzle_t& grid,
-                               Row boxStartRow,
-                               Col boxStartCol,
-                               std::size_t num) noexcept
+inline optional<Coordinate> UsedInBox(const Puzzle_t& grid,
+                                      Row boxStartRow,
+                                      Col boxStartCol,
+                                      std::size_t num) noexcept
 {
     for (size_t row = 0; row < 3; ++row)
         for (size_t col = 0; col < 3; ++col)
@@ -72,10 +74,10 @@ optional<Coordinate> UsedInBox(const Puzzle_t& grid,
 
 /* Returns a boolean which indicates whether it will be legal to assign
    num to the given row,col location. */
-bool isSafe(const Puzzle_t& grid,
-            Row row,
-            Col col,
-            std::size_t num) noexcept
+inline bool isSafe(const Puzzle_t& grid,
+                   Row row,
+                   Col col,
+                   std::size_t num) noexcept
 {
     /* Check if 'num' is not already placed in current row,
        current column and current 3x3 box */
@@ -88,7 +90,7 @@ bool isSafe(const Puzzle_t& grid,
   all unassigned locations in such a way to meet the requirements
   for Sudoku solution (non-duplication across rows, columns, and boxes)
   Returns true if succeded, false otherwise */
-bool SolveSudoku(Puzzle_t& grid)
+inline bool SolveSudoku(Puzzle_t& grid)
 {
     // If there is no unassigned location, we are done
     auto opt = FindUnassignedLocation(grid);
@@ -121,70 +123,92 @@ bool SolveSudoku(Puzzle_t& grid)
 }
 
 
-/* Here it would have been better to use a book of many puzzles
-   sorted by difficulty, but I decided to generate puzzles programatically.
-   The risk is to underestimate the real difficulty */
-Puzzle_t GeneratePuzzle(Difficulty dif)
+/* Same as SolveSudoku above, but every tentative assignment is
+   counted against budget and the search gives up (leaving grid as it
+   was) as soon as the budget runs out. Stats is one of the policies
+   of stats.hpp */
+template <typename Stats>
+bool SolveSudoku(Puzzle_t& grid, Budget& budget, Stats& stats, std::size_t depth = 0)
 {
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<std::size_t> dist(1, 9);
+    auto opt = FindUnassignedLocation(grid);
+
+    if (!opt.has_value())
+        return true;
 
-    Puzzle_t grid;
+    auto row = opt.value().x;
+    auto col = opt.value().y;
+    stats.Depth(depth + 1);
 
-    do
+    for (std::size_t num = 1; num <= 9; ++num)
     {
-        // Fill with zeroes
-        for (auto& row : grid)
-            row.fill(0);
-
-        // Insert 10 random numbers in random positions
-        int i = 0;
-        while (i < 10)
+        if (isSafe(grid, row, col, num))
         {
-            auto x = Row(dist(gen) - 1);
-            auto y = Col(dist(gen) - 1);
-            auto num = dist(gen);
+            if (budget.Tick())
+                return false;
 
-            if (isSafe(grid, x, y, num))
-            {
-                grid[x.get()][y.get()] = num;
-                ++i;
-            }
-        }
+            stats.Node();
+            stats.Guess();
+            grid[row.get()][col.get()] = num;
 
-    }
-    while (!SolveSudoku(grid));
+            if (SolveSudoku(grid, budget, stats, depth + 1))
+                return true;
 
-    // Here we have a totally filled sudoku puzzle.
-    // We will remove some numbers according to the difficulty
-    int remove = 0;
-    switch(dif)
-    {
-        case Difficulty::Easy:
-            remove = 36;
-            break;
-        case Difficulty::Intermediate:
-            remove = 48;
-            break;
-        case Difficulty::Hard:
-            remove = 56;
-            break;
+            grid[row.get()][col.get()] = 0;
+
+            if (budget.Stopped())
+                return false;
+        }
     }
 
-    while (remove > 0)
-    {
-        auto x = dist(gen) - 1;
-        auto y = dist(gen) - 1;
+    stats.Backtrack();
+    return false;
+}
 
-        if (grid[x][y] != 0)
-        {
-            grid[x][y] = 0;
-            --remove;
-        }
+inline bool SolveSudoku(Puzzle_t& grid, Budget& budget)
+{
+    NoStats stats;
+    return SolveSudoku(grid, budget, stats);
+}
+
+/* Solves a copy of grid within the limits of options. The status tells
+   a board without solution apart from one that ran out of budget */
+inline SolveResult SolveSudoku(const Puzzle_t& grid, const SolveOptions& options)
+{
+    Budget budget(options);
+    SolveResult result;
+    result.grid = grid;
+
+    bool solved = SolveSudoku(result.grid, budget);
+    result.status = solved ? SolveStatus::Solved : budget.Failure();
+    result.nodes = budget.Nodes();
+
+    return result;
+}
+
+
+/* Here it would have been better to use a book of many puzzles
+   sorted by difficulty, but I decided to generate puzzles programatically.
+   Clue count alone used to underestimate the real difficulty, so the
+   puzzle is now dug until the logical grader rates it inside the band
+   of dif (see generator.hpp). Each try takes up to a second on two
+   threads, which is enough for one game, and rarely takes more than
+   one; after five misses the hardest puzzle seen is returned, easier
+   than the band */
+inline Puzzle_t GeneratePuzzle(Difficulty dif)
+{
+    GenerateOptions options;
+    options.band = BandFor(dif);
+    options.threads = 2;
+
+    GenerateResult best;
+    for (int tries = 0; tries < 5 && !best.in_band; ++tries)
+    {
+        auto result = GenerateRated(options);
+        if (tries == 0 || result.in_band || result.grade.hardest > best.grade.hardest)
+            best = result;
     }
 
-    return grid;
+    return best.grid;
 }
 
 
@@ -0,0 +1,91 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+namespace Sudoku {
+
+/* Time stamp counter where the CPU has one, steady_clock ns elsewhere */
+inline std::uint64_t ReadCycles() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+/* What an engine did while solving one puzzle */
+struct SolveStats
+{
+    std::uint64_t nodes = 0;          // digits placed, forced or not
+    std::uint64_t guesses = 0;        // digits tried in a cell with a choice
+    std::uint64_t backtracks = 0;     // cells whose every digit failed
+    std::uint64_t max_depth = 0;      // deepest stack of open cells
+    std::uint64_t naked_singles = 0;  // cells with one candidate left
+    std::uint64_t hidden_singles = 0; // digits with one place left in a unit
+    std::uint64_t cycles = 0;         // elapsed, see ReadCycles
+
+    SolveStats& operator+=(const SolveStats& other) noexcept
+    {
+        nodes += other.nodes;
+        guesses += other.guesses;
+        backtracks += other.backtracks;
+        max_depth = std::max(max_depth, other.max_depth);
+        naked_singles += other.naked_singles;
+        hidden_singles += other.hidden_singles;
+        cycles += other.cycles;
+        return *this;
+    }
+};
+
+/* Statistics policies for the engines.
+
+   Engines are templates over one of these and call the hooks from
+   their inner loops. NoStats has empty inline hooks, so the default
+   instantiation compiles to exactly the code without statistics;
+   CollectStats fills a SolveStats */
+struct NoStats
+{
+    static constexpr bool Enabled = false;
+
+    void Start() noexcept {}
+    void Stop() noexcept {}
+    void Node() noexcept {}
+    void Guess() noexcept {}
+    void Backtrack() noexcept {}
+    void Depth(std::size_t) noexcept {}
+    void NakedSingle() noexcept {}
+    void HiddenSingle() noexcept {}
+};
+
+struct CollectStats
+{
+    static constexpr bool Enabled = true;
+
+    SolveStats stats;
+    std::uint64_t started = 0;
+
+    void Start() noexcept {started = ReadCycles();}
+    void Stop() noexcept {stats.cycles += ReadCycles() - started;}
+    void Node() noexcept {++stats.nodes;}
+    void Guess() noexcept {++stats.guesses;}
+    void Backtrack() noexcept {++stats.backtracks;}
+    void Depth(std::size_t d) noexcept {stats.max_depth = std::max<std::uint64_t>(stats.max_depth, d);}
+    void NakedSingle() noexcept {++stats.naked_singles;}
+    void HiddenSingle() noexcept {++stats.hidden_singles;}
+};
+
+
+} // End of namespace Sudoku
+
+#endif // STATS_HPP
@@ -0,0 +1,191 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "trace.hpp"
+
+
+namespace Sudoku {
+
+/* Small work-stealing thread pool.
+
+   Every worker owns a deque. Tasks submitted from inside a worker go to
+   the back of its own deque and are popped LIFO (depth first, good cache
+   reuse), while idle workers steal from the front of the other deques,
+   which holds the oldest and usually biggest subtrees. */
+class ThreadPool
+{
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    explicit ThreadPool(std::size_t threads = 0)
+    {
+        if (threads == 0)
+            threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+
+        for (std::size_t i = 0; i < threads; ++i)
+            workers.push_back(std::make_unique<Worker>());
+
+        for (std::size_t i = 0; i < threads; ++i)
+            workers[i]->thread = std::thread([this, i]{ Run(i); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(sleep_mutex);
+            stop = true;
+        }
+        sleep_cv.notify_all();
+
+        for (auto& w : workers)
+            w->thread.join();
+    }
+
+    std::size_t Size() const noexcept {return workers.size();}
+
+    /* Index of the calling worker in its pool, npos outside of a pool */
+    static std::size_t CurrentWorker() noexcept {return current_index;}
+
+    template <typename F>
+    void Submit(F&& task)
+    {
+        auto index = current_pool == this ? current_index
+                                          : next_queue.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+        pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lk(sleep_mutex);
+            ++queued;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(workers[index]->mutex);
+            workers[index]->tasks.emplace_back(std::forward<F>(task));
+        }
+        sleep_cv.notify_one();
+    }
+
+    /* Blocks until every submitted task (and the tasks they submitted)
+       has finished, whoever submitted them. Must not be called from
+       inside a worker */
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lk(sleep_mutex);
+        done_cv.wait(lk, [this]{ return pending.load() == 0; });
+    }
+
+    /* Same as Wait, but gives up after timeout.
+       Returns true if the pool drained */
+    template <typename Duration>
+    bool WaitFor(Duration timeout)
+    {
+        std::unique_lock<std::mutex> lk(sleep_mutex);
+        return done_cv.wait_for(lk, timeout, [this]{ return pending.load() == 0; });
+    }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::thread thread;
+    };
+
+    bool PopLocal(std::size_t index, std::function<void()>& out)
+    {
+        auto& w = *workers[index];
+        std::lock_guard<std::mutex> lk(w.mutex);
+        if (w.tasks.empty())
+            return false;
+
+        out = std::move(w.tasks.back());
+        w.tasks.pop_back();
+        return true;
+    }
+
+    bool Steal(std::size_t thief, std::function<void()>& out)
+    {
+        for (std::size_t k = 1; k < workers.size(); ++k)
+        {
+            auto& w = *workers[(thief + k) % workers.size()];
+            std::lock_guard<std::mutex> lk(w.mutex);
+            if (w.tasks.empty())
+                continue;
+
+            out = std::move(w.tasks.front());
+            w.tasks.pop_front();
+            return true;
+        }
+
+        return false;
+    }
+
+    void Run(std::size_t index)
+    {
+        current_pool = this;
+        current_index = index;
+        SUDOKU_TRACE_THREAD("pool worker " + std::to_string(index));
+
+        std::function<void()> task;
+
+        for (;;)
+        {
+            if (PopLocal(index, task) || Steal(index, task))
+            {
+                {
+                    std::lock_guard<std::mutex> lk(sleep_mutex);
+                    --queued;
+                }
+
+                task();
+                task = nullptr;
+
+                if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    std::lock_guard<std::mutex> lk(sleep_mutex);
+                    done_cv.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lk(sleep_mutex);
+            sleep_cv.wait(lk, [this]{ return stop || queued > 0; });
+            if (stop && queued == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<std::size_t> pending{0};
+    std::atomic<std::size_t> next_queue{0};
+
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::condition_variable done_cv;
+    std::size_t queued = 0;
+    bool stop = false;
+
+    static inline thread_local ThreadPool* current_pool = nullptr;
+    static inline thread_local std::size_t current_index = npos;
+};
+
+
+} // End of namespace Sudoku
+
+#endif // THREAD_POOL_HPP
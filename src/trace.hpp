@@ -0,0 +1,258 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+/* Event tracing in the Chrome trace format (chrome://tracing, Perfetto).
+
+   Code marks the spans worth seeing with
+
+       SUDOKU_TRACE_SCOPE("generate/fill");
+
+   which records one event from there to the end of the enclosing block.
+   Every thread writes into a ring buffer of its own, so recording takes
+   no lock and costs two clock reads; once the buffer is full the oldest
+   events are overwritten. When a thread exits its buffer goes back to
+   the registry and the next new thread records into it, under the same
+   tid, so memory follows the number of threads alive at once rather than
+   the number ever started. WriteChromeTrace() dumps every buffer as JSON.
+
+   The macros only record anything when the tree is configured with
+   SUDOKU_ENABLE_TRACING (which defines SUDOKU_TRACING); otherwise they
+   expand to nothing and WriteChromeTrace() writes an empty trace */
+
+#ifndef SUDOKU_TRACE_EVENTS
+#define SUDOKU_TRACE_EVENTS 32768 // per thread, a power of two
+#endif
+
+#define SUDOKU_TRACE_CONCAT2(a, b) a##b
+#define SUDOKU_TRACE_CONCAT(a, b) SUDOKU_TRACE_CONCAT2(a, b)
+
+#ifdef SUDOKU_TRACING
+#define SUDOKU_TRACE_SCOPE(name) \
+    ::Sudoku::TraceScope SUDOKU_TRACE_CONCAT(sudoku_trace_scope_, __LINE__){name}
+#define SUDOKU_TRACE_THREAD(name) ::Sudoku::SetTraceThreadName(name)
+#else
+#define SUDOKU_TRACE_SCOPE(name) static_cast<void>(0)
+#define SUDOKU_TRACE_THREAD(name) static_cast<void>(0)
+#endif
+
+
+namespace Sudoku {
+
+#ifdef SUDOKU_TRACING
+constexpr bool TracingEnabled = true;
+#else
+constexpr bool TracingEnabled = false;
+#endif
+
+namespace detail {
+
+/* One finished span. name must outlive the trace (a string literal) */
+struct TraceEvent
+{
+    const char* name;
+    std::uint64_t start_ns;
+    std::uint64_t duration_ns;
+};
+
+static_assert((SUDOKU_TRACE_EVENTS & (SUDOKU_TRACE_EVENTS - 1)) == 0,
+              "SUDOKU_TRACE_EVENTS must be a power of two");
+
+/* Events of one thread. Only the owner writes; written is published
+   with release so a dump sees whole events, as long as the owner is not
+   overwriting them at the same time */
+struct TraceBuffer
+{
+    std::array<TraceEvent, SUDOKU_TRACE_EVENTS> events;
+    std::atomic<std::uint64_t> written{0};
+    std::uint32_t tid = 0;
+    std::string name; // guarded by the registry mutex
+};
+
+/* Every buffer ever created. Buffers outlive their threads so a trace
+   can still be written after the workers were joined; those of exited
+   threads wait in free for a new thread to take them over */
+struct TraceRegistry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::vector<TraceBuffer*> free;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    static TraceRegistry& Instance()
+    {
+        static TraceRegistry registry;
+        return registry;
+    }
+};
+
+inline std::uint64_t TraceNow() noexcept
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - TraceRegistry::Instance().epoch).count());
+}
+
+/* The calling thread's hold on its buffer, handed back when it exits.
+   thread_local objects are destroyed before statics, so the registry is
+   still there */
+struct ThreadTraceSlot
+{
+    TraceBuffer* buffer = nullptr;
+
+    ~ThreadTraceSlot()
+    {
+        if (buffer == nullptr)
+            return;
+
+        auto& registry = TraceRegistry::Instance();
+        std::lock_guard<std::mutex> lk(registry.mutex);
+        registry.free.push_back(buffer);
+    }
+};
+
+inline TraceBuffer& ThreadTraceBuffer()
+{
+    thread_local ThreadTraceSlot slot;
+
+    if (slot.buffer == nullptr)
+    {
+        auto& registry = TraceRegistry::Instance();
+        std::lock_guard<std::mutex> lk(registry.mutex);
+
+        if (registry.free.empty())
+        {
+            registry.buffers.push_back(std::make_unique<TraceBuffer>());
+            slot.buffer = registry.buffers.back().get();
+            slot.buffer->tid = static_cast<std::uint32_t>(registry.buffers.size());
+        }
+        else
+        {
+            slot.buffer = registry.free.back();
+            registry.free.pop_back();
+        }
+
+        slot.buffer->name = "thread " + std::to_string(slot.buffer->tid);
+    }
+
+    return *slot.buffer;
+}
+
+inline void WriteJsonString(std::ostream& out, const std::string& s)
+{
+    out << '"';
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << ' ';
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+/* Chrome wants microseconds; keep the nanoseconds as decimals */
+inline void WriteMicros(std::ostream& out, std::uint64_t ns)
+{
+    auto frac = ns % 1000;
+    out << ns / 1000 << '.' << static_cast<char>('0' + frac / 100)
+        << static_cast<char>('0' + frac / 10 % 10) << static_cast<char>('0' + frac % 10);
+}
+
+} // End of namespace detail
+
+/* Records the span from construction to destruction */
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* n) noexcept : name{n}, start{detail::TraceNow()} {}
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    ~TraceScope()
+    {
+        auto& buffer = detail::ThreadTraceBuffer();
+        auto n = buffer.written.load(std::memory_order_relaxed);
+        buffer.events[n & (SUDOKU_TRACE_EVENTS - 1)] = {name, start, detail::TraceNow() - start};
+        buffer.written.store(n + 1, std::memory_order_release);
+    }
+
+private:
+    const char* name;
+    std::uint64_t start;
+};
+
+/* Names the calling thread in the trace viewer */
+inline void SetTraceThreadName(const std::string& name)
+{
+    auto& buffer = detail::ThreadTraceBuffer();
+    std::lock_guard<std::mutex> lk(detail::TraceRegistry::Instance().mutex);
+    buffer.name = name;
+}
+
+/* Writes every recorded event as a Chrome trace JSON document. Call it
+   while the traced threads are idle, e.g. after joining them */
+inline void WriteChromeTrace(std::ostream& out)
+{
+    auto& registry = detail::TraceRegistry::Instance();
+    std::lock_guard<std::mutex> lk(registry.mutex);
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    const char* sep = "\n";
+
+    for (const auto& buffer : registry.buffers)
+    {
+        out << sep << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":";
+        detail::WriteJsonString(out, buffer->name);
+        out << "}}";
+        sep = ",\n";
+
+        auto written = buffer->written.load(std::memory_order_acquire);
+        auto first = written > SUDOKU_TRACE_EVENTS ? written - SUDOKU_TRACE_EVENTS : 0;
+
+        for (auto n = first; n < written; ++n)
+        {
+            const auto& event = buffer->events[n & (SUDOKU_TRACE_EVENTS - 1)];
+            out << sep << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid << ",\"name\":";
+            detail::WriteJsonString(out, event.name);
+            out << ",\"ts\":";
+            detail::WriteMicros(out, event.start_ns);
+            out << ",\"dur\":";
+            detail::WriteMicros(out, event.duration_ns);
+            out << '}';
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+/* Same as above, into a file. Returns false if it cannot be written */
+inline bool WriteChromeTrace(const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    WriteChromeTrace(out);
+    return static_cast<bool>(out);
+}
+
+
+} // End of namespace Sudoku
+
+#endif // TRACE_HPP
@@ -0,0 +1,134 @@
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+
+#include "my_types.h"
+
+
+namespace Sudoku {
+
+/* A Sudoku symmetry with a digit relabeling.
+
+   Apply() first transposes the grid if transpose is set, then moves
+   rows and columns (row r of the result is row rows[r] of the input,
+   likewise for columns) and finally renames every digit d to
+   digits[d]. Row and column permutations must keep bands and stacks
+   together, as the ones of Random() do; then the result is a valid
+   puzzle with exactly the solutions, and the logical difficulty, of
+   the input, only moved and renamed */
+struct Transform
+{
+    std::array<std::uint8_t, 10> digits; // digits[0] is always 0
+    std::array<std::uint8_t, 9> rows;
+    std::array<std::uint8_t, 9> cols;
+    bool transpose = false;
+
+    static Transform Identity() noexcept
+    {
+        Transform t;
+        std::iota(t.digits.begin(), t.digits.end(), std::uint8_t{0});
+        std::iota(t.rows.begin(), t.rows.end(), std::uint8_t{0});
+        std::iota(t.cols.begin(), t.cols.end(), std::uint8_t{0});
+        return t;
+    }
+
+    /* Uniform over the 9! * 2 * 6^8 transforms: digits, bands, rows
+       within each band, stacks, columns within each stack, transpose */
+    template <typename Gen>
+    static Transform Random(Gen& gen)
+    {
+        auto t = Identity();
+        std::shuffle(t.digits.begin() + 1, t.digits.end(), gen);
+        ShuffleLines(t.rows, gen);
+        ShuffleLines(t.cols, gen);
+        t.transpose = (gen() & 1) != 0;
+        return t;
+    }
+
+    Puzzle_t Apply(const Puzzle_t& grid) const noexcept
+    {
+        Puzzle_t out;
+        for (std::size_t r = 0; r < 9; ++r)
+            for (std::size_t c = 0; c < 9; ++c)
+            {
+                auto num = transpose ? grid[cols[c]][rows[r]] : grid[rows[r]][cols[c]];
+                out[r][c] = digits[num];
+            }
+        return out;
+    }
+
+    /* The transform that undoes this one */
+    Transform Inverse() const noexcept
+    {
+        Transform t;
+        t.transpose = transpose;
+        t.digits[0] = 0;
+        for (std::size_t d = 1; d <= 9; ++d)
+            t.digits[digits[d]] = static_cast<std::uint8_t>(d);
+
+        std::array<std::uint8_t, 9> inv_rows, inv_cols;
+        for (std::size_t k = 0; k < 9; ++k)
+        {
+            inv_rows[rows[k]] = static_cast<std::uint8_t>(k);
+            inv_cols[cols[k]] = static_cast<std::uint8_t>(k);
+        }
+
+        // Undoing a transposed transform transposes first, which swaps
+        // the roles of the row and column permutations
+        t.rows = transpose ? inv_cols : inv_rows;
+        t.cols = transpose ? inv_rows : inv_cols;
+        return t;
+    }
+
+    /* This transform followed by next: Then(next).Apply(g) equals
+       next.Apply(Apply(g)) */
+    Transform Then(const Transform& next) const noexcept
+    {
+        Transform t;
+        t.transpose = transpose != next.transpose;
+        for (std::size_t d = 0; d <= 9; ++d)
+            t.digits[d] = next.digits[digits[d]];
+
+        for (std::size_t k = 0; k < 9; ++k)
+        {
+            t.rows[k] = next.transpose ? cols[next.rows[k]] : rows[next.rows[k]];
+            t.cols[k] = next.transpose ? rows[next.cols[k]] : cols[next.cols[k]];
+        }
+        return t;
+    }
+
+private:
+    /* Permutes the three groups of three lines and the lines of each */
+    template <typename Gen>
+    static void ShuffleLines(std::array<std::uint8_t, 9>& lines, Gen& gen)
+    {
+        std::array<std::uint8_t, 3> groups{0, 1, 2};
+        std::shuffle(groups.begin(), groups.end(), gen);
+
+        for (std::size_t g = 0; g < 3; ++g)
+        {
+            std::array<std::uint8_t, 3> within{0, 1, 2};
+            std::shuffle(within.begin(), within.end(), gen);
+            for (std::size_t k = 0; k < 3; ++k)
+                lines[g * 3 + k] = static_cast<std::uint8_t>(groups[g] * 3 + within[k]);
+        }
+    }
+};
+
+/* A random puzzle equivalent to seed: same solution count, same grade.
+   Costs one pass over the grid, no search */
+template <typename Gen>
+Puzzle_t RandomVariant(const Puzzle_t& seed, Gen& gen)
+{
+    return Transform::Random(gen).Apply(seed);
+}
+
+
+} // End of namespace Sudoku
+
+#endif // TRANSFORM_HPP
@@ -0,0 +1,1145 @@
+/* Solves a file of puzzles, one 81 character line each.
+
+   The input is cut into batches by a reader, solved by a pool of
+   workers and written back by a writer thread, in input order unless
+   --unordered is given. Every output line is the solution, or the
+   puzzle followed by the reason it was not solved:
+
+       sudoku_batch [-i FILE] [-o FILE] [-j THREADS] [--engine NAME]
+                    [--max-nodes N] [--timeout-ms N] [--batch N]
+                    [--unordered] [--stats] [--trace FILE]
+                    [--cache-mb N] [--checkpoint FILE]
+                    [--checkpoint-every SECONDS] [--resume]
+                    [--shard K/N | --shards N | --merge N]
+                    [--pin compact|scatter|CPULIST]
+
+   --cache-mb puts a solution cache of about N MiB in front of the
+   engine: puzzles equivalent to one already solved, up to symmetry and
+   relabeling, are answered from it. --trace writes a Chrome trace of
+   the pipeline stages, when the tree was configured with
+   SUDOKU_ENABLE_TRACING.
+
+   --checkpoint makes a long job resumable; input and output must then
+   be files. Every --checkpoint-every seconds (60 by default) the
+   writer flushes and syncs the output and atomically replaces FILE with
+   the input and output offsets reached, the batches done and the
+   aggregated stats. SIGINT or SIGTERM stops reading, finishes the
+   batches under way, checkpoints and exits with status 2. --resume
+   (FILE defaults to the output name plus .ckpt) truncates the output
+   to the checkpointed offset and carries on from the input offset, so
+   no puzzle is solved twice and the output of an ordered run is byte
+   for byte the one of an uninterrupted run. The checkpoint is removed
+   once the job completes.
+
+   A job can also run as N processes, each with its own pool, page
+   cache pages and allocator, for instance one per NUMA node or per
+   container. The input file is cut into N byte ranges on line
+   boundaries. --shard K/N solves range K (from 0) only, writing its
+   lines to OUT.shard-K-of-N and its stats to the same name plus
+   .stats, OUT being the -o file. --merge N concatenates the N parts
+   into OUT in order, sums their stats and removes them. --shards N
+   does it all on one machine: it forks one process per shard, each
+   with its share of -j, and merges once they are done. Every puzzle
+   keeps the seed of its place in the whole input, so the merged output
+   is the one of a single process run.
+
+   --pin binds each worker to a CPU: compact fills one NUMA node before
+   the next, scatter deals workers out to the nodes in turn, and a list
+   such as 0-7,16-23 is taken in order. Pinned workers of a node share a
+   work queue, take batches from it first and steal from the nearest
+   other nodes when it is empty. A worker copies its batch's lines out
+   of the mapped input and builds the output itself, so these buffers
+   are first touched, and placed, on its own node. The summary then
+   gives the throughput of every node. With --shards every shard gets
+   CPUs of its own: compact and a list are cut in consecutive slices,
+   scatter deals shards to the nodes in turn and splits the CPUs of a
+   node between the shards that share it */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "my_types.h"
+#include "engines.hpp"
+#include "histogram.hpp"
+#include "io.hpp"
+#include "mapped_file.hpp"
+#include "mpmc_queue.hpp"
+#include "numa.hpp"
+#include "solution_cache.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string input = "-";
+    std::string output = "-";
+    std::string trace;
+    std::size_t threads = 0;
+    Sudoku::Engine engine = Sudoku::Engine::MRV;
+    std::uint64_t max_nodes = 0;
+    std::uint64_t timeout_ms = 0;
+    std::size_t batch = 256;
+    std::size_t cache_mb = 0; // 0: no cache
+    std::string pin;          // empty: workers float
+    std::string checkpoint;   // empty: no checkpoints
+    std::uint64_t checkpoint_every_s = 60;
+    bool resume = false;
+    std::size_t shard = 0;
+    std::size_t shards = 0;   // 0: the whole input in this process
+    bool fork_shards = false; // --shards: fork a process per shard
+    bool merge = false;       // --merge: only merge the parts
+    bool quiet = false;       // no summary, for forked shards
+    bool ordered = true;
+    bool stats = false;
+};
+
+/* Aggregated over every puzzle a worker solved */
+struct BatchStats
+{
+    std::uint64_t puzzles = 0;
+    std::uint64_t invalid = 0;
+    std::uint64_t status[4] = {};  // indexed by SolveStatus
+    Sudoku::SolveStats totals;
+    Sudoku::Log2Histogram nodes;
+    Sudoku::Log2Histogram guesses;
+    Sudoku::Log2Histogram backtracks;
+    Sudoku::Log2Histogram depth;
+    Sudoku::Log2Histogram latency_ns;
+
+    BatchStats& operator+=(const BatchStats& other)
+    {
+        puzzles += other.puzzles;
+        invalid += other.invalid;
+        for (std::size_t k = 0; k < 4; ++k)
+            status[k] += other.status[k];
+        totals += other.totals;
+        nodes += other.nodes;
+        guesses += other.guesses;
+        backtracks += other.backtracks;
+        depth += other.depth;
+        latency_ns += other.latency_ns;
+        return *this;
+    }
+};
+
+struct Batch
+{
+    std::size_t index = 0;
+    std::uint64_t first = 0;     // place of the first puzzle in the whole input, its seed
+    std::uint64_t begin = 0;     // input offset of the batch's first line
+    std::uint64_t input_end = 0; // input offset past the batch's last line
+    std::vector<std::string> lines;
+    std::string output;
+    BatchStats stats;
+};
+
+/* A byte range of the input, from a line start to another */
+struct Shard
+{
+    std::uint64_t begin = 0;
+    std::uint64_t end = 0;
+    std::uint64_t first = 0;     // puzzles before begin
+};
+
+/* Offset of the first line starting at or after at */
+std::uint64_t LineStart(const char* data, std::uint64_t size, std::uint64_t at)
+{
+    if (at == 0 || at >= size)
+        return std::min(at, size);
+    auto nl = static_cast<const char*>(std::memchr(data + at - 1, '\n', size - at + 1));
+    return nl ? static_cast<std::uint64_t>(nl - data) + 1 : size;
+}
+
+/* Puzzle lines, the ones neither empty nor comments, in [begin, end) */
+std::uint64_t CountPuzzles(const char* data, std::uint64_t begin, std::uint64_t end)
+{
+    std::uint64_t count = 0;
+    while (begin < end)
+    {
+        if (data[begin] != '\n' && data[begin] != '#')
+            ++count;
+        auto nl = static_cast<const char*>(std::memchr(data + begin, '\n', end - begin));
+        begin = nl ? static_cast<std::uint64_t>(nl - data) + 1 : end;
+    }
+    return count;
+}
+
+/* Cuts the input into n shards of about the same size, counting the
+   puzzles before each in a single pass */
+std::vector<Shard> Shards(const Sudoku::MappedFile& file, std::size_t n)
+{
+    auto data = reinterpret_cast<const char*>(file.Data());
+    std::uint64_t size = file.Size();
+
+    std::vector<Shard> shards(n);
+    for (std::size_t k = 0; k < n; ++k)
+    {
+        auto& s = shards[k];
+        s.begin = k == 0 ? 0 : shards[k - 1].end;
+        s.end = LineStart(data, size, size * (k + 1) / n);
+        s.first = k == 0 ? 0 : shards[k - 1].first + CountPuzzles(data, shards[k - 1].begin, s.begin);
+    }
+    return shards;
+}
+
+std::string PartName(const std::string& output, std::size_t k, std::size_t n)
+{
+    return output + ".shard-" + std::to_string(k) + "-of-" + std::to_string(n);
+}
+
+/* The input's lines, from a byte range of the mapped input file or
+   from a stream. Offset() is the input offset past the last line */
+class InputLines
+{
+public:
+    explicit InputLines(std::istream& in) : stream{&in} {}
+
+    InputLines(const Sudoku::MappedFile& file, std::uint64_t begin, std::uint64_t end)
+        : data{reinterpret_cast<const char*>(file.Data())}, offset{begin}, end{end} {}
+
+    bool Next(std::string& line)
+    {
+        if (stream)
+        {
+            if (!std::getline(*stream, line))
+                return false;
+            offset += line.size() + (stream->eof() ? 0 : 1);
+            return true;
+        }
+
+        if (offset >= end)
+            return false;
+        auto nl = static_cast<const char*>(std::memchr(data + offset, '\n', end - offset));
+        auto stop = nl ? static_cast<std::uint64_t>(nl - data) : end;
+        line.assign(data + offset, stop - offset);
+        offset = nl ? stop + 1 : end;
+        return true;
+    }
+
+    std::uint64_t Offset() const noexcept {return offset;}
+
+private:
+    std::istream* stream = nullptr;
+    const char* data = nullptr;
+    std::uint64_t offset = 0;
+    std::uint64_t end = 0;
+};
+
+/* How far a job got. The first fields identify the job, a checkpoint
+   of another job is refused. done lists the batches past the first
+   batches that an unordered run already wrote, with their input_end */
+struct Checkpoint
+{
+    std::uint64_t input_size = 0;
+    std::string engine;
+    std::size_t batch = 0;
+    std::uint64_t max_nodes = 0;
+    bool ordered = true;
+    std::size_t shard = 0;
+    std::size_t shards = 0;
+
+    std::uint64_t input_offset = 0;
+    std::uint64_t output_offset = 0;
+    std::size_t batches = 0;
+    std::map<std::size_t, std::uint64_t> done;
+    BatchStats stats;
+};
+
+bool ParseOptions(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        std::string value = has_value ? argv[i + 1] : "";
+
+        if (arg == "--unordered")
+            opt.ordered = false;
+        else if (arg == "--stats")
+            opt.stats = true;
+        else if (arg == "-i" && has_value)
+            opt.input = value, ++i;
+        else if (arg == "-o" && has_value)
+            opt.output = value, ++i;
+        else if (arg == "--trace" && has_value)
+            opt.trace = value, ++i;
+        else if (arg == "-j" && has_value)
+            opt.threads = std::strtoul(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--max-nodes" && has_value)
+            opt.max_nodes = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--timeout-ms" && has_value)
+            opt.timeout_ms = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--cache-mb" && has_value)
+            opt.cache_mb = std::strtoul(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--checkpoint" && has_value)
+            opt.checkpoint = value, ++i;
+        else if (arg == "--checkpoint-every" && has_value)
+            opt.checkpoint_every_s = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--resume")
+            opt.resume = true;
+        else if (arg == "--pin" && has_value)
+            opt.pin = value, ++i;
+        else if (arg == "--shard" && has_value && value.find('/') != std::string::npos)
+        {
+            opt.shard = std::strtoul(value.c_str(), nullptr, 10);
+            opt.shards = std::strtoul(value.c_str() + value.find('/') + 1, nullptr, 10);
+            ++i;
+        }
+        else if ((arg == "--shards" || arg == "--merge") && has_value)
+        {
+            opt.shards = std::strtoul(value.c_str(), nullptr, 10);
+            opt.fork_shards = arg == "--shards";
+            opt.merge = arg == "--merge";
+            ++i;
+        }
+        else if (arg == "--batch" && has_value)
+            opt.batch = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10)), ++i;
+        else if (arg == "--engine" && has_value)
+        {
+            auto engine = Sudoku::EngineFromName(value);
+            if (!engine)
+            {
+                std::cerr << "unknown engine: " << value << "\n";
+                return false;
+            }
+            opt.engine = *engine;
+            ++i;
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [-i FILE] [-o FILE] [-j THREADS] [--engine naive|mrv|random-mrv|dlx]"
+                         " [--max-nodes N] [--timeout-ms N] [--batch N] [--unordered] [--stats]"
+                         " [--trace FILE] [--cache-mb N] [--checkpoint FILE]"
+                         " [--checkpoint-every SECONDS] [--resume]"
+                         " [--shard K/N | --shards N | --merge N]"
+                         " [--pin compact|scatter|CPULIST]\n";
+            return false;
+        }
+    }
+
+    if (opt.shards != 0 || opt.shard != 0)
+    {
+        if (opt.shard >= opt.shards || opt.output == "-" || (opt.input == "-" && !opt.merge))
+        {
+            std::cerr << "shards need -i and -o files, and K < N\n";
+            return false;
+        }
+        if (opt.fork_shards && !opt.checkpoint.empty())
+        {
+            std::cerr << "checkpoints work per shard, with --shard K/N\n";
+            return false;
+        }
+        if (!opt.fork_shards && !opt.merge)
+            opt.output = PartName(opt.output, opt.shard, opt.shards);
+    }
+
+    if (opt.resume && opt.checkpoint.empty())
+        opt.checkpoint = opt.output + ".ckpt";
+
+    if (!opt.checkpoint.empty() && (opt.input == "-" || opt.output == "-"))
+    {
+        std::cerr << "checkpoints need -i and -o files\n";
+        return false;
+    }
+
+    if (opt.threads == 0)
+        opt.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    return true;
+}
+
+void SaveStats(std::ostream& out, const BatchStats& stats)
+{
+    const auto& t = stats.totals;
+    out << "puzzles " << stats.puzzles << "\ninvalid " << stats.invalid << "\nstatus";
+    for (auto n : stats.status)
+        out << ' ' << n;
+    out << "\ntotals " << t.nodes << ' ' << t.guesses << ' ' << t.backtracks << ' ' << t.max_depth << ' '
+        << t.naked_singles << ' ' << t.hidden_singles << ' ' << t.cycles;
+
+    const std::pair<const char*, const Sudoku::Log2Histogram*> histograms[] = {
+        {"nodes", &stats.nodes}, {"guesses", &stats.guesses}, {"backtracks", &stats.backtracks},
+        {"depth", &stats.depth}, {"latency_ns", &stats.latency_ns}};
+    for (const auto& [name, h] : histograms)
+    {
+        out << '\n' << name << ' ';
+        h->Save(out);
+    }
+    out << '\n';
+}
+
+bool LoadStats(std::istream& in, BatchStats& stats)
+{
+    std::string key;
+    auto& t = stats.totals;
+    in >> key >> stats.puzzles >> key >> stats.invalid >> key;
+    for (auto& n : stats.status)
+        in >> n;
+    in >> key >> t.nodes >> t.guesses >> t.backtracks >> t.max_depth >> t.naked_singles >> t.hidden_singles
+       >> t.cycles;
+
+    for (auto h : {&stats.nodes, &stats.guesses, &stats.backtracks, &stats.depth, &stats.latency_ns})
+        if (!(in >> key) || !h->Load(in))
+            return false;
+    return static_cast<bool>(in);
+}
+
+/* Flushes what the system holds of path to the disk */
+bool SyncFile(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+/* Replaces path by c atomically: a crash leaves either checkpoint whole */
+bool WriteCheckpoint(const std::string& path, const Checkpoint& c)
+{
+    auto tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << "sudoku_batch checkpoint 1\n"
+            << "input_size " << c.input_size << "\nengine " << c.engine << "\nbatch " << c.batch
+            << "\nmax_nodes " << c.max_nodes << "\nordered " << c.ordered
+            << "\nshard " << c.shard << ' ' << c.shards
+            << "\ninput_offset " << c.input_offset << "\noutput_offset " << c.output_offset
+            << "\nbatches " << c.batches << "\ndone " << c.done.size();
+        for (const auto& [index, end] : c.done)
+            out << ' ' << index << ' ' << end;
+        out << '\n';
+        SaveStats(out, c.stats);
+        if (!out.flush())
+            return false;
+    }
+
+    std::error_code ec;
+    if (!SyncFile(tmp))
+        return false;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+std::optional<Checkpoint> ReadCheckpoint(const std::string& path)
+{
+    std::ifstream in(path);
+    std::string magic, kind, key;
+    int version = 0;
+    if (!(in >> magic >> kind >> version) || magic != "sudoku_batch" || kind != "checkpoint" || version != 1)
+        return {};
+
+    Checkpoint c;
+    std::size_t done = 0;
+    in >> key >> c.input_size >> key >> c.engine >> key >> c.batch >> key >> c.max_nodes
+       >> key >> c.ordered >> key >> c.shard >> c.shards >> key >> c.input_offset >> key >> c.output_offset >> key >> c.batches
+       >> key >> done;
+    for (std::size_t k = 0; k < done && in; ++k)
+    {
+        std::size_t index;
+        std::uint64_t end;
+        in >> index >> end;
+        c.done.emplace(index, end);
+    }
+
+    if (!in || !LoadStats(in, c.stats))
+        return {};
+    return c;
+}
+
+/* Why c cannot be resumed with opt, empty if it can */
+std::string Mismatch(const Checkpoint& c, const Options& opt, std::uint64_t input_size)
+{
+    if (c.input_size != input_size)
+        return "the input changed size";
+    if (c.engine != Sudoku::EngineName(opt.engine))
+        return std::string("it was run with --engine ") + c.engine;
+    if (c.batch != opt.batch)
+        return "it was run with --batch " + std::to_string(c.batch);
+    if (c.max_nodes != opt.max_nodes)
+        return "it was run with --max-nodes " + std::to_string(c.max_nodes);
+    if (c.ordered != opt.ordered)
+        return c.ordered ? "it was run ordered" : "it was run with --unordered";
+    if (c.shard != opt.shard || c.shards != opt.shards)
+        return "it was run on shard " + std::to_string(c.shard) + "/" + std::to_string(c.shards);
+    return {};
+}
+
+std::atomic<bool> stop_requested{false};
+
+extern "C" void OnSignal(int)
+{
+    stop_requested.store(true);
+}
+
+/* Copies the batch's lines out of the mapped input. The worker that
+   solves the batch does it, so that they are first touched, and
+   placed, on its node */
+void LoadLines(Batch& batch, const Sudoku::MappedFile& file)
+{
+    InputLines input(file, batch.begin, batch.input_end);
+    std::string line;
+    while (input.Next(line))
+        if (!line.empty() && line[0] != '#')
+            batch.lines.push_back(line);
+}
+
+/* What a worker did, for the summary per node. One cache line each, as
+   every worker bumps its own after every batch */
+struct alignas(64) WorkerCounters
+{
+    std::uint64_t puzzles = 0;
+    std::uint64_t batches = 0;
+    std::uint64_t stolen = 0;     // batches taken from another node's queue
+};
+
+/* The workers placed on one node and the queue they share */
+struct NodeGroup
+{
+    std::size_t node = 0;                 // index in the topology
+    std::vector<std::size_t> workers;
+    std::vector<std::size_t> victims;     // the other groups, nearest first
+    std::unique_ptr<Sudoku::BlockingMpmcQueue<Batch>> work;
+};
+
+void PrintNodes(const std::vector<NodeGroup>& groups, const Sudoku::NumaTopology& topology,
+                const std::vector<int>& cpus, const std::vector<WorkerCounters>& counters, double seconds)
+{
+    for (const auto& group : groups)
+    {
+        std::vector<int> used;
+        WorkerCounters sum;
+        for (auto w : group.workers)
+        {
+            used.push_back(cpus[w]);
+            sum.puzzles += counters[w].puzzles;
+            sum.batches += counters[w].batches;
+            sum.stolen += counters[w].stolen;
+        }
+        std::sort(used.begin(), used.end());
+        used.erase(std::unique(used.begin(), used.end()), used.end());
+
+        std::cerr << "node " << topology.nodes[group.node].id << ": " << group.workers.size()
+                  << " workers on CPUs " << Sudoku::FormatCpuList(used) << ", " << sum.puzzles << " puzzles ("
+                  << (seconds > 0 ? static_cast<double>(sum.puzzles) / seconds : 0.0) << " puzzles/s), "
+                  << sum.batches << " batches, " << sum.stolen << " stolen\n";
+    }
+}
+
+/* Solves every line of batch, appending the output lines and counting
+   into the batch's own stats */
+void SolveBatch(Batch& batch, const Options& opt, Sudoku::SolutionCache* cache)
+{
+    SUDOKU_TRACE_SCOPE("batch/solve");
+    auto& stats = batch.stats;
+    batch.output.reserve(batch.lines.size() * 82);
+
+    for (std::size_t i = 0; i < batch.lines.size(); ++i)
+    {
+        const auto& line = batch.lines[i];
+        ++stats.puzzles;
+
+        auto grid = Sudoku::ParsePuzzle(line);
+        if (!grid)
+        {
+            ++stats.invalid;
+            batch.output += line;
+            batch.output += " invalid\n";
+            continue;
+        }
+
+        Sudoku::SolveOptions budget;
+        budget.max_nodes = opt.max_nodes;
+        if (opt.timeout_ms != 0)
+            budget.Timeout(std::chrono::milliseconds(opt.timeout_ms));
+
+        Sudoku::SolveStats solve_stats;
+        auto start = Clock::now();
+        auto result = Sudoku::SolveCached(cache, opt.engine, *grid, budget, batch.first + i,
+                                          opt.stats ? &solve_stats : nullptr);
+        auto elapsed = Clock::now() - start;
+
+        ++stats.status[static_cast<std::size_t>(result.status)];
+        stats.latency_ns.Add(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+
+        if (opt.stats)
+        {
+            stats.totals += solve_stats;
+            stats.nodes.Add(solve_stats.nodes);
+            stats.guesses.Add(solve_stats.guesses);
+            stats.backtracks.Add(solve_stats.backtracks);
+            stats.depth.Add(solve_stats.max_depth);
+        }
+
+        batch.output += Sudoku::ToString(result.grid);
+        if (!result.Solved())
+        {
+            batch.output += ' ';
+            batch.output += Sudoku::StatusName(result.status);
+        }
+        batch.output += '\n';
+    }
+
+    batch.lines.clear();
+}
+
+/* stats covers the whole job, resumed counts what earlier runs did */
+void PrintSummary(const BatchStats& stats, std::uint64_t resumed, const Options& opt,
+                  const Sudoku::SolutionCache* cache, double seconds)
+{
+    if (opt.quiet)
+        return;
+
+    auto& err = std::cerr;
+    auto now = stats.puzzles - resumed;
+    err << stats.puzzles << " puzzles";
+    if (resumed != 0)
+        err << " (" << resumed << " before resuming)";
+    err << " in " << seconds << " s ("
+        << (seconds > 0 ? static_cast<double>(now) / seconds : 0.0) << " puzzles/s): "
+        << stats.status[0] << " solved, " << stats.status[1] << " unsolvable, "
+        << stats.status[2] << " budget exceeded, " << stats.status[3] << " cancelled, "
+        << stats.invalid << " invalid\n";
+
+    if (cache)
+    {
+        auto c = cache->Counters();
+        err << "cache: " << c.hits << " hits, " << c.misses << " misses, "
+            << c.entries << " entries (" << c.bytes / 1024 << " KiB), "
+            << c.evictions << " evictions\n";
+    }
+
+    if (!opt.stats)
+        return;
+
+    err << "engine " << Sudoku::EngineName(opt.engine)
+        << ": nodes " << stats.totals.nodes
+        << ", guesses " << stats.totals.guesses
+        << ", backtracks " << stats.totals.backtracks
+        << ", naked singles " << stats.totals.naked_singles
+        << ", hidden singles " << stats.totals.hidden_singles
+        << ", max depth " << stats.totals.max_depth
+        << ", cycles " << stats.totals.cycles << "\n";
+
+    stats.nodes.Print(err, "nodes per puzzle");
+    stats.guesses.Print(err, "guesses per puzzle");
+    stats.backtracks.Print(err, "backtracks per puzzle");
+    stats.depth.Print(err, "max depth per puzzle");
+    stats.latency_ns.Print(err, "latency ns");
+}
+
+/* Part of the stats a shard leaves next to its output for --merge */
+bool WriteShardStats(const Options& opt, const BatchStats& stats, double seconds)
+{
+    std::ofstream out(opt.output + ".stats", std::ios::trunc);
+    out << "sudoku_batch shard " << opt.shard << ' ' << opt.shards << "\nseconds " << seconds << '\n';
+    SaveStats(out, stats);
+    return static_cast<bool>(out.flush());
+}
+
+/* Solves the lines of shard, from file or from stdin when file is null,
+   into opt.output */
+int Run(const Options& opt, const Sudoku::MappedFile* file, const Shard& shard)
+{
+    std::optional<InputLines> input;
+    if (file)
+        input.emplace(*file, shard.begin, shard.end);
+    else
+        input.emplace(std::cin);
+
+    // What this job is, and how far an earlier run of it got
+    bool checkpoints = !opt.checkpoint.empty();
+    Checkpoint ckpt;
+    ckpt.input_offset = shard.begin;
+    if (checkpoints)
+    {
+        ckpt.input_size = file->Size();
+        ckpt.engine = Sudoku::EngineName(opt.engine);
+        ckpt.batch = opt.batch;
+        ckpt.max_nodes = opt.max_nodes;
+        ckpt.ordered = opt.ordered;
+        ckpt.shard = opt.shard;
+        ckpt.shards = opt.shards;
+    }
+
+    if (opt.resume)
+    {
+        auto saved = ReadCheckpoint(opt.checkpoint);
+        if (!saved)
+        {
+            std::cerr << "no checkpoint to resume in " << opt.checkpoint << "\n";
+            return 1;
+        }
+
+        auto why = Mismatch(*saved, opt, ckpt.input_size);
+        std::error_code ec;
+        auto output_size = std::filesystem::file_size(opt.output, ec);
+        if (why.empty() && (ec || output_size < saved->output_offset))
+            why = "the output is shorter than checkpointed";
+        if (!why.empty())
+        {
+            std::cerr << "cannot resume from " << opt.checkpoint << ": " << why << "\n";
+            return 1;
+        }
+
+        // Whatever was written past the checkpoint is written again
+        std::filesystem::resize_file(opt.output, saved->output_offset, ec);
+        if (ec)
+        {
+            std::cerr << "cannot resume from " << opt.checkpoint << "\n";
+            return 1;
+        }
+        ckpt = std::move(*saved);
+        input.emplace(*file, ckpt.input_offset, shard.end);
+    }
+    const std::uint64_t resumed = ckpt.stats.puzzles;
+
+    std::ofstream out_file;
+    if (opt.output != "-")
+    {
+        out_file.open(opt.output, std::ios::binary | (opt.resume ? std::ios::app : std::ios::trunc));
+        if (!out_file)
+        {
+            std::cerr << "cannot create " << opt.output << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = opt.output == "-" ? std::cout : out_file;
+
+    if (checkpoints)
+    {
+        std::signal(SIGINT, OnSignal);
+        std::signal(SIGTERM, OnSignal);
+    }
+
+    auto start = Clock::now();
+
+    /* Workers are grouped by the node of their CPU, a single group when
+       they are not pinned. Batches are dealt to the groups in proportion
+       to their workers */
+    Sudoku::NumaTopology topology;
+    std::vector<int> cpus;
+    if (!opt.pin.empty())
+    {
+        topology = Sudoku::DetectNuma();
+        auto placed = Sudoku::WorkerCpus(topology, opt.pin, opt.threads);
+        if (!placed)
+        {
+            std::cerr << "--pin takes compact, scatter or a CPU list, not " << opt.pin << "\n";
+            return 1;
+        }
+        cpus = std::move(*placed);
+    }
+
+    std::vector<NodeGroup> groups;
+    std::vector<std::size_t> group_of(opt.threads);
+    for (std::size_t w = 0; w < opt.threads; ++w)
+    {
+        auto node = cpus.empty() ? 0 : topology.NodeOf(cpus[w]);
+        auto it = std::find_if(groups.begin(), groups.end(), [&](const NodeGroup& g) { return g.node == node; });
+        if (it == groups.end())
+        {
+            groups.emplace_back();
+            groups.back().node = node;
+            it = groups.end() - 1;
+        }
+        it->workers.push_back(w);
+        group_of[w] = static_cast<std::size_t>(it - groups.begin());
+    }
+    for (std::size_t g = 0; g < groups.size(); ++g)
+    {
+        groups[g].work = std::make_unique<Sudoku::BlockingMpmcQueue<Batch>>(groups[g].workers.size() * 4);
+        for (auto n : topology.Neighbours(groups[g].node))
+            for (std::size_t v = 0; v < groups.size(); ++v)
+                if (groups[v].node == n)
+                    groups[g].victims.push_back(v);
+    }
+
+    Sudoku::BlockingMpmcQueue<Batch> done(opt.threads * 4);
+    std::vector<WorkerCounters> counters(opt.threads);
+
+    std::unique_ptr<Sudoku::SolutionCache> cache;
+    if (opt.cache_mb != 0)
+        cache = std::make_unique<Sudoku::SolutionCache>(opt.cache_mb << 20);
+
+    // A batch from the worker's own node first, else one stolen from the nearest
+    auto next_batch = [&](std::size_t w) -> std::optional<Batch> {
+        auto& group = groups[group_of[w]];
+        if (group.victims.empty())
+            return group.work->Pop();
+
+        for (;;)
+        {
+            if (auto batch = group.work->TryPop())
+                return batch;
+            for (auto v : group.victims)
+                if (auto batch = groups[v].work->TryPop())
+                {
+                    ++counters[w].stolen;
+                    return batch;
+                }
+            if (auto batch = group.work->PopFor(std::chrono::milliseconds(1)))
+                return batch;
+            if (std::all_of(groups.begin(), groups.end(), [](const NodeGroup& g) { return g.work->Drained(); }))
+                return {};
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t w = 0; w < opt.threads; ++w)
+        workers.emplace_back([&, w]{
+            SUDOKU_TRACE_THREAD("batch worker " + std::to_string(w));
+            if (!cpus.empty() && !Sudoku::PinThread(cpus[w]))
+                std::cerr << "cannot pin worker " << w << " to CPU " << cpus[w] << "\n";
+
+            while (auto batch = next_batch(w))
+            {
+                if (file)
+                    LoadLines(*batch, *file);
+                SolveBatch(*batch, opt, cache.get());
+                counters[w].puzzles += batch->stats.puzzles;
+                ++counters[w].batches;
+                done.Push(std::move(*batch));
+            }
+        });
+
+    // Batches an unordered run wrote past the prefix before it stopped
+    const auto written = ckpt.done;
+
+    /* Writer: batches come back in any order, pending holds the early
+       ones. It owns the checkpoint: batches below ckpt.batches are all
+       in the output, ckpt.done lists the later ones an unordered run
+       already wrote */
+    bool checkpoint_failed = false;
+    std::thread writer([&]{
+        SUDOKU_TRACE_THREAD("batch writer");
+        std::map<std::size_t, Batch> pending;
+        auto last_checkpoint = Clock::now();
+
+        auto checkpoint = [&]{
+            SUDOKU_TRACE_SCOPE("batch/checkpoint");
+            if (!out.flush() || !SyncFile(opt.output) || !WriteCheckpoint(opt.checkpoint, ckpt))
+                checkpoint_failed = true;
+            last_checkpoint = Clock::now();
+        };
+
+        auto write = [&](const Batch& batch){
+            out << batch.output;
+            ckpt.output_offset += batch.output.size();
+            ckpt.stats += batch.stats;
+            ckpt.done.emplace(batch.index, batch.input_end);
+            for (auto it = ckpt.done.begin(); it != ckpt.done.end() && it->first == ckpt.batches;
+                 it = ckpt.done.erase(it), ++ckpt.batches)
+                ckpt.input_offset = it->second;
+        };
+
+        if (checkpoints)
+            checkpoint();
+
+        while (auto batch = done.Pop())
+        {
+            SUDOKU_TRACE_SCOPE("batch/write");
+
+            if (!opt.ordered)
+                write(*batch);
+            else
+            {
+                pending.emplace(batch->index, std::move(*batch));
+                for (auto it = pending.find(ckpt.batches); it != pending.end(); it = pending.find(ckpt.batches))
+                {
+                    write(it->second);
+                    pending.erase(it);
+                }
+            }
+
+            if (checkpoints && Clock::now() - last_checkpoint >= std::chrono::seconds(opt.checkpoint_every_s))
+                checkpoint();
+        }
+
+        if (checkpoints)
+            checkpoint();
+    });
+
+    // Reader, from the checkpointed offset on when resuming
+    SUDOKU_TRACE_THREAD("batch reader");
+    Batch batch;
+    std::string line;
+    std::size_t index = ckpt.batches;
+    std::size_t count = 0;   // puzzles in batch
+    bool interrupted = false;
+
+    auto submit = [&]{
+        SUDOKU_TRACE_SCOPE("batch/queue");
+        batch.index = index++;
+        batch.first = shard.first + batch.index * opt.batch;
+        batch.input_end = input->Offset();
+        if (written.count(batch.index) == 0)
+            groups[group_of[batch.index % opt.threads]].work->Push(std::move(batch));
+        batch = Batch{};
+        count = 0;
+    };
+
+    // A mapped input is only cut here, the workers copy the lines themselves
+    for (auto at = input->Offset(); input->Next(line); at = input->Offset())
+    {
+        if (stop_requested.load())
+        {
+            interrupted = true;
+            break;
+        }
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        if (count++ == 0)
+            batch.begin = at;
+        if (!file)
+            batch.lines.push_back(line);
+        if (count == opt.batch)
+            submit();
+    }
+
+    if (!interrupted && count != 0)
+        submit();
+
+    for (auto& group : groups)
+        group.work->Close();
+    for (auto& t : workers)
+        t.join();
+
+    done.Close();
+    writer.join();
+    out.flush();
+
+    auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    PrintSummary(ckpt.stats, resumed, opt, cache.get(), seconds);
+    if (!cpus.empty() && !opt.quiet)
+        PrintNodes(groups, topology, cpus, counters, seconds);
+
+    if (!opt.trace.empty() && !Sudoku::WriteChromeTrace(opt.trace))
+    {
+        std::cerr << "cannot create " << opt.trace << "\n";
+        return 1;
+    }
+
+    if (checkpoint_failed)
+    {
+        std::cerr << "cannot write checkpoint " << opt.checkpoint << "\n";
+        return 1;
+    }
+
+    if (interrupted)
+    {
+        std::cerr << "interrupted: resume with --resume"
+                  << (opt.checkpoint == opt.output + ".ckpt" ? "" : " --checkpoint " + opt.checkpoint) << "\n";
+        return 2;
+    }
+
+    if (checkpoints)
+    {
+        std::error_code ec;
+        std::filesystem::remove(opt.checkpoint, ec);
+        std::filesystem::remove(opt.checkpoint + ".tmp", ec);
+    }
+
+    if (opt.shards != 0 && out && !WriteShardStats(opt, ckpt.stats, seconds))
+    {
+        std::cerr << "cannot create " << opt.output << ".stats\n";
+        return 1;
+    }
+
+    return out ? 0 : 1;
+}
+
+/* Concatenates the parts of the shards into opt.output, in order, and
+   prints the summed stats. Every part must hold one line per puzzle its
+   stats count, else the merge fails, drops the output and keeps the
+   parts. The parts are removed once merged; seconds is the wall time
+   of the job if known, else the slowest shard's */
+int Merge(const Options& opt, double seconds)
+{
+    BatchStats total;
+    std::vector<std::uint64_t> puzzles(opt.shards);
+    bool from_shards = seconds == 0;
+    for (std::size_t k = 0; k < opt.shards; ++k)
+    {
+        auto part = PartName(opt.output, k, opt.shards);
+        std::ifstream in(part + ".stats");
+        std::string magic, kind, key;
+        std::size_t shard = 0, shards = 0;
+        double shard_seconds = 0;
+        BatchStats stats;
+        if (!(in >> magic >> kind >> shard >> shards >> key >> shard_seconds) || magic != "sudoku_batch" ||
+            kind != "shard" || shard != k || shards != opt.shards || !LoadStats(in, stats))
+        {
+            std::cerr << "shard " << k << " of " << opt.shards << " is not done: no " << part << ".stats\n";
+            return 1;
+        }
+        total += stats;
+        puzzles[k] = stats.puzzles;
+        if (from_shards)
+            seconds = std::max(seconds, shard_seconds);
+    }
+
+    std::ofstream out(opt.output, std::ios::binary | std::ios::trunc);
+    std::vector<char> buffer(1 << 20);
+    std::error_code ec;
+    for (std::size_t k = 0; k < opt.shards; ++k)
+    {
+        auto part = PartName(opt.output, k, opt.shards);
+        std::ifstream in(part, std::ios::binary);
+        std::uint64_t lines = 0;
+        while (in.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || in.gcount() > 0)
+        {
+            lines += static_cast<std::uint64_t>(std::count(buffer.data(), buffer.data() + in.gcount(), '\n'));
+            out.write(buffer.data(), in.gcount());
+        }
+
+        if (!in.is_open() || in.bad() || lines != puzzles[k])
+        {
+            std::cerr << "shard " << k << " of " << opt.shards << ": " << part;
+            if (!in.is_open() || in.bad())
+                std::cerr << " cannot be read";
+            else
+                std::cerr << " has " << lines << " lines for " << puzzles[k] << " puzzles";
+            std::cerr << ", the parts are kept\n";
+            out.close();
+            std::filesystem::remove(opt.output, ec);
+            return 1;
+        }
+    }
+    out.close();
+    if (!out)
+    {
+        std::cerr << "cannot merge the shards into " << opt.output << ", the parts are kept\n";
+        std::filesystem::remove(opt.output, ec);
+        return 1;
+    }
+
+    for (std::size_t k = 0; k < opt.shards; ++k)
+    {
+        auto part = PartName(opt.output, k, opt.shards);
+        std::filesystem::remove(part, ec);
+        std::filesystem::remove(part + ".stats", ec);
+    }
+
+    PrintSummary(total, 0, opt, nullptr, seconds);
+    return 0;
+}
+
+/* Forks a process per shard, with its share of the threads, waits for
+   them all and merges. The shards were cut before forking, so that no
+   child reads the input before its own range */
+int RunShards(const Options& opt, const Sudoku::MappedFile& file)
+{
+    auto start = Clock::now();
+    auto shards = Shards(file, opt.shards);
+
+    std::vector<std::vector<int>> cpus;
+    if (!opt.pin.empty())
+    {
+        auto split = Sudoku::ShardCpus(Sudoku::DetectNuma(), opt.pin, opt.shards);
+        if (!split)
+        {
+            std::cerr << "--pin takes compact, scatter or a CPU list, not " << opt.pin << "\n";
+            return 1;
+        }
+        cpus = std::move(*split);
+    }
+
+    std::vector<pid_t> children;
+    for (std::size_t k = 0; k < opt.shards; ++k)
+    {
+        auto pid = ::fork();
+        if (pid == 0)
+        {
+            Options child = opt;
+            child.shard = k;
+            child.fork_shards = false;
+            child.quiet = true;
+            child.threads = std::max<std::size_t>(1, opt.threads / opt.shards);
+            child.output = PartName(opt.output, k, opt.shards);
+            if (!cpus.empty())
+                child.pin = Sudoku::FormatCpuList(cpus[k]);
+            if (!opt.trace.empty())
+                child.trace = PartName(opt.trace, k, opt.shards);
+            ::_exit(Run(child, &file, shards[k]));
+        }
+        if (pid < 0)
+        {
+            std::cerr << "cannot fork shard " << k << "\n";
+            break;
+        }
+        children.push_back(pid);
+    }
+
+    bool ok = children.size() == opt.shards;
+    for (std::size_t k = 0; k < children.size(); ++k)
+    {
+        int status = 0;
+        if (::waitpid(children[k], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::cerr << "shard " << k << " of " << opt.shards << " failed\n";
+            ok = false;
+        }
+    }
+    if (!ok)
+        return 1;
+
+    return Merge(opt, std::chrono::duration<double>(Clock::now() - start).count());
+}
+
+} // End of anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!ParseOptions(argc, argv, opt))
+        return 1;
+
+    if (opt.merge)
+        return Merge(opt, 0);
+
+    if (opt.input == "-")
+        return Run(opt, nullptr, Shard{});
+
+    Sudoku::MappedFile file(opt.input);
+    if (!file.IsOpen())
+    {
+        std::cerr << "cannot open " << opt.input << "\n";
+        return 1;
+    }
+
+    if (opt.fork_shards)
+        return RunShards(opt, file);
+    if (opt.shards != 0)
+        return Run(opt, &file, Shards(file, opt.shards)[opt.shard]);
+    return Run(opt, &file, Shard{0, file.Size(), 0});
+}
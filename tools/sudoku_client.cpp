@@ -0,0 +1,337 @@
+/* Client of sudokud: sends puzzles to the daemon and prints the
+   answers in the output format of sudoku_batch, one line per puzzle,
+   in input order:
+
+       sudoku_client [-s SOCKET] [-i FILE] [-o FILE] [--raw] [--stats]
+                     [--shm] [--slots N] [PUZZLE...]
+
+   Puzzles given on the command line are sent instead of the input.
+   --raw prints the daemon's reply lines as they are (with node counts
+   and solve times), --stats asks for the daemon's counters at the end
+   and prints them to stderr along with the client's own throughput.
+
+   Requests are written by a second thread while replies are read, so
+   the input can be far larger than the socket buffers.
+
+   --shm sends the puzzles through a shared memory ring of --slots
+   slots (1024 by default, src/shm_ring.hpp) instead of the socket:
+   grids go in and solutions come back as 41 byte records written in
+   place, with no copy through the kernel. The output is the same */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "my_types.h"
+#include "daemon_protocol.hpp"
+#include "io.hpp"
+#include "shm_ring.hpp"
+#include "socket.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string socket = Sudoku::Daemon::DefaultSocketPath();
+    std::string input = "-";
+    std::string output = "-";
+    std::vector<std::string> puzzles;
+    std::uint32_t slots = Sudoku::ShmFormat::DefaultSlots;
+    bool raw = false;
+    bool stats = false;
+    bool shm = false;
+};
+
+bool ParseOptions(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        std::string value = has_value ? argv[i + 1] : "";
+
+        if (arg == "--raw")
+            opt.raw = true;
+        else if (arg == "--stats")
+            opt.stats = true;
+        else if (arg == "--shm")
+            opt.shm = true;
+        else if (arg == "--slots" && has_value)
+            opt.slots = static_cast<std::uint32_t>(std::strtoul(value.c_str(), nullptr, 10)), ++i;
+        else if (arg == "-s" && has_value)
+            opt.socket = value, ++i;
+        else if (arg == "-i" && has_value)
+            opt.input = value, ++i;
+        else if (arg == "-o" && has_value)
+            opt.output = value, ++i;
+        else if (!arg.empty() && arg[0] != '-')
+            opt.puzzles.push_back(arg);
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [-s SOCKET] [-i FILE] [-o FILE] [--raw] [--stats] [--shm] [--slots N]"
+                         " [PUZZLE...]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/* The requests to send: the puzzles of the command line, or else the
+   lines of the input that are not blank or comments */
+class Source
+{
+public:
+    Source(const Options& options, std::istream& input) : opt{options}, in{input} {}
+
+    bool Next(std::string& line)
+    {
+        if (!opt.puzzles.empty())
+        {
+            if (index == opt.puzzles.size())
+                return false;
+            line = opt.puzzles[index++];
+            return true;
+        }
+
+        while (std::getline(in, line))
+            if (!line.empty() && line[0] != '#')
+                return true;
+        return false;
+    }
+
+private:
+    const Options& opt;
+    std::istream& in;
+    std::size_t index = 0;
+};
+
+struct Totals
+{
+    std::uint64_t puzzles = 0;
+    std::uint64_t solved = 0;
+};
+
+/* One output line, in the format of sudoku_batch or, with --raw, the
+   reply line of the daemon */
+void Emit(std::string& text, const Options& opt, const std::string& grid, const std::string& status,
+          std::uint64_t nodes, std::uint64_t micros)
+{
+    if (opt.raw)
+        text += Sudoku::Daemon::FormatReply(grid, status, nodes, micros);
+    else
+    {
+        text += grid;
+        if (status != "solved")
+        {
+            text += ' ';
+            text += status;
+        }
+        text += '\n';
+    }
+}
+
+/* Line protocol: a writer thread streams the requests, replies are read
+   as they come */
+bool RunLines(const Options& opt, Source& source, std::ostream& out, Totals& totals)
+{
+    auto conn = Sudoku::ConnectUnix(opt.socket);
+    if (!conn.IsOpen())
+    {
+        std::cerr << "cannot connect to " << opt.socket << ": " << std::strerror(errno)
+                  << " (is sudokud running?)\n";
+        return false;
+    }
+
+    std::thread writer([&]{
+        std::string text, line;
+        while (source.Next(line))
+        {
+            text += line;
+            text += '\n';
+            if (text.size() >= (1u << 16))
+            {
+                Sudoku::SendAll(conn.Fd(), text);
+                text.clear();
+            }
+        }
+
+        Sudoku::SendAll(conn.Fd(), text);
+        ::shutdown(conn.Fd(), SHUT_WR);
+    });
+
+    Sudoku::LineReader reader(conn.Fd());
+    std::string line, text;
+
+    while (reader.Next(line))
+    {
+        auto reply = Sudoku::Daemon::ParseReply(line);
+        ++totals.puzzles;
+
+        if (!reply)
+        {
+            text += line;
+            text += '\n';
+        }
+        else
+        {
+            totals.solved += reply->Solved();
+            Emit(text, opt, reply->grid, reply->status, reply->nodes, reply->micros);
+        }
+
+        if (text.size() >= (1u << 16))
+        {
+            out << text;
+            text.clear();
+        }
+    }
+    out << text;
+    writer.join();
+    return true;
+}
+
+/* Shared memory ring: keeps the ring full, lines that are not puzzles
+   are answered here, in their place */
+bool RunRing(const Options& opt, Source& source, std::ostream& out, Totals& totals)
+{
+    auto client = Sudoku::ShmClient::Connect(opt.socket, opt.slots);
+    if (!client)
+    {
+        std::cerr << "cannot set up a ring of " << opt.slots << " slots with sudokud at " << opt.socket
+                  << " (is it running? --slots must be a power of two up to "
+                  << Sudoku::ShmFormat::MaxSlots << ")\n";
+        return false;
+    }
+
+    struct Entry
+    {
+        std::string line;
+        bool valid;
+    };
+    std::deque<Entry> pending;  // in input order, the valid ones in the ring
+    std::vector<Puzzle_t> batch;
+    std::string line, text;
+    bool more = true;
+
+    auto emit_invalid = [&]{
+        for (; !pending.empty() && !pending.front().valid; pending.pop_front())
+        {
+            ++totals.puzzles;
+            auto token = pending.front().line.substr(0, pending.front().line.find_first_of(" \t"));
+            Emit(text, opt, token.empty() ? "-" : token, "invalid", 0, 0);
+        }
+    };
+
+    while (more || client->InFlight() != 0)
+    {
+        batch.clear();
+        while (more && client->InFlight() + batch.size() < client->Slots())
+        {
+            if (!(more = source.Next(line)))
+                break;
+
+            auto grid = Sudoku::ParsePuzzle(line);
+            pending.push_back({line, grid.has_value()});
+            if (grid)
+                batch.push_back(*grid);
+        }
+        client->Submit(batch.data(), batch.size());
+
+        emit_invalid();
+        bool alive = client->Collect([&](const Sudoku::ShmResult& result) {
+            ++totals.puzzles;
+            totals.solved += result.Solved();
+            Emit(text, opt, Sudoku::ToString(result.grid), Sudoku::StatusName(result.status),
+                 result.nodes, result.micros);
+            pending.pop_front();
+            emit_invalid();
+        });
+        if (!alive)
+        {
+            std::cerr << "sudokud went away\n";
+            return false;
+        }
+
+        if (text.size() >= (1u << 16))
+        {
+            out << text;
+            text.clear();
+        }
+    }
+    out << text;
+    return true;
+}
+
+} // End of anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!ParseOptions(argc, argv, opt))
+        return 1;
+
+    std::ifstream in_file;
+    if (opt.puzzles.empty() && opt.input != "-")
+    {
+        in_file.open(opt.input);
+        if (!in_file)
+        {
+            std::cerr << "cannot open " << opt.input << "\n";
+            return 1;
+        }
+    }
+    std::istream& in = opt.input == "-" ? std::cin : in_file;
+
+    std::ofstream out_file;
+    if (opt.output != "-")
+    {
+        out_file.open(opt.output);
+        if (!out_file)
+        {
+            std::cerr << "cannot create " << opt.output << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = opt.output == "-" ? std::cout : out_file;
+
+    auto start = Clock::now();
+    Source source(opt, in);
+    Totals totals;
+
+    if (!(opt.shm ? RunRing(opt, source, out, totals) : RunLines(opt, source, out, totals)))
+        return 1;
+    out.flush();
+    auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // The counters are asked for on a second connection once every
+    // reply is in, so that they include this client's puzzles
+    if (opt.stats)
+    {
+        std::string line;
+        auto stats = Sudoku::ConnectUnix(opt.socket);
+        if (stats.IsOpen() && Sudoku::SendAll(stats.Fd(), std::string(Sudoku::Daemon::StatsRequest) + "\n"))
+        {
+            ::shutdown(stats.Fd(), SHUT_WR);
+            Sudoku::LineReader stats_reader(stats.Fd());
+            if (stats_reader.Next(line))
+                std::cerr << line << "\n";
+        }
+
+        std::cerr << totals.puzzles << " puzzles in " << seconds << " s ("
+                  << (seconds > 0 ? static_cast<double>(totals.puzzles) / seconds : 0.0) << " puzzles/s), "
+                  << totals.solved << " solved\n";
+    }
+
+    return out ? 0 : 1;
+}
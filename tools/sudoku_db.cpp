@@ -0,0 +1,293 @@
+/* Converts puzzle files (one 81 character line each) to and from the
+   puzzle database format of src/puzzle_db.hpp, and reads single
+   records by number:
+
+       sudoku_db pack [-i FILE] -o DB [--solutions] [--ratings]
+                      [--hashes] [--block N]
+       sudoku_db unpack DB [-o FILE] [--solutions]
+       sudoku_db get DB INDEX...
+       sudoku_db info DB
+
+   pack solves (--solutions), grades (--ratings) and canonicalizes
+   (--hashes) every puzzle to fill the optional fields. unpack writes the
+   puzzles back as text, or their solutions with --solutions. get
+   prints the puzzle, then the fields the database has */
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "my_types.h"
+#include "canonical.hpp"
+#include "engines.hpp"
+#include "grader.hpp"
+#include "io.hpp"
+#include "mapped_file.hpp"
+#include "puzzle_db.hpp"
+
+namespace {
+
+void Usage(const char* argv0)
+{
+    std::cerr << "usage: " << argv0 << " pack [-i FILE] -o DB [--solutions] [--ratings] [--hashes] [--block N]\n"
+              << "       " << argv0 << " unpack DB [-o FILE] [--solutions]\n"
+              << "       " << argv0 << " get DB INDEX...\n"
+              << "       " << argv0 << " info DB\n";
+}
+
+int Pack(const std::vector<std::string>& args)
+{
+    std::string input = "-", output;
+    unsigned fields = 0;
+    std::size_t block = Sudoku::DbFormat::DefaultBlockRecords;
+
+    for (std::size_t i = 0; i < args.size(); ++i)
+    {
+        bool has_value = i + 1 < args.size();
+        if (args[i] == "--solutions")
+            fields |= Sudoku::DbField::Solution;
+        else if (args[i] == "--ratings")
+            fields |= Sudoku::DbField::Rating;
+        else if (args[i] == "--hashes")
+            fields |= Sudoku::DbField::Hash;
+        else if (args[i] == "-i" && has_value)
+            input = args[++i];
+        else if (args[i] == "-o" && has_value)
+            output = args[++i];
+        else if (args[i] == "--block" && has_value)
+            block = std::strtoul(args[++i].c_str(), nullptr, 10);
+        else
+            return -1;
+    }
+    if (output.empty())
+        return -1;
+
+    std::ifstream in_file;
+    if (input != "-")
+    {
+        in_file.open(input);
+        if (!in_file)
+        {
+            std::cerr << "cannot open " << input << "\n";
+            return 1;
+        }
+    }
+    std::istream& in = input == "-" ? std::cin : in_file;
+
+    std::ofstream out(output, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "cannot create " << output << "\n";
+        return 1;
+    }
+
+    Sudoku::DbWriter writer(out, fields, block);
+    std::uint64_t skipped = 0;
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        auto grid = Sudoku::ParsePuzzle(line);
+        if (!grid)
+        {
+            ++skipped;
+            continue;
+        }
+
+        Sudoku::DbRecord record;
+        record.puzzle = *grid;
+        if (fields & Sudoku::DbField::Solution)
+        {
+            auto result = Sudoku::SolveWith(Sudoku::Engine::MRV, *grid);
+            if (result.Solved())
+                record.solution = result.grid;
+        }
+        if (fields & Sudoku::DbField::Rating)
+            record.rating = Sudoku::GradePuzzle(*grid).rating;
+        if (fields & Sudoku::DbField::Hash)
+            record.hash = Sudoku::HashGrid(Sudoku::Canonicalize(*grid).grid);
+
+        writer.Add(record);
+    }
+
+    if (!writer.Finish())
+    {
+        std::cerr << "cannot write " << output << "\n";
+        return 1;
+    }
+
+    std::cerr << writer.Count() << " puzzles, " << writer.Bytes() << " bytes";
+    if (skipped != 0)
+        std::cerr << ", " << skipped << " invalid lines skipped";
+    std::cerr << "\n";
+    return 0;
+}
+
+/* Maps path and checks it is a database; db stays valid while file lives */
+bool Open(const std::string& path, Sudoku::MappedFile& file, std::optional<Sudoku::PuzzleDb>& db)
+{
+    file = Sudoku::MappedFile(path);
+    if (!file.IsOpen())
+    {
+        std::cerr << "cannot open " << path << "\n";
+        return false;
+    }
+
+    db = Sudoku::PuzzleDb::FromBytes(file.Data(), file.Size());
+    if (!db)
+    {
+        std::cerr << path << " is not a puzzle database\n";
+        return false;
+    }
+    return true;
+}
+
+int Unpack(const std::vector<std::string>& args)
+{
+    std::string path, output = "-";
+    bool solutions = false;
+
+    for (std::size_t i = 0; i < args.size(); ++i)
+    {
+        if (args[i] == "--solutions")
+            solutions = true;
+        else if (args[i] == "-o" && i + 1 < args.size())
+            output = args[++i];
+        else if (path.empty())
+            path = args[i];
+        else
+            return -1;
+    }
+    if (path.empty())
+        return -1;
+
+    Sudoku::MappedFile file;
+    std::optional<Sudoku::PuzzleDb> db;
+    if (!Open(path, file, db))
+        return 1;
+
+    if (solutions && !(db->Fields() & Sudoku::DbField::Solution))
+    {
+        std::cerr << path << " has no solutions\n";
+        return 1;
+    }
+
+    std::ofstream out_file;
+    if (output != "-")
+    {
+        out_file.open(output);
+        if (!out_file)
+        {
+            std::cerr << "cannot create " << output << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = output == "-" ? std::cout : out_file;
+
+    std::string text;
+    db->ForEach([&](std::size_t, const Sudoku::DbRecord& record) {
+        text += Sudoku::ToString(solutions ? record.solution : record.puzzle);
+        text += '\n';
+        if (text.size() >= (1u << 16))
+        {
+            out << text;
+            text.clear();
+        }
+    });
+    out << text;
+
+    return out ? 0 : 1;
+}
+
+int Get(const std::vector<std::string>& args)
+{
+    if (args.size() < 2)
+        return -1;
+
+    Sudoku::MappedFile file;
+    std::optional<Sudoku::PuzzleDb> db;
+    if (!Open(args[0], file, db))
+        return 1;
+
+    for (std::size_t i = 1; i < args.size(); ++i)
+    {
+        auto index = std::strtoull(args[i].c_str(), nullptr, 10);
+        auto record = db->Get(index);
+        if (!record)
+        {
+            std::cerr << "no record " << args[i] << "\n";
+            return 1;
+        }
+
+        std::cout << Sudoku::ToString(record->puzzle);
+        if (db->Fields() & Sudoku::DbField::Solution)
+            std::cout << ' ' << Sudoku::ToString(record->solution);
+        if (db->Fields() & Sudoku::DbField::Rating)
+            std::cout << ' ' << record->rating;
+        if (db->Fields() & Sudoku::DbField::Hash)
+            std::cout << ' ' << std::hex << record->hash << std::dec;
+        std::cout << '\n';
+    }
+    return 0;
+}
+
+int Info(const std::vector<std::string>& args)
+{
+    if (args.size() != 1)
+        return -1;
+
+    Sudoku::MappedFile file;
+    std::optional<Sudoku::PuzzleDb> db;
+    if (!Open(args[0], file, db))
+        return 1;
+
+    auto fields = db->Fields();
+    std::cout << "puzzles " << db->Size()
+              << "\nbytes " << file.Size()
+              << "\nbytes per puzzle " << (db->Size() ? static_cast<double>(file.Size()) / db->Size() : 0.0)
+              << "\nblock " << db->BlockRecords()
+              << "\nfields"
+              << (fields & Sudoku::DbField::Solution ? " solution" : "")
+              << (fields & Sudoku::DbField::Rating ? " rating" : "")
+              << (fields & Sudoku::DbField::Hash ? " hash" : "")
+              << "\n";
+    return 0;
+}
+
+} // End of anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    std::string command = argv[1];
+    std::vector<std::string> args(argv + 2, argv + argc);
+
+    int status = -1;
+    if (command == "pack")
+        status = Pack(args);
+    else if (command == "unpack")
+        status = Unpack(args);
+    else if (command == "get")
+        status = Get(args);
+    else if (command == "info")
+        status = Info(args);
+
+    if (status < 0)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+    return status;
+}
@@ -0,0 +1,368 @@
+/* Removes duplicate puzzles from a file of puzzles, one 81 character
+   line each, counting as duplicates the puzzles that are the same up to
+   symmetry and relabeling. The first occurrence is kept and the output
+   keeps the input order:
+
+       sudoku_dedupe -i FILE [-o FILE] [-j THREADS] [--memory-mb N]
+                     [--tmp DIR]
+
+   The input may be far larger than memory. A first pass canonicalizes
+   the puzzles on every core and collects (canonical hash, line) pairs,
+   spilling them to DIR as sorted runs whenever --memory-mb fills up. A
+   k-way merge of the runs finds the lines to drop, which are sorted
+   the same way, and a second pass over the input copies every line not
+   dropped. Lines that are not puzzles are dropped and counted.
+
+   Puzzles are told apart by the 64 bit hash of their canonical grid:
+   for 50 million distinct puzzles the chance that two share a hash is
+   below one in ten thousand */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "my_types.h"
+#include "canonical.hpp"
+#include "io.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+struct Options
+{
+    std::string input;
+    std::string output = "-";
+    std::string tmp;
+    std::size_t threads = 0;
+    std::size_t memory_mb = 1024;
+};
+
+bool ParseOptions(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        std::string value = has_value ? argv[i + 1] : "";
+
+        if (arg == "-i" && has_value)
+            opt.input = value, ++i;
+        else if (arg == "-o" && has_value)
+            opt.output = value, ++i;
+        else if (arg == "--tmp" && has_value)
+            opt.tmp = value, ++i;
+        else if (arg == "-j" && has_value)
+            opt.threads = std::strtoul(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--memory-mb" && has_value)
+            opt.memory_mb = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10)), ++i;
+        else
+        {
+            opt.input.clear();
+            break;
+        }
+    }
+
+    if (opt.input.empty() || opt.input == "-")
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " -i FILE [-o FILE] [-j THREADS] [--memory-mb N] [--tmp DIR]\n"
+                     "the input is read twice, so it must be a file\n";
+        return false;
+    }
+
+    if (opt.tmp.empty())
+        opt.tmp = std::filesystem::temp_directory_path().string();
+
+    return true;
+}
+
+/* Sort key: (canonical hash, line) in the first pass, (line, 0) for the
+   lines to drop */
+struct Entry
+{
+    std::uint64_t key;
+    std::uint64_t line;
+
+    bool operator<(const Entry& other) const noexcept
+    {
+        return key != other.key ? key < other.key : line < other.line;
+    }
+};
+
+/* Entries sorted in memory up to a capacity, then spilled to disk as
+   sorted runs. Merge() replays everything in order */
+class RunSet
+{
+public:
+    RunSet(std::string directory, std::size_t capacity)
+        : dir{std::move(directory)}, limit{std::max<std::size_t>(1, capacity)}
+    {
+        std::random_device rd;
+        tag = std::to_string(rd()) + std::to_string(rd());
+    }
+
+    RunSet(const RunSet&) = delete;
+    RunSet& operator=(const RunSet&) = delete;
+
+    ~RunSet()
+    {
+        std::error_code ec;
+        for (const auto& path : runs)
+            std::filesystem::remove(path, ec);
+    }
+
+    bool Add(const Entry& entry)
+    {
+        // Grow by hand so that the buffer never holds more than limit
+        if (buffer.size() == buffer.capacity())
+            buffer.reserve(std::min(limit, std::max<std::size_t>(1024, 2 * buffer.capacity())));
+        buffer.push_back(entry);
+        return buffer.size() < limit || Spill();
+    }
+
+    std::size_t Runs() const noexcept {return runs.size();}
+
+    /* Calls f(entry) for every entry in sorted order, reading each run
+       through memory / runs bytes. Entries still in memory are sorted in
+       place if they fit in memory, and spilled first otherwise, so the
+       merge never holds more than memory bytes whatever f allocates.
+       Returns false on an I/O error */
+    template <typename F>
+    bool Merge(std::size_t memory, F&& f)
+    {
+        if (runs.empty() && buffer.capacity() * sizeof(Entry) <= memory)
+        {
+            std::sort(buffer.begin(), buffer.end());
+            for (const auto& entry : buffer)
+                f(entry);
+            return true;
+        }
+
+        if (!buffer.empty() && !Spill())
+            return false;
+        buffer.clear();
+        buffer.shrink_to_fit();
+
+        auto per_run = std::max<std::size_t>(256, memory / sizeof(Entry) / runs.size());
+        std::vector<Reader> readers(runs.size());
+        using Head = std::pair<Entry, std::size_t>;
+        auto later = [](const Head& a, const Head& b) { return b.first < a.first; };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+
+        for (std::size_t r = 0; r < runs.size(); ++r)
+        {
+            readers[r].in.open(runs[r], std::ios::binary);
+            readers[r].block.resize(per_run);
+            Entry entry;
+            if (readers[r].Next(entry))
+                heads.push({entry, r});
+            else if (!readers[r].in.eof())
+                return false;
+        }
+
+        while (!heads.empty())
+        {
+            auto [entry, r] = heads.top();
+            heads.pop();
+            f(entry);
+
+            if (readers[r].Next(entry))
+                heads.push({entry, r});
+        }
+
+        return std::all_of(readers.begin(), readers.end(), [](const Reader& reader) { return reader.in.eof(); });
+    }
+
+private:
+    struct Reader
+    {
+        std::ifstream in;
+        std::vector<Entry> block;
+        std::size_t pos = 0, size = 0;
+
+        bool Next(Entry& entry)
+        {
+            if (pos == size)
+            {
+                in.read(reinterpret_cast<char*>(block.data()),
+                        static_cast<std::streamsize>(block.size() * sizeof(Entry)));
+                size = static_cast<std::size_t>(in.gcount()) / sizeof(Entry);
+                pos = 0;
+                if (size == 0)
+                    return false;
+            }
+            entry = block[pos++];
+            return true;
+        }
+    };
+
+    bool Spill()
+    {
+        std::sort(buffer.begin(), buffer.end());
+
+        auto path = (std::filesystem::path(dir) /
+                     ("sudoku_dedupe." + tag + "." + std::to_string(runs.size()))).string();
+        runs.push_back(path);
+
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(buffer.data()),
+                  static_cast<std::streamsize>(buffer.size() * sizeof(Entry)));
+        buffer.clear();
+
+        if (!out)
+            std::cerr << "cannot write " << path << "\n";
+        return static_cast<bool>(out);
+    }
+
+    std::string dir;
+    std::string tag;
+    std::size_t limit;
+    std::vector<Entry> buffer;
+    std::vector<std::string> runs;
+};
+
+constexpr std::size_t ChunkLines = 1 << 14;
+constexpr std::size_t TaskLines = 256;
+
+} // End of anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!ParseOptions(argc, argv, opt))
+        return 1;
+
+    std::ifstream in(opt.input);
+    if (!in)
+    {
+        std::cerr << "cannot open " << opt.input << "\n";
+        return 1;
+    }
+
+    auto memory = opt.memory_mb << 20;
+    Sudoku::ThreadPool pool(opt.threads);
+
+    // First pass: canonical hash of every puzzle, one chunk at a time
+    RunSet hashes(opt.tmp, memory / sizeof(Entry));
+    std::uint64_t line_no = 0, puzzles = 0, invalid = 0;
+    std::vector<std::string> lines;
+    std::vector<Entry> entries;
+    std::string line;
+
+    for (bool more = true; more; )
+    {
+        lines.clear();
+        while (lines.size() < ChunkLines && (more = static_cast<bool>(std::getline(in, line))))
+            lines.push_back(line);
+
+        entries.assign(lines.size(), Entry{0, 0});
+        for (std::size_t first = 0; first < lines.size(); first += TaskLines)
+            pool.Submit([&, first]{
+                auto last = std::min(lines.size(), first + TaskLines);
+                for (std::size_t k = first; k < last; ++k)
+                {
+                    auto grid = Sudoku::ParsePuzzle(lines[k]);
+                    entries[k].line = grid ? line_no + k : ~std::uint64_t{0};
+                    if (grid)
+                        entries[k].key = Sudoku::HashGrid(Sudoku::Canonicalize(*grid).grid);
+                }
+            });
+        pool.Wait();
+
+        for (const auto& entry : entries)
+        {
+            if (entry.line == ~std::uint64_t{0})
+            {
+                ++invalid;
+                continue;
+            }
+
+            ++puzzles;
+            if (!hashes.Add(entry))
+                return 1;
+        }
+        line_no += lines.size();
+    }
+
+    // Every line after the first of its hash goes, and so do the lines
+    // that are not puzzles. The merge and the drops share the budget
+    RunSet drops(opt.tmp, memory / 2 / sizeof(Entry));
+    std::uint64_t duplicates = 0;
+    bool first = true, ok = true;
+    Entry previous{0, 0};
+
+    if (!hashes.Merge(memory / 2, [&](const Entry& entry) {
+            if (!first && entry.key == previous.key)
+            {
+                ++duplicates;
+                ok = ok && drops.Add({entry.line, 0});
+            }
+            previous = entry;
+            first = false;
+        }) || !ok)
+    {
+        std::cerr << "cannot merge the runs in " << opt.tmp << "\n";
+        return 1;
+    }
+    auto runs = hashes.Runs() + drops.Runs();
+
+    // Second pass: copy the lines kept, in input order
+    in.clear();
+    in.seekg(0);
+
+    std::ofstream out_file;
+    if (opt.output != "-")
+    {
+        out_file.open(opt.output);
+        if (!out_file)
+        {
+            std::cerr << "cannot create " << opt.output << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = opt.output == "-" ? std::cout : out_file;
+
+    std::uint64_t current = 0;
+    std::string text;
+    auto copy_until = [&](std::uint64_t end) {
+        for (; current < end && std::getline(in, line); ++current)
+            if (Sudoku::ParsePuzzle(line))
+            {
+                text += line;
+                text += '\n';
+                if (text.size() >= (1u << 16))
+                {
+                    out << text;
+                    text.clear();
+                }
+            }
+    };
+
+    if (!drops.Merge(memory, [&](const Entry& entry) {
+            copy_until(entry.key);
+            std::getline(in, line); // the duplicate
+            ++current;
+        }))
+    {
+        std::cerr << "cannot merge the runs in " << opt.tmp << "\n";
+        return 1;
+    }
+    copy_until(line_no);
+    out << text;
+    out.flush();
+
+    std::cerr << puzzles << " puzzles, " << puzzles - duplicates << " unique, " << duplicates
+              << " duplicates (" << (puzzles ? 100.0 * static_cast<double>(duplicates) / static_cast<double>(puzzles) : 0.0)
+              << "%), " << invalid << " invalid lines dropped, " << runs << " runs spilled\n";
+
+    return out ? 0 : 1;
+}
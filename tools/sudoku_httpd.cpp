@@ -0,0 +1,617 @@
+/* Local HTTP/1.1 JSON service over the solver core, for callers that
+   would otherwise run a command per puzzle:
+
+       sudoku_httpd [--host ADDR] [--port N] [--engine NAME]
+                    [--max-nodes N] [--timeout-ms N] [--cache-mb N]
+                    [--generate-threads N] [--max-connections N]
+
+   It listens on 127.0.0.1:8080 by default and answers, to GET or POST:
+
+       /solve?puzzle=P          {"status", "solution", "nodes", "micros"}
+       /count?puzzle=P&limit=N  {"count", "limit", "exact", "status"}
+       /generate?difficulty=D   {"puzzle", "difficulty", "rating", ...}
+       /rate?puzzle=P           {"valid", "rating", "hardest", ...}
+       /metrics                 Prometheus text format
+
+   The puzzle may also come as the request body: the bare 81 characters,
+   a form (puzzle=P) or JSON ({"puzzle": "P"}). D is easy, intermediate
+   or hard. Counting stops at limit solutions (1000 by default, at most
+   MaxCountLimit). /solve and /count run under --max-nodes and
+   --timeout-ms; a count they cut short is not exact and has a status.
+
+   Connections are kept alive and may pipeline requests: every request
+   already received is answered before the replies go out in one write.
+   Each connection has its own thread; past --max-connections new ones
+   get a 503. SIGINT or SIGTERM stops the server */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "my_types.h"
+#include "engines.hpp"
+#include "generator.hpp"
+#include "grader.hpp"
+#include "http.hpp"
+#include "io.hpp"
+#include "search.hpp"
+#include "socket.hpp"
+#include "solution_cache.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::uint64_t MaxCountLimit = 1000000;
+constexpr int IdleTimeoutSeconds = 60;
+
+struct Options
+{
+    std::string host = "127.0.0.1";
+    std::uint16_t port = 8080;
+    Sudoku::Engine engine = Sudoku::Engine::MRV;
+    std::uint64_t max_nodes = 0;
+    std::uint64_t timeout_ms = 0;
+    std::size_t cache_mb = 64; // 0: no cache
+    std::size_t generate_threads = 1;
+    std::size_t max_connections = 256;
+};
+
+bool ParseOptions(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        std::string value = has_value ? argv[i + 1] : "";
+
+        if (arg == "--host" && has_value)
+            opt.host = value, ++i;
+        else if (arg == "--port" && has_value)
+            opt.port = static_cast<std::uint16_t>(std::strtoul(value.c_str(), nullptr, 10)), ++i;
+        else if (arg == "--max-nodes" && has_value)
+            opt.max_nodes = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--timeout-ms" && has_value)
+            opt.timeout_ms = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--cache-mb" && has_value)
+            opt.cache_mb = std::strtoul(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--generate-threads" && has_value)
+            opt.generate_threads = std::strtoul(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--max-connections" && has_value)
+            opt.max_connections = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10)), ++i;
+        else if (arg == "--engine" && has_value)
+        {
+            auto engine = Sudoku::EngineFromName(value);
+            if (!engine)
+            {
+                std::cerr << "unknown engine: " << value << "\n";
+                return false;
+            }
+            opt.engine = *engine;
+            ++i;
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--host ADDR] [--port N] [--engine naive|mrv|random-mrv|dlx]"
+                         " [--max-nodes N] [--timeout-ms N] [--cache-mb N]"
+                         " [--generate-threads N] [--max-connections N]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+enum Endpoint : std::size_t {Solve, Count, Generate, Rate, Metrics, Other, EndpointCount};
+
+const char* const EndpointNames[EndpointCount] = {"solve", "count", "generate", "rate", "metrics", "other"};
+
+Endpoint EndpointOf(const std::string& path) noexcept
+{
+    for (std::size_t e = 0; e < Other; ++e)
+        if (path.size() == std::strlen(EndpointNames[e]) + 1 && path.compare(1, std::string::npos, EndpointNames[e]) == 0)
+            return static_cast<Endpoint>(e);
+    return Other;
+}
+
+/* Request latency with the bucket bounds Prometheus clients usually
+   pick, from 50 µs to 10 s. Lock free, every connection thread adds to
+   the same one */
+class LatencyHistogram
+{
+public:
+    static constexpr std::array<double, 16> Bounds = {
+        0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+        0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 10.0};
+
+    void Add(Clock::duration elapsed) noexcept
+    {
+        auto seconds = std::chrono::duration<double>(elapsed).count();
+        auto k = static_cast<std::size_t>(std::lower_bound(Bounds.begin(), Bounds.end(), seconds) - Bounds.begin());
+        counts[k].fetch_add(1, std::memory_order_relaxed);
+        sum_ns.fetch_add(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                         std::memory_order_relaxed);
+    }
+
+    /* Writes the _bucket, _sum and _count series, buckets cumulative */
+    void Write(std::ostream& out, const std::string& name, const std::string& labels) const
+    {
+        std::uint64_t total = 0;
+        for (std::size_t k = 0; k <= Bounds.size(); ++k)
+        {
+            total += counts[k].load(std::memory_order_relaxed);
+            out << name << "_bucket{" << labels << ",le=\"";
+            if (k < Bounds.size())
+                out << Bounds[k];
+            else
+                out << "+Inf";
+            out << "\"} " << total << '\n';
+        }
+        out << name << "_sum{" << labels << "} " << static_cast<double>(sum_ns.load(std::memory_order_relaxed)) * 1e-9 << '\n'
+            << name << "_count{" << labels << "} " << total << '\n';
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, Bounds.size() + 1> counts{};
+    std::atomic<std::uint64_t> sum_ns{0};
+};
+
+constexpr std::array<int, 9> StatusCodes = {200, 400, 404, 405, 413, 422, 500, 503, 0};
+
+std::size_t CodeIndex(int code) noexcept
+{
+    auto it = std::find(StatusCodes.begin(), StatusCodes.end() - 1, code);
+    return static_cast<std::size_t>(it - StatusCodes.begin()); // the last slot counts the others
+}
+
+struct Server
+{
+    Options opt;
+    Clock::time_point start = Clock::now();
+    std::unique_ptr<Sudoku::SolutionCache> cache;
+
+    std::array<std::array<std::atomic<std::uint64_t>, StatusCodes.size()>, EndpointCount> requests{};
+    std::array<LatencyHistogram, EndpointCount> latency;
+    std::array<std::atomic<std::uint64_t>, 4> solved{};  // indexed by SolveStatus
+    std::atomic<std::uint64_t> generated{0};
+    std::atomic<std::uint64_t> connections{0};
+    std::atomic<std::uint64_t> open_connections{0};
+    std::atomic<std::uint64_t> refused_connections{0};
+};
+
+struct Response
+{
+    int status = 200;
+    std::string body;
+    std::string content_type = "application/json";
+};
+
+Response Error(int status, const std::string& message)
+{
+    return {status, "{\"error\":\"" + message + "\"}\n"};
+}
+
+std::string DifficultyName(Difficulty dif)
+{
+    switch (dif)
+    {
+        case Difficulty::Easy:
+            return "easy";
+        case Difficulty::Intermediate:
+            return "intermediate";
+        case Difficulty::Hard:
+            return "hard";
+    }
+    return "";
+}
+
+std::optional<Difficulty> DifficultyFromName(const std::string& name)
+{
+    for (auto dif : {Difficulty::Easy, Difficulty::Intermediate, Difficulty::Hard})
+        if (DifficultyName(dif) == name)
+            return dif;
+    return {};
+}
+
+/* The puzzle of a request: the puzzle parameter of the query, or the
+   body as JSON, as a form or as the bare grid */
+std::optional<Puzzle_t> PuzzleOf(const Sudoku::HttpRequest& request)
+{
+    if (auto value = Sudoku::QueryParam(request.query, "puzzle"))
+        return Sudoku::ParsePuzzle(*value);
+
+    std::string_view body = request.body;
+    auto first = body.find_first_not_of(" \t\r\n");
+    if (first == std::string_view::npos)
+        return {};
+    body.remove_prefix(first);
+
+    if (body[0] == '{')
+    {
+        auto key = body.find("\"puzzle\"");
+        auto open = key == std::string_view::npos ? key : body.find('"', body.find(':', key + 8));
+        if (open == std::string_view::npos)
+            return {};
+        auto close = body.find('"', open + 1);
+        return Sudoku::ParsePuzzle(body.substr(open + 1, close == std::string_view::npos ? 0 : close - open - 1));
+    }
+
+    if (body.compare(0, 7, "puzzle=") == 0)
+        if (auto value = Sudoku::QueryParam(body, "puzzle"))
+            return Sudoku::ParsePuzzle(*value);
+
+    return Sudoku::ParsePuzzle(body);
+}
+
+/* The budget of one request, from --max-nodes and --timeout-ms */
+Sudoku::SolveOptions RequestBudget(const Options& opt)
+{
+    Sudoku::SolveOptions budget;
+    budget.max_nodes = opt.max_nodes;
+    if (opt.timeout_ms != 0)
+        budget.Timeout(std::chrono::milliseconds(opt.timeout_ms));
+    return budget;
+}
+
+Response HandleSolve(const Sudoku::HttpRequest& request, Server& server)
+{
+    auto grid = PuzzleOf(request);
+    if (!grid)
+        return Error(400, "expected an 81 character puzzle");
+
+    auto budget = RequestBudget(server.opt);
+    auto start = Clock::now();
+    auto result = Sudoku::SolveCached(server.cache.get(), server.opt.engine, *grid, budget);
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    server.solved[static_cast<std::size_t>(result.status)].fetch_add(1, std::memory_order_relaxed);
+
+    std::ostringstream out;
+    out << "{\"status\":\"" << Sudoku::StatusName(result.status) << '"';
+    if (result.Solved())
+        out << ",\"solution\":\"" << Sudoku::ToString(result.grid) << '"';
+    out << ",\"nodes\":" << result.nodes << ",\"micros\":" << micros << "}\n";
+    return {200, out.str()};
+}
+
+/* Counts under the same budget as /solve. A count the budget cut short
+   is only a lower bound: it is not exact and carries the status */
+Response HandleCount(const Sudoku::HttpRequest& request, Server& server)
+{
+    auto grid = PuzzleOf(request);
+    if (!grid)
+        return Error(400, "expected an 81 character puzzle");
+
+    std::uint64_t limit = 1000;
+    if (auto value = Sudoku::QueryParam(request.query, "limit"))
+        limit = std::strtoull(value->c_str(), nullptr, 10);
+    if (limit == 0 || limit > MaxCountLimit)
+        return Error(400, "limit must be between 1 and " + std::to_string(MaxCountLimit));
+
+    Sudoku::SearchState state(*grid);
+    state.SetBudget(Sudoku::Budget{RequestBudget(server.opt)});
+
+    std::uint64_t count = 0;
+    while (count < limit && state.Next())
+        ++count;
+
+    std::ostringstream out;
+    out << "{\"count\":" << count << ",\"limit\":" << limit
+        << ",\"exact\":" << (count < limit && !state.Stopped() ? "true" : "false");
+    if (state.Stopped())
+        out << ",\"status\":\"" << Sudoku::StatusName(state.Failure()) << '"';
+    out << "}\n";
+    return {200, out.str()};
+}
+
+Response HandleGenerate(const Sudoku::HttpRequest& request, Server& server)
+{
+    auto name = Sudoku::QueryParam(request.query, "difficulty").value_or("easy");
+    auto dif = DifficultyFromName(name);
+    if (!dif)
+        return Error(400, "difficulty must be easy, intermediate or hard");
+
+    Sudoku::GenerateOptions options;
+    options.band = Sudoku::BandFor(*dif);
+    options.threads = server.opt.generate_threads;
+    auto result = Sudoku::GenerateRated(options);
+    server.generated.fetch_add(1, std::memory_order_relaxed);
+
+    std::size_t clues = 0;
+    for (const auto& row : result.grid)
+        clues += static_cast<std::size_t>(std::count_if(row.begin(), row.end(), [](std::size_t v) { return v != 0; }));
+
+    std::ostringstream out;
+    out << "{\"puzzle\":\"" << Sudoku::ToString(result.grid) << '"'
+        << ",\"difficulty\":\"" << DifficultyName(*dif) << '"'
+        << ",\"rating\":" << result.grade.rating
+        << ",\"hardest\":\"" << Sudoku::TechniqueName(result.grade.hardest) << '"'
+        << ",\"clues\":" << clues
+        << ",\"in_band\":" << (result.in_band ? "true" : "false") << "}\n";
+    return {200, out.str()};
+}
+
+Response HandleRate(const Sudoku::HttpRequest& request)
+{
+    auto grid = PuzzleOf(request);
+    if (!grid)
+        return Error(400, "expected an 81 character puzzle");
+
+    auto grade = Sudoku::GradePuzzle(*grid);
+
+    std::ostringstream out;
+    out << "{\"valid\":" << (grade.valid ? "true" : "false")
+        << ",\"solved_by_logic\":" << (grade.solved ? "true" : "false")
+        << ",\"rating\":" << grade.rating
+        << ",\"hardest\":\"" << Sudoku::TechniqueName(grade.hardest) << '"'
+        << ",\"difficulty\":";
+
+    std::string difficulty = "null";
+    for (auto dif : {Difficulty::Easy, Difficulty::Intermediate, Difficulty::Hard})
+        if (grade.valid && grade.solved && Sudoku::BandFor(dif).Contains(grade.hardest))
+            difficulty = '"' + DifficultyName(dif) + '"';
+    out << difficulty << ",\"steps\":{";
+
+    bool first = true;
+    for (std::size_t t = 0; t < Sudoku::TechniqueCount; ++t)
+        if (grade.steps[t] != 0)
+        {
+            out << (first ? "" : ",") << '"' << Sudoku::TechniqueName(static_cast<Sudoku::Technique>(t))
+                << "\":" << grade.steps[t];
+            first = false;
+        }
+    out << "}}\n";
+    return {200, out.str()};
+}
+
+Response HandleMetrics(Server& server)
+{
+    auto load = [](const std::atomic<std::uint64_t>& a) { return a.load(std::memory_order_relaxed); };
+    std::ostringstream out;
+
+    out << "# HELP sudoku_http_requests_total Requests answered, by endpoint and status code.\n"
+           "# TYPE sudoku_http_requests_total counter\n";
+    for (std::size_t e = 0; e < EndpointCount; ++e)
+        for (std::size_t c = 0; c < StatusCodes.size(); ++c)
+            if (auto n = load(server.requests[e][c]); n != 0)
+                out << "sudoku_http_requests_total{endpoint=\"" << EndpointNames[e] << "\",code=\""
+                    << (StatusCodes[c] != 0 ? std::to_string(StatusCodes[c]) : "other") << "\"} " << n << '\n';
+
+    out << "# HELP sudoku_http_request_duration_seconds Time from a parsed request to its response.\n"
+           "# TYPE sudoku_http_request_duration_seconds histogram\n";
+    for (std::size_t e = 0; e < EndpointCount; ++e)
+        server.latency[e].Write(out, "sudoku_http_request_duration_seconds",
+                                std::string("endpoint=\"") + EndpointNames[e] + '"');
+
+    out << "# HELP sudoku_puzzles_solved_total Puzzles through /solve, by outcome.\n"
+           "# TYPE sudoku_puzzles_solved_total counter\n";
+    for (std::size_t s = 0; s < server.solved.size(); ++s)
+        out << "sudoku_puzzles_solved_total{status=\"" << Sudoku::StatusName(static_cast<Sudoku::SolveStatus>(s))
+            << "\"} " << load(server.solved[s]) << '\n';
+
+    out << "# HELP sudoku_puzzles_generated_total Puzzles through /generate.\n"
+           "# TYPE sudoku_puzzles_generated_total counter\n"
+           "sudoku_puzzles_generated_total " << load(server.generated) << '\n';
+
+    if (server.cache)
+    {
+        auto c = server.cache->Counters();
+        out << "# HELP sudoku_cache_hits_total Solution cache hits.\n"
+               "# TYPE sudoku_cache_hits_total counter\n"
+               "sudoku_cache_hits_total " << c.hits << '\n'
+            << "# HELP sudoku_cache_misses_total Solution cache misses.\n"
+               "# TYPE sudoku_cache_misses_total counter\n"
+               "sudoku_cache_misses_total " << c.misses << '\n'
+            << "# HELP sudoku_cache_entries Puzzles held by the solution cache.\n"
+               "# TYPE sudoku_cache_entries gauge\n"
+               "sudoku_cache_entries " << c.entries << '\n';
+    }
+
+    out << "# HELP sudoku_http_connections_total Connections accepted.\n"
+           "# TYPE sudoku_http_connections_total counter\n"
+           "sudoku_http_connections_total " << load(server.connections) << '\n'
+        << "# HELP sudoku_http_connections_refused_total Connections turned away past --max-connections.\n"
+           "# TYPE sudoku_http_connections_refused_total counter\n"
+           "sudoku_http_connections_refused_total " << load(server.refused_connections) << '\n'
+        << "# HELP sudoku_http_connections_open Connections open now.\n"
+           "# TYPE sudoku_http_connections_open gauge\n"
+           "sudoku_http_connections_open " << load(server.open_connections) << '\n'
+        << "# HELP sudoku_http_uptime_seconds Time since the server started.\n"
+           "# TYPE sudoku_http_uptime_seconds gauge\n"
+           "sudoku_http_uptime_seconds " << std::chrono::duration<double>(Clock::now() - server.start).count() << '\n';
+
+    return {200, out.str(), "text/plain; version=0.0.4"};
+}
+
+/* Answers request, appending the response to out */
+void Handle(const Sudoku::HttpRequest& request, Server& server, std::string& out)
+{
+    auto start = Clock::now();
+    auto endpoint = EndpointOf(request.path);
+
+    Response response;
+    if (endpoint == Other)
+        response = Error(404, "no such endpoint");
+    else if (request.method != "GET" && request.method != "POST")
+        response = Error(405, "use GET or POST");
+    else if (endpoint == Solve)
+        response = HandleSolve(request, server);
+    else if (endpoint == Count)
+        response = HandleCount(request, server);
+    else if (endpoint == Generate)
+        response = HandleGenerate(request, server);
+    else if (endpoint == Rate)
+        response = HandleRate(request);
+    else
+        response = HandleMetrics(server);
+
+    Sudoku::AppendHttpResponse(out, response.status, response.content_type, response.body, request.keep_alive);
+
+    server.requests[endpoint][CodeIndex(response.status)].fetch_add(1, std::memory_order_relaxed);
+    server.latency[endpoint].Add(Clock::now() - start);
+}
+
+/* Serves one connection until the client closes it, asks to close it,
+   sends something that is not HTTP or stays idle too long */
+void Serve(int fd, Server& server)
+{
+    timeval idle{IdleTimeoutSeconds, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof idle);
+
+    std::vector<char> chunk(1 << 16);
+    std::string in, out;
+    bool open = true;
+
+    while (open)
+    {
+        auto got = ::recv(fd, chunk.data(), chunk.size(), 0);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        in.append(chunk.data(), static_cast<std::size_t>(got));
+
+        // Every complete request received so far, answered in order
+        std::size_t pos = 0;
+        while (open)
+        {
+            Sudoku::HttpRequest request;
+            std::size_t consumed = 0;
+            auto parse = Sudoku::ParseHttpRequest(std::string_view(in).substr(pos), request, consumed);
+            if (parse == Sudoku::HttpParse::Incomplete)
+                break;
+
+            if (parse != Sudoku::HttpParse::Done)
+            {
+                auto status = parse == Sudoku::HttpParse::TooLarge ? 413 : 400;
+                auto response = Error(status, parse == Sudoku::HttpParse::TooLarge ? "request too large" : "malformed request");
+                Sudoku::AppendHttpResponse(out, status, response.content_type, response.body, false);
+                server.requests[Other][CodeIndex(status)].fetch_add(1, std::memory_order_relaxed);
+                open = false;
+                break;
+            }
+
+            pos += consumed;
+            Handle(request, server, out);
+            open = request.keep_alive;
+        }
+        in.erase(0, pos);
+
+        if (!out.empty() && !Sudoku::SendAll(fd, out))
+            break;
+        out.clear();
+    }
+
+    // The descriptor is closed later by the accept loop, the client
+    // should see the end of the stream now
+    ::shutdown(fd, SHUT_WR);
+}
+
+std::atomic<bool> stop_requested{false};
+
+extern "C" void OnSignal(int)
+{
+    stop_requested.store(true);
+}
+
+} // End of anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+    Server server;
+    if (!ParseOptions(argc, argv, server.opt))
+        return 1;
+
+    auto listener = Sudoku::ListenTcp(server.opt.port, server.opt.host);
+    if (!listener.IsOpen())
+    {
+        std::cerr << "cannot listen on " << server.opt.host << ":" << server.opt.port << ": "
+                  << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+
+    if (server.opt.cache_mb != 0)
+        server.cache = std::make_unique<Sudoku::SolutionCache>(server.opt.cache_mb << 20);
+
+    // The socket stays open until its slot is reaped, so that shutdown()
+    // at exit never hits a descriptor number reused by another file
+    struct Client
+    {
+        std::shared_ptr<Sudoku::Socket> socket;
+        std::shared_ptr<std::atomic<bool>> done;
+        std::thread thread;
+    };
+    std::vector<Client> clients;
+
+    std::cerr << "sudoku_httpd listening on http://" << server.opt.host << ":" << Sudoku::LocalPort(listener) << "\n";
+
+    while (!stop_requested.load())
+    {
+        pollfd pfd{listener.Fd(), POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 250);
+
+        for (auto it = clients.begin(); it != clients.end(); )
+            if (it->done->load())
+            {
+                it->thread.join();
+                it = clients.erase(it);
+            }
+            else
+                ++it;
+
+        if (ready <= 0)
+            continue;
+
+        auto socket = std::make_shared<Sudoku::Socket>(::accept(listener.Fd(), nullptr, nullptr));
+        if (!socket->IsOpen())
+            continue;
+
+        if (clients.size() >= server.opt.max_connections)
+        {
+            std::string out;
+            auto response = Error(503, "too many connections");
+            Sudoku::AppendHttpResponse(out, 503, response.content_type, response.body, false);
+            Sudoku::SendAll(socket->Fd(), out);
+            server.refused_connections.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        server.connections.fetch_add(1, std::memory_order_relaxed);
+        server.open_connections.fetch_add(1, std::memory_order_relaxed);
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        std::thread thread([fd = socket->Fd(), done, &server]{
+            Serve(fd, server);
+            server.open_connections.fetch_sub(1, std::memory_order_relaxed);
+            done->store(true);
+        });
+        clients.push_back({std::move(socket), std::move(done), std::move(thread)});
+    }
+
+    listener.Close();
+    for (auto& client : clients)
+    {
+        ::shutdown(client.socket->Fd(), SHUT_RDWR);
+        client.thread.join();
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+/* Generates the puzzle book embedded in the game (assets/book.bin).
+
+   Every puzzle comes from GenerateRated with the band of its
+   difficulty and is kept only if it landed inside the band. Puzzles
+   equivalent to one already kept (same canonical form) are dropped, as
+   the game shows random variants anyway. Each section is sorted by
+   rating, then by clue count (more clues first):
+
+       sudoku_mkbook [-n PER_DIFFICULTY] [-o FILE] [--timeout-ms N]
+                     [--seed N]
+
+   The build regenerates assets/book.bin with `make book`. */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "my_types.h"
+#include "book.hpp"
+#include "canonical.hpp"
+#include "generator.hpp"
+#include "grader.hpp"
+#include "io.hpp"
+
+namespace {
+
+struct Options
+{
+    std::size_t count = 2000;
+    std::string output = "book.bin";
+    std::uint64_t timeout_ms = 1000;
+    std::uint64_t seed = 0;
+};
+
+bool ParseOptions(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        std::string value = has_value ? argv[i + 1] : "";
+
+        if (arg == "-n" && has_value)
+            opt.count = std::strtoul(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "-o" && has_value)
+            opt.output = value, ++i;
+        else if (arg == "--timeout-ms" && has_value)
+            opt.timeout_ms = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--seed" && has_value)
+            opt.seed = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [-n PER_DIFFICULTY] [-o FILE] [--timeout-ms N] [--seed N]\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+struct Entry
+{
+    Puzzle_t grid;
+    double rating;
+    std::size_t clues;
+};
+
+std::size_t Clues(const Puzzle_t& grid)
+{
+    std::size_t clues = 0;
+    for (const auto& row : grid)
+        for (auto num : row)
+            clues += num != 0;
+    return clues;
+}
+
+} // End of anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!ParseOptions(argc, argv, opt))
+        return 1;
+
+    std::array<std::vector<Puzzle_t>, Sudoku::BookFormat::Sections> sections;
+    std::uint64_t seed = opt.seed;
+
+    for (auto dif : {Difficulty::Easy, Difficulty::Intermediate, Difficulty::Hard})
+    {
+        Sudoku::GenerateOptions options;
+        options.band = Sudoku::BandFor(dif);
+        options.timeout = std::chrono::milliseconds(opt.timeout_ms);
+
+        std::vector<Entry> entries;
+        std::set<std::string> seen;
+        std::size_t misses = 0;
+
+        while (entries.size() < opt.count)
+        {
+            if (seed != 0)
+                options.seed = seed++;
+
+            auto result = Sudoku::GenerateRated(options);
+            if (!result.in_band ||
+                !seen.insert(Sudoku::ToString(Sudoku::Canonicalize(result.grid).grid)).second)
+            {
+                ++misses;
+                continue;
+            }
+
+            entries.push_back({result.grid, result.grade.rating, Clues(result.grid)});
+
+            if (entries.size() % 100 == 0)
+                std::cerr << "\rdifficulty " << static_cast<int>(dif) << ": "
+                          << entries.size() << "/" << opt.count << std::flush;
+        }
+
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return a.rating != b.rating ? a.rating < b.rating : a.clues > b.clues;
+        });
+
+        auto& section = sections[static_cast<std::size_t>(dif)];
+        for (const auto& entry : entries)
+            section.push_back(entry.grid);
+
+        std::cerr << "\rdifficulty " << static_cast<int>(dif) << ": " << entries.size()
+                  << " puzzles, " << misses << " misses or duplicates\n";
+    }
+
+    auto bytes = Sudoku::PackBook(sections);
+
+    std::ofstream out(opt.output, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!out)
+    {
+        std::cerr << "cannot write " << opt.output << "\n";
+        return 1;
+    }
+
+    std::cerr << "wrote " << bytes.size() << " bytes to " << opt.output << "\n";
+    return 0;
+}
@@ -0,0 +1,708 @@
+/* Solving daemon: keeps a solver pool and a solution cache warm and
+   answers puzzles sent over a Unix domain socket, in the line protocol
+   of src/daemon_protocol.hpp:
+
+       sudokud [-s SOCKET] [-j THREADS] [--engine NAME] [--max-nodes N]
+               [--timeout-ms N] [--batch N] [--linger-us N]
+               [--cache-mb N]
+
+   Every connection has a reader thread that queues its requests. The
+   workers take them off the queue in batches of up to --batch, mixing
+   connections, so a burst of small requests costs one wakeup per batch
+   rather than one per puzzle. A worker that finds fewer than --batch
+   requests waiting may linger up to --linger-us for more (0, the
+   default, takes what is there). Replies are gathered per connection
+   and written in request order by the connection's own writer thread,
+   so a client slow to read its replies holds up nobody else. Past
+   Connection::MaxUnsent bytes of replies not yet written, its requests
+   are no longer read until the writer catches up.
+
+   A client on the same host may instead hand over a shared memory ring
+   (src/shm_ring.hpp) by sending "shm" with its descriptor. The slots it
+   submits are queued like lines and answered in place, and the
+   connection only serves to notice when the client goes.
+
+   SIGINT or SIGTERM stops accepting, answers what was already received
+   and removes the socket */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "my_types.h"
+#include "book.hpp"
+#include "daemon_protocol.hpp"
+#include "engines.hpp"
+#include "io.hpp"
+#include "shm_ring.hpp"
+#include "socket.hpp"
+#include "solution_cache.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string socket = Sudoku::Daemon::DefaultSocketPath();
+    std::size_t threads = 0;
+    Sudoku::Engine engine = Sudoku::Engine::MRV;
+    std::uint64_t max_nodes = 0;
+    std::uint64_t timeout_ms = 0;
+    std::size_t batch = 64;
+    std::uint64_t linger_us = 0;
+    std::size_t cache_mb = 64; // 0: no cache
+};
+
+bool ParseOptions(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        std::string value = has_value ? argv[i + 1] : "";
+
+        if (arg == "-s" && has_value)
+            opt.socket = value, ++i;
+        else if (arg == "-j" && has_value)
+            opt.threads = std::strtoul(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--max-nodes" && has_value)
+            opt.max_nodes = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--timeout-ms" && has_value)
+            opt.timeout_ms = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--batch" && has_value)
+            opt.batch = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10)), ++i;
+        else if (arg == "--linger-us" && has_value)
+            opt.linger_us = std::strtoull(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--cache-mb" && has_value)
+            opt.cache_mb = std::strtoul(value.c_str(), nullptr, 10), ++i;
+        else if (arg == "--engine" && has_value)
+        {
+            auto engine = Sudoku::EngineFromName(value);
+            if (!engine)
+            {
+                std::cerr << "unknown engine: " << value << "\n";
+                return false;
+            }
+            opt.engine = *engine;
+            ++i;
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [-s SOCKET] [-j THREADS] [--engine naive|mrv|random-mrv|dlx]"
+                         " [--max-nodes N] [--timeout-ms N] [--batch N] [--linger-us N]"
+                         " [--cache-mb N]\n";
+            return false;
+        }
+    }
+
+    if (opt.threads == 0)
+        opt.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    return true;
+}
+
+std::atomic<bool> stop_requested{false};
+
+extern "C" void OnSignal(int)
+{
+    stop_requested.store(true);
+}
+
+/* Sends data without blocking for more than a poll at a time. Gives up
+   if the peer goes, or if stop is set and the peer has not taken a byte
+   for a second */
+bool SendReplies(int fd, std::string_view data, const std::atomic<bool>& stop)
+{
+    auto stalled = Clock::now();
+    while (!data.empty())
+    {
+        auto sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent > 0)
+        {
+            data.remove_prefix(static_cast<std::size_t>(sent));
+            stalled = Clock::now();
+            continue;
+        }
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            return false;
+
+        pollfd pfd{fd, POLLOUT, 0};
+        if (::poll(&pfd, 1, 100) == 0 && stop.load() && Clock::now() - stalled > std::chrono::seconds(1))
+            return false;
+    }
+    return true;
+}
+
+/* One client. Replies are numbered by request and go out in that
+   order: Add() stages a reply, Flush() hands the ones next in line to
+   the writer thread, which alone writes to the socket (WriteReplies).
+   The reader calls WaitForRoom() before each request and Finish() once
+   it stops. The socket closes when the last reference goes, that is
+   once the client stopped sending and every reply was handed over */
+class Connection
+{
+public:
+    static constexpr std::size_t MaxUnsent = 1 << 20;
+
+    explicit Connection(Sudoku::Socket s) : socket{std::move(s)} {}
+
+    int Fd() const noexcept {return socket.Fd();}
+
+    void Add(std::uint64_t seq, std::string reply)
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (broken)
+            return; // a client that went away just loses its replies
+
+        unsent += reply.size();
+        if (seq != next)
+        {
+            pending.emplace(seq, std::move(reply));
+            return;
+        }
+
+        out += reply;
+        ++next;
+        for (auto it = pending.find(next); it != pending.end(); it = pending.find(++next))
+        {
+            out += it->second;
+            pending.erase(it);
+        }
+    }
+
+    void Flush()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            if (out.empty())
+                return;
+        }
+        ready.notify_one();
+    }
+
+    /* Requests 0 to total - 1 are all the reader took */
+    void Finish(std::uint64_t total)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            finished = true;
+            requests = total;
+        }
+        ready.notify_one();
+    }
+
+    /* Blocks while the replies not written yet are over MaxUnsent.
+       False once the client stopped taking them */
+    bool WaitForRoom(const std::atomic<bool>& stop)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        while (unsent > MaxUnsent && !broken && !stop.load())
+            room.wait_for(lk, std::chrono::milliseconds(100));
+        return !broken;
+    }
+
+    /* Writes replies as they come in line, until every request is
+       answered or the client goes */
+    void WriteReplies(const std::atomic<bool>& stop)
+    {
+        std::string sending;
+        std::unique_lock<std::mutex> lk(mutex);
+        for (;;)
+        {
+            ready.wait(lk, [this]{ return broken || !out.empty() || (finished && next == requests); });
+            if (out.empty())
+                return;
+
+            sending.swap(out);
+            lk.unlock();
+            bool sent = SendReplies(socket.Fd(), sending, stop);
+            lk.lock();
+
+            unsent -= sending.size();
+            sending.clear();
+            if (!sent)
+            {
+                broken = true;
+                pending.clear();
+                out.clear();
+                unsent = 0;
+            }
+            room.notify_all();
+        }
+    }
+
+private:
+    Sudoku::Socket socket;
+    std::mutex mutex;
+    std::condition_variable ready; // for the writer
+    std::condition_variable room;  // for the reader
+    std::map<std::uint64_t, std::string> pending;
+    std::string out;
+    std::size_t unsent = 0;        // bytes in pending, out and being sent
+    std::uint64_t next = 0;
+    std::uint64_t requests = 0;
+    bool finished = false;
+    bool broken = false;
+};
+
+/* A ring handed over by a client. Add() marks a slot answered, Flush()
+   publishes the tail past every answered slot in a row, which is when
+   the client sees them */
+class RingSession
+{
+public:
+    explicit RingSession(Sudoku::ShmRing r) : ring{std::move(r)}, answered(ring.Slots(), 0) {}
+
+    Sudoku::ShmRing& Ring() noexcept {return ring;}
+
+    /* The tail last published: every slot from it on may still be
+       waiting for an answer */
+    std::uint32_t Tail()
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        return tail;
+    }
+
+    void Add(std::uint32_t n)
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        answered[n & (ring.Slots() - 1)] = 1;
+    }
+
+    void Flush()
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        auto next = tail;
+        for (auto mask = ring.Slots() - 1; answered[next & mask]; ++next)
+            answered[next & mask] = 0;
+
+        if (next != tail)
+        {
+            tail = next;
+            Sudoku::ShmRing::Publish(ring.Tail(), tail);
+        }
+    }
+
+private:
+    Sudoku::ShmRing ring;
+    std::mutex mutex;
+    std::vector<char> answered;
+    std::uint32_t tail = 0;
+};
+
+/* A line of conn, or puzzle number seq of ring if there is one */
+struct Request
+{
+    std::shared_ptr<Connection> conn;
+    std::uint64_t seq;
+    std::string line;
+    std::shared_ptr<RingSession> ring = nullptr;
+};
+
+/* Requests of every connection, taken in batches. Push blocks while the
+   queue is full. At most one worker lingers for a fuller batch at a
+   time; the others sleep until it leaves requests behind */
+class RequestQueue
+{
+public:
+    RequestQueue(std::size_t capacity, std::size_t batch_size, std::chrono::microseconds linger_time)
+        : limit{capacity}, batch{batch_size}, linger{linger_time} {}
+
+    bool Push(Request request)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        not_full.wait(lk, [this]{ return closed || items.size() < limit; });
+        if (closed)
+            return false;
+
+        items.push_back(std::move(request));
+        if (!lingering)
+            not_empty.notify_one();
+        else if (items.size() >= batch)
+            filled.notify_one();
+        return true;
+    }
+
+    /* Up to batch requests, empty once the queue is closed and drained */
+    std::vector<Request> PopBatch()
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        not_empty.wait(lk, [this]{ return closed || (!items.empty() && !lingering); });
+
+        if (!closed && items.size() < batch && linger.count() > 0)
+        {
+            lingering = true;
+            filled.wait_for(lk, linger, [this]{ return closed || items.size() >= batch; });
+            lingering = false;
+        }
+
+        auto n = std::min(batch, items.size());
+        std::vector<Request> taken(std::make_move_iterator(items.begin()),
+                                   std::make_move_iterator(items.begin() + static_cast<std::ptrdiff_t>(n)));
+        items.erase(items.begin(), items.begin() + static_cast<std::ptrdiff_t>(n));
+
+        if (!items.empty())
+            not_empty.notify_one();
+        not_full.notify_all();
+        return taken;
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+        filled.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::condition_variable filled;
+    std::deque<Request> items;
+    std::size_t limit;
+    std::size_t batch;
+    std::chrono::microseconds linger;
+    bool lingering = false;
+    bool closed = false;
+};
+
+/* Daemon-wide counters, for the "stats" request */
+struct Counters
+{
+    std::atomic<std::uint64_t> connections{0};
+    std::atomic<std::uint64_t> puzzles{0};
+    std::atomic<std::uint64_t> invalid{0};
+    std::atomic<std::uint64_t> batches{0};
+    std::atomic<std::uint64_t> status[4] = {};  // indexed by SolveStatus
+    std::atomic<std::uint64_t> solve_us{0};
+};
+
+std::string StatsReply(const Counters& c, const Sudoku::SolutionCache* cache, Clock::time_point start)
+{
+    auto load = [](const std::atomic<std::uint64_t>& a) { return a.load(std::memory_order_relaxed); };
+    auto puzzles = load(c.puzzles), batches = load(c.batches);
+
+    std::ostringstream out;
+    out << Sudoku::Daemon::StatsRequest
+        << " uptime_s=" << std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - start).count()
+        << " connections=" << load(c.connections)
+        << " puzzles=" << puzzles
+        << " batches=" << batches
+        << " mean_batch=" << (batches ? static_cast<double>(puzzles) / static_cast<double>(batches) : 0.0)
+        << " solved=" << load(c.status[0])
+        << " unsolvable=" << load(c.status[1])
+        << " budget_exceeded=" << load(c.status[2])
+        << " invalid=" << load(c.invalid)
+        << " solve_us=" << load(c.solve_us);
+
+    if (cache)
+    {
+        auto cc = cache->Counters();
+        out << " cache_hits=" << cc.hits << " cache_misses=" << cc.misses << " cache_entries=" << cc.entries;
+    }
+    out << '\n';
+    return out.str();
+}
+
+Sudoku::SolveResult Solve(const Puzzle_t& grid, std::uint64_t seed, const Options& opt,
+                          Sudoku::SolutionCache* cache, Counters& counters, std::uint64_t& micros)
+{
+    Sudoku::SolveOptions budget;
+    budget.max_nodes = opt.max_nodes;
+    if (opt.timeout_ms != 0)
+        budget.Timeout(std::chrono::milliseconds(opt.timeout_ms));
+
+    auto start = Clock::now();
+    auto result = Sudoku::SolveCached(cache, opt.engine, grid, budget, seed);
+    micros = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+
+    counters.status[static_cast<std::size_t>(result.status)].fetch_add(1, std::memory_order_relaxed);
+    counters.solve_us.fetch_add(micros, std::memory_order_relaxed);
+    return result;
+}
+
+/* Answers a slot of a ring in place. A grid with a cell over 9 is
+   answered unsolvable without a search */
+void SolveSlot(RingSession& session, std::uint32_t n, const Options& opt, Sudoku::SolutionCache* cache,
+               Counters& counters)
+{
+    auto& slot = session.Ring().Slot(n);
+    auto grid = Sudoku::UnpackGrid(slot.grid);
+
+    bool valid = true;
+    for (const auto& row : grid)
+        for (auto v : row)
+            valid = valid && v <= 9;
+
+    Sudoku::SolveResult result;
+    std::uint64_t micros = 0;
+    if (valid)
+        result = Solve(grid, n, opt, cache, counters, micros);
+    else
+        counters.invalid.fetch_add(1, std::memory_order_relaxed);
+
+    if (result.Solved())
+        Sudoku::PackGrid(result.grid, slot.grid);
+    slot.status = static_cast<std::uint8_t>(result.status);
+    slot.nodes = result.nodes;
+    slot.micros = static_cast<std::uint32_t>(std::min<std::uint64_t>(micros, UINT32_MAX));
+    session.Add(n);
+}
+
+/* Solves a batch and hands every reply to its connection or ring */
+void SolveBatch(std::vector<Request>& batch, const Options& opt, Sudoku::SolutionCache* cache, Counters& counters)
+{
+    std::vector<Connection*> touched;
+    std::vector<RingSession*> touched_rings;
+
+    for (auto& request : batch)
+    {
+        if (request.ring)
+        {
+            SolveSlot(*request.ring, static_cast<std::uint32_t>(request.seq), opt, cache, counters);
+            if (std::find(touched_rings.begin(), touched_rings.end(), request.ring.get()) == touched_rings.end())
+                touched_rings.push_back(request.ring.get());
+            continue;
+        }
+
+        std::string reply;
+        auto grid = Sudoku::ParsePuzzle(request.line);
+
+        if (!grid)
+        {
+            counters.invalid.fetch_add(1, std::memory_order_relaxed);
+            auto token = request.line.substr(0, request.line.find_first_of(" \t"));
+            reply = Sudoku::Daemon::FormatReply(token.empty() ? "-" : token, "invalid", 0, 0);
+        }
+        else
+        {
+            std::uint64_t micros = 0;
+            auto result = Solve(*grid, request.seq, opt, cache, counters, micros);
+            reply = Sudoku::Daemon::FormatReply(Sudoku::ToString(result.grid), Sudoku::StatusName(result.status),
+                                                result.nodes, micros);
+        }
+
+        request.conn->Add(request.seq, std::move(reply));
+        if (std::find(touched.begin(), touched.end(), request.conn.get()) == touched.end())
+            touched.push_back(request.conn.get());
+    }
+
+    for (auto conn : touched)
+        conn->Flush();
+    for (auto ring : touched_rings)
+        ring->Flush();
+
+    counters.puzzles.fetch_add(batch.size(), std::memory_order_relaxed);
+    counters.batches.fetch_add(1, std::memory_order_relaxed);
+    batch.clear();
+}
+
+/* True once the client closed its socket, or sent anything on it */
+bool PeerDone(int fd) noexcept
+{
+    pollfd pfd{fd, POLLIN, 0};
+    return ::poll(&pfd, 1, 0) != 0;
+}
+
+/* Queues the puzzles a client submits through its ring, until it goes.
+   seq is the number of the "shm" request on conn, answered first */
+void ServeRing(const std::shared_ptr<Connection>& conn, std::uint64_t seq, Sudoku::Socket fd, RequestQueue& queue)
+{
+    auto ring = Sudoku::ShmRing::Attach(std::move(fd));
+    if (!ring.IsOpen())
+    {
+        conn->Add(seq, "shm error\n");
+        conn->Flush();
+        return;
+    }
+
+    auto session = std::make_shared<RingSession>(std::move(ring));
+    auto& head = session->Ring().Head();
+    auto slots = session->Ring().Slots();
+    conn->Add(seq, "shm ok " + std::to_string(slots) + "\n");
+    conn->Flush();
+
+    for (std::uint32_t taken = 0; ; )
+    {
+        auto submitted = Sudoku::ShmRing::Wait(head, taken, std::chrono::milliseconds(100));
+        if (submitted == taken)
+        {
+            if (PeerDone(conn->Fd()))
+                return;
+            continue;
+        }
+
+        // A client past the ring's capacity is not playing by the rules:
+        // it would overwrite slots that are not answered yet
+        if (submitted - session->Tail() > slots)
+            return;
+
+        for (; taken != submitted; ++taken)
+            if (!queue.Push({conn, taken, {}, session}))
+                return;
+    }
+}
+
+/* Reads the requests of conn until the client closes its side */
+void ReadRequests(std::shared_ptr<Connection> conn, RequestQueue& queue, Counters& counters,
+                  const Sudoku::SolutionCache* cache, Clock::time_point start)
+{
+    Sudoku::LineReader reader(conn->Fd());
+    std::uint64_t seq = 0;
+    std::string line;
+
+    while (conn->WaitForRoom(stop_requested) && reader.Next(line))
+    {
+        if (line.empty())
+            continue;
+
+        if (line == Sudoku::Daemon::StatsRequest)
+        {
+            conn->Add(seq++, StatsReply(counters, cache, start));
+            conn->Flush();
+        }
+        else if (line == Sudoku::ShmFormat::Request)
+        {
+            ServeRing(conn, seq++, reader.TakeDescriptor(), queue);
+            break;
+        }
+        else if (!queue.Push({conn, seq++, line}))
+            break;
+    }
+    conn->Finish(seq);
+}
+
+} // End of anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!ParseOptions(argc, argv, opt))
+        return 1;
+
+    auto listener = Sudoku::ListenUnix(opt.socket);
+    if (!listener.IsOpen())
+    {
+        std::cerr << "cannot listen on " << opt.socket << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+
+    auto start = Clock::now();
+    Counters counters;
+    std::unique_ptr<Sudoku::SolutionCache> cache;
+    if (opt.cache_mb != 0)
+        cache = std::make_unique<Sudoku::SolutionCache>(opt.cache_mb << 20);
+
+    RequestQueue queue(opt.threads * opt.batch * 4, opt.batch, std::chrono::microseconds(opt.linger_us));
+
+    std::vector<std::thread> workers;
+    for (std::size_t w = 0; w < opt.threads; ++w)
+        workers.emplace_back([&]{
+            for (auto batch = queue.PopBatch(); !batch.empty(); batch = queue.PopBatch())
+                SolveBatch(batch, opt, cache.get(), counters);
+        });
+
+    struct Client
+    {
+        std::weak_ptr<Connection> conn;
+        std::shared_ptr<std::atomic<int>> running; // of reader and writer
+        std::thread reader;
+        std::thread writer;
+    };
+    std::vector<Client> clients;
+
+    std::cerr << "sudokud listening on " << opt.socket << " with " << opt.threads << " threads\n";
+
+    while (!stop_requested.load())
+    {
+        // Wake up now and then to notice signals and reap readers
+        pollfd pfd{listener.Fd(), POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 250);
+
+        for (auto it = clients.begin(); it != clients.end(); )
+            if (it->running->load() == 0)
+            {
+                it->reader.join();
+                it->writer.join();
+                it = clients.erase(it);
+            }
+            else
+                ++it;
+
+        if (ready <= 0)
+            continue;
+
+        Sudoku::Socket s{::accept(listener.Fd(), nullptr, nullptr)};
+        if (!s.IsOpen())
+            continue;
+
+        counters.connections.fetch_add(1, std::memory_order_relaxed);
+        auto conn = std::make_shared<Connection>(std::move(s));
+        auto running = std::make_shared<std::atomic<int>>(2);
+        std::thread reader([conn, running, &queue, &counters, &cache, start]() mutable {
+            ReadRequests(std::move(conn), queue, counters, cache.get(), start);
+            running->fetch_sub(1);
+        });
+        std::thread writer([conn, running]() mutable {
+            conn->WriteReplies(stop_requested);
+            conn.reset();
+            running->fetch_sub(1);
+        });
+        clients.push_back({conn, running, std::move(reader), std::move(writer)});
+    }
+
+    // Stop reading, answer everything already queued
+    listener.Close();
+    ::unlink(opt.socket.c_str());
+
+    for (auto& client : clients)
+    {
+        if (auto conn = client.conn.lock())
+            ::shutdown(conn->Fd(), SHUT_RD);
+        client.reader.join();
+    }
+
+    queue.Close();
+    for (auto& t : workers)
+        t.join();
+
+    // Every reply is in line now; writers stuck on a client that does
+    // not read give up after a second
+    for (auto& client : clients)
+        client.writer.join();
+
+    std::cerr << StatsReply(counters, cache.get(), start);
+    return 0;
+}